@@ -16,10 +16,56 @@
 #ifndef XD_READLINE_H
 #define XD_READLINE_H
 
+#include <stddef.h>
+#include <sys/types.h>
+
+// The following can be overridden at compile time (e.g.
+// `-DXD_RL_HISTORY_MAX=50` or `make XD_RL_HISTORY_MAX=50`), the same values
+// must be used for the library and the code including this header.
+
 /**
  * @brief Maximum number of history entries.
  */
+#ifndef XD_RL_HISTORY_MAX
 #define XD_RL_HISTORY_MAX (1000)
+#endif
+
+/**
+ * @brief Whether incremental history search (`Ctrl+R` and `Ctrl+S`) is
+ * compiled in (`1`) or not (`0`).
+ */
+#ifndef XD_RL_ENABLE_SEARCH
+#define XD_RL_ENABLE_SEARCH (1)
+#endif
+
+/**
+ * @brief Whether `Tab` completion is compiled in (`1`) or not (`0`).
+ */
+#ifndef XD_RL_ENABLE_COMPLETION
+#define XD_RL_ENABLE_COMPLETION (1)
+#endif
+
+/**
+ * @brief Whether listing all the completions on a second `Tab` is compiled in
+ * (`1`) or not (`0`), only used if `XD_RL_ENABLE_COMPLETION` is enabled.
+ */
+#ifndef XD_RL_ENABLE_COMPLETION_LIST
+#define XD_RL_ENABLE_COMPLETION_LIST (1)
+#endif
+
+/**
+ * @brief Whether suggesting the next command from the history (see
+ * `xd_readline_suggest_next_command`) is compiled in (`1`) or not (`0`).
+ */
+#ifndef XD_RL_ENABLE_SUGGESTION
+#define XD_RL_ENABLE_SUGGESTION (1)
+#endif
+
+/**
+ * @brief Number of the oldest history entries examined when looking for an
+ * entry to evict under the `XD_RL_HISTORY_EVICT_FREQUENCY` policy.
+ */
+#define XD_RL_HISTORY_EVICT_WINDOW (8)
 
 /**
  * @brief Characters which define the start of the word to be completed when
@@ -29,6 +75,113 @@
  */
 #define XD_RL_TAB_COMP_DELIMITERS "'\"`!*?[]{}()<>~#$`:=;&|@\%^\\ "
 
+/**
+ * @brief Policies used to choose which history entry to evict when the history
+ * is full.
+ */
+typedef enum xd_readline_history_eviction_t {
+  XD_RL_HISTORY_EVICT_FIFO,       // Always evict the oldest entry.
+  XD_RL_HISTORY_EVICT_FREQUENCY,  // Evict the oldest entry that wasn't reused.
+} xd_readline_history_eviction_t;
+
+/**
+ * @brief The subsystems whose memory usage is accounted, see
+ * `xd_readline_memory_get_usage()`.
+ */
+typedef enum xd_readline_memory_subsystem_t {
+  XD_RL_MEMORY_INPUT,       // The input buffer and its display column index.
+  XD_RL_MEMORY_HISTORY,     // The history entries, strings, and predictions.
+  XD_RL_MEMORY_SEARCH,      // The history search query buffer.
+  XD_RL_MEMORY_COMPLETION,  // The scratch arena used by `Tab` completion.
+  XD_RL_MEMORY_KEYMAP,      // The key bindings and their dispatch tables.
+  XD_RL_MEMORY_TOTAL,       // All of the above together.
+} xd_readline_memory_subsystem_t;
+
+/**
+ * @brief The editing actions keys can be bound to, see `xd_readline_bind()`,
+ * with their names in inputrc files and their default keys.
+ */
+typedef enum xd_readline_action_t {
+  XD_RL_ACTION_NONE,                    // Does nothing, unbinds the key.
+  XD_RL_ACTION_SELF_INSERT,             // self-insert, printable keys.
+  XD_RL_ACTION_BEGINNING_OF_LINE,       // beginning-of-line, Ctrl+A, Home.
+  XD_RL_ACTION_END_OF_LINE,             // end-of-line, Ctrl+E, End.
+  XD_RL_ACTION_FORWARD_CHAR,            // forward-char, Ctrl+F, Right.
+  XD_RL_ACTION_BACKWARD_CHAR,           // backward-char, Ctrl+B, Left.
+  XD_RL_ACTION_FORWARD_WORD,            // forward-word, Alt+F, Ctrl+Right.
+  XD_RL_ACTION_BACKWARD_WORD,           // backward-word, Alt+B, Ctrl+Left.
+  XD_RL_ACTION_DELETE_CHAR,             // delete-char, Delete.
+  XD_RL_ACTION_DELETE_CHAR_OR_EOF,      // delete-char-or-eof, Ctrl+D.
+  XD_RL_ACTION_BACKWARD_DELETE_CHAR,    // backward-delete-char, Backspace.
+  XD_RL_ACTION_KILL_WORD,               // kill-word, Alt+D, Ctrl+Delete.
+  XD_RL_ACTION_BACKWARD_KILL_WORD,      // backward-kill-word, Alt+Backspace.
+  XD_RL_ACTION_KILL_LINE,               // kill-line, Ctrl+K.
+  XD_RL_ACTION_UNIX_LINE_DISCARD,       // unix-line-discard, Ctrl+U.
+  XD_RL_ACTION_CLEAR_SCREEN,            // clear-screen, Ctrl+L.
+  XD_RL_ACTION_ACCEPT_LINE,             // accept-line, Enter.
+  XD_RL_ACTION_PREVIOUS_HISTORY,        // previous-history, Up, Page Up.
+  XD_RL_ACTION_NEXT_HISTORY,            // next-history, Down, Page Down.
+  XD_RL_ACTION_BEGINNING_OF_HISTORY,    // beginning-of-history, Ctrl+Up.
+  XD_RL_ACTION_END_OF_HISTORY,          // end-of-history, Ctrl+Down.
+  XD_RL_ACTION_REVERSE_SEARCH_HISTORY,  // reverse-search-history, Ctrl+R.
+  XD_RL_ACTION_FORWARD_SEARCH_HISTORY,  // forward-search-history, Ctrl+S.
+  XD_RL_ACTION_COMPLETE,                // complete, Tab.
+  XD_RL_ACTION_ABORT,                   // abort, Ctrl+G.
+} xd_readline_action_t;
+
+/**
+ * @brief Represents the memory usage of a subsystem in bytes.
+ */
+typedef struct xd_readline_memory_usage_t {
+  size_t current;  // The number of bytes currently allocated.
+  size_t peak;     // The highest number of bytes allocated at once.
+} xd_readline_memory_usage_t;
+
+/**
+ * @brief Function type for allocating memory, see
+ * `xd_readline_set_allocator()`.
+ *
+ * @param size The number of bytes to allocate.
+ * @param user The user data passed to `xd_readline_set_allocator()`.
+ *
+ * @return Pointer to the allocated memory, or `NULL` on failure.
+ */
+typedef void *(*xd_readline_alloc_func_t)(size_t size, void *user);
+
+/**
+ * @brief Function type for resizing memory, see `xd_readline_set_allocator()`.
+ *
+ * @param ptr The memory to resize, never `NULL`.
+ * @param size The new size in bytes.
+ * @param user The user data passed to `xd_readline_set_allocator()`.
+ *
+ * @return Pointer to the resized memory, or `NULL` on failure in which case
+ * `ptr` must be left untouched.
+ */
+typedef void *(*xd_readline_realloc_func_t)(void *ptr, size_t size,
+                                            void *user);
+
+/**
+ * @brief Function type for freeing memory, see `xd_readline_set_allocator()`.
+ *
+ * @param ptr The memory to free, never `NULL`.
+ * @param user The user data passed to `xd_readline_set_allocator()`.
+ */
+typedef void (*xd_readline_free_func_t)(void *ptr, void *user);
+
+/**
+ * @brief Options for `xd_readline_init_ex()`, zero-initialize for the
+ * defaults.
+ */
+typedef struct xd_readline_init_opts_t {
+  xd_readline_alloc_func_t alloc_func;      // Allocation function, or `NULL`.
+  xd_readline_realloc_func_t realloc_func;  // Resizing function, or `NULL`.
+  xd_readline_free_func_t free_func;        // Freeing function, or `NULL`.
+  void *alloc_user;  // Passed as-is to the allocator functions.
+  int no_sigwinch_handler;  // Leave `SIGWINCH` untouched (non-zero) or not.
+} xd_readline_init_opts_t;
+
+#if XD_RL_ENABLE_COMPLETION
 /**
  * @brief Function type for the function responsible for generating all possible
  * completions when pressing `Tab`.
@@ -57,12 +210,47 @@ typedef char **(*xd_readline_completion_gen_func_t)(const char *line, int start,
  *
  * @note This function must return a newly allocated null-terminated and sorted
  * array of strings containing all the possible completions for the passed
- * string.
+ * string. The array and its strings are owned by the library afterwards and
+ * are released with `free()`, whatever allocator is set with
+ * `xd_readline_set_allocator()`, so they must be allocated with `malloc()`, or
+ * with `xd_readline_scratch_alloc()` in which case they are not freed
+ * individually.
  *
  * @note For path completion, this function must return all possible path
  * completions with the directory completions having '/' at their end.
+ *
+ * @note Positions are passed as `int`, so it isn't called when the cursor is
+ * past `INT_MAX` bytes into the line.
  */
 extern xd_readline_completion_gen_func_t xd_readline_completions_generator;
+#endif
+
+/**
+ * @brief Function type for the function deciding whether the input is complete
+ * when pressing `Enter`.
+ *
+ * @param input The whole input, which may span several lines.
+ *
+ * @return Non-zero if the input is complete, or zero if it continues on a new
+ * line.
+ */
+typedef int (*xd_readline_input_complete_func_t)(const char *input);
+
+/**
+ * @brief Pointer to the function asked whether the input is complete when
+ * pressing `Enter`, if not set then `Enter` always accepts the input.
+ *
+ * When it returns zero, e.g. for an unterminated SQL statement or a line
+ * ending with `\`, a new-line is inserted at the cursor instead and the input
+ * is edited as a whole: `Up Arrow` and `Down Arrow` move between its lines
+ * before moving in history, and the line returned has its lines separated by
+ * new-lines.
+ *
+ * @warning This function will be called within `xd_readline()` where the
+ * terminal settings are changed, don't read/write to `stdout` or `stdin` within
+ * this function or you will break `xd_readline()`'s correct functionality.
+ */
+extern xd_readline_input_complete_func_t xd_readline_input_complete;
 
 /**
  * @brief Prompt string displayed at the beginning of each input line.
@@ -75,15 +263,259 @@ extern xd_readline_completion_gen_func_t xd_readline_completions_generator;
  */
 extern const char *xd_readline_prompt;
 
+/**
+ * @brief The policy used to choose which history entry to evict when the
+ * history is full, defaults to `XD_RL_HISTORY_EVICT_FIFO`.
+ *
+ * Under `XD_RL_HISTORY_EVICT_FREQUENCY`, entries that were recalled (through
+ * history navigation or search) and accepted are protected: the oldest
+ * `XD_RL_HISTORY_EVICT_WINDOW` entries are examined and the oldest unprotected
+ * one among them is evicted. Each time a protected entry is passed over its
+ * protection decays, so entries that stop being reused are eventually evicted.
+ */
+extern xd_readline_history_eviction_t xd_readline_history_eviction;
+
+/**
+ * @brief Maximum total length in bytes of the strings stored in the history,
+ * or `0` for no limit (the default).
+ *
+ * When adding an entry would exceed this budget, entries are evicted according
+ * to `xd_readline_history_eviction` until it fits.
+ */
+extern size_t xd_readline_history_max_bytes;
+
+#if XD_RL_ENABLE_SUGGESTION
+/**
+ * @brief Whether to suggest the predicted next command when the input is empty
+ * (non-zero) or not (zero, the default).
+ *
+ * The prediction is the command that most frequently followed the last command
+ * added to the history. It is displayed dimmed after the cursor and accepted
+ * with `Right Arrow`, `Ctrl+F`, `End`, or `Ctrl+E`.
+ */
+extern int xd_readline_suggest_next_command;
+#endif
+
+/**
+ * @brief Extra characters treated as part of a word by word motion and
+ * deletion (`Alt+F`, `Alt+B`, `Alt+D`, ...), in addition to letters, digits,
+ * and non-ASCII characters, or `NULL` for none (the default).
+ *
+ * Example: `"_-"` makes `my-long_name` a single word.
+ *
+ * @note The string is not duplicated internally and is compiled into a lookup
+ * table when `xd_readline()` sees a different pointer, so point it to a new
+ * string instead of modifying it in place.
+ */
+extern const char *xd_readline_word_chars;
+
+/**
+ * @brief Maximum total number of bytes the library may keep allocated, or `0`
+ * for no limit (the default).
+ *
+ * When adding a history entry would exceed the budget, the entries holding
+ * strings too long to be stored inline are evicted according to
+ * `xd_readline_history_eviction` until it fits, since evicting the others
+ * releases no memory, and the entry is refused if it still doesn't fit.
+ * Input that would grow the input buffer past the budget is refused with a
+ * bell, and so is completion. The fixed-size buffers allocated at
+ * initialization are counted but always allocated.
+ */
+extern size_t xd_readline_memory_budget;
+
+/**
+ * @brief Whether to remove the trailing new-line from the lines returned by
+ * `xd_readline()` and `xd_readline_n()` (non-zero) or keep it (zero, the
+ * default).
+ */
+extern int xd_readline_omit_newline;
+
+/**
+ * @brief Time in milliseconds to wait for the next byte of a key sequence
+ * before handling the bytes read as a key on their own, e.g. a lone `Esc`, or
+ * `0` for automatic (the default).
+ *
+ * The automatic timeout is `25` ms, or `100` ms over SSH, and is raised when
+ * key sequences are seen split by it. Bytes that have already arrived are
+ * decoded without waiting.
+ */
+extern int xd_readline_esc_timeout_ms;
+
+/**
+ * @brief Whether the terminal capabilities found by querying the terminal are
+ * cached (non-zero) or queried again by every process (zero, the default).
+ *
+ * The first `xd_readline()` call asks the terminal what it supports, along
+ * with the cursor position it asks for anyway, so it costs no extra round
+ * trip. With the cache, the answers are stored in
+ * `$XDG_CACHE_HOME/xd-readline/terminals` (`~/.cache` by default) keyed by
+ * `$TERM` and `$TERM_PROGRAM`, and later processes don't ask again. Only set
+ * it when those identify the terminal, e.g. not when the same `$TERM` is used
+ * by terminals or multiplexers supporting different features, or over SSH.
+ */
+extern int xd_readline_terminal_cache;
+
+/**
+ * @brief Whether to turn on the terminal's progressive keyboard enhancement
+ * (the kitty keyboard protocol) while reading a line, on terminals that
+ * support it (non-zero), or keep the legacy key encoding (zero, the default).
+ *
+ * Every key then arrives as a self-delimiting `\033[codepoint;modifiers u`
+ * sequence or a legacy one that can't be confused with it, so `Esc` and `Alt`
+ * combinations never wait for the escape timeout. Combinations the legacy
+ * encoding can't tell apart can be bound, e.g. `"\033[13;5u"` for
+ * `Ctrl+Enter` or `"\033[9;5u"` for `Ctrl+Tab`, and unbound keys run the
+ * binding of the legacy key they stand for. The tty no longer sees the
+ * interrupt, quit, and suspend characters, so when its `ISIG` setting is on
+ * the unbound keys standing for them raise `SIGINT`, `SIGQUIT`, and `SIGTSTP`
+ * instead.
+ */
+extern int xd_readline_kitty_keyboard;
+
+#ifdef XD_RL_DEBUG_ALLOCS
+/**
+ * @brief Number of allocations made while handling keystrokes other than
+ * growing the input buffer, persisting edits to history entries, and `Tab`
+ * completion.
+ *
+ * Only defined when the library is built with `XD_RL_DEBUG_ALLOCS`, as the
+ * tests and benchmarks are, which check that it stays `0`.
+ */
+extern size_t xd_readline_debug_keystroke_allocs;
+#endif
+
+/**
+ * @brief Initializes the library explicitly with the passed options.
+ *
+ * Calling this is optional: the library initializes itself with the default
+ * options on the first call to `xd_readline()` or
+ * `xd_readline_history_add()`, nothing is done before `main()`.
+ *
+ * By default, a `SIGWINCH` handler is installed while `xd_readline()` is
+ * running to follow window resizes, and the previous disposition is restored
+ * before it returns. With `no_sigwinch_handler` set, signal dispositions are
+ * never changed and the window width is only refreshed at the start of each
+ * call.
+ *
+ * @param opts The options, or `NULL` for the defaults. The allocator functions
+ * follow the rules of `xd_readline_set_allocator()`.
+ *
+ * @return `0` on success or `-1` on failure with `errno` set to `EALREADY` if
+ * the library was already initialized, or `ENOMEM` on allocation failure in
+ * which case a later call tries again.
+ */
+int xd_readline_init_ex(const xd_readline_init_opts_t *opts);
+
 /**
  * @brief Reads a line from standard input with custom editing and keyboard
  * functionalities.
  *
- * @return A pointer to the internal buffer storing the line read, or `NULL`
- * on `EOF`.
+ * If either `stdin` or `stdout` is not a terminal, e.g. when input is piped
+ * or redirected from a file, the line is read as is without editing, prompt or
+ * history, in large blocks so big inputs are read at close to I/O speed.
+ *
+ * @return A pointer to the internal buffer storing the line read, always
+ * ending with a new-line, or `NULL` on `EOF` or error, with `errno` set to
+ * `ENOMEM` on allocation failure. The buffer is owned by the library and is
+ * only valid until the next call to `xd_readline()` or
+ * `xd_readline_set_allocator()`.
  */
 char *xd_readline();
 
+/**
+ * @brief Reads a line like `xd_readline()` into a buffer owned by the caller,
+ * like `getline()`.
+ *
+ * An edited line is not copied, the buffer holding it is exchanged with the
+ * passed one, which the library keeps for reading the next lines. Lines read
+ * without editing (see `xd_readline()`) are copied, growing the buffer if
+ * needed.
+ *
+ * Example:
+ * @code
+ * char *line = NULL;
+ * size_t capacity = 0;
+ * ssize_t length;
+ * while ((length = xd_readline_n(&line, &capacity)) != -1) {
+ *   fwrite(line, 1, length, stdout);
+ * }
+ * free(line);
+ * @endcode
+ *
+ * @param buf Pointer to a buffer allocated with the allocator's allocation
+ * function (`malloc()` by default, see `xd_readline_set_allocator()`) or to
+ * `NULL`, receives the buffer holding the null-terminated line, which the
+ * caller must release with the matching free function.
+ * @param cap Pointer to the capacity of `*buf`, receives the capacity of the
+ * buffer returned.
+ *
+ * @return The length of the line, including the new-line unless
+ * `xd_readline_omit_newline` is set, or `-1` on `EOF` or error, with `errno`
+ * set to `EINVAL` if either pointer is `NULL`, or `ENOMEM` on allocation
+ * failure.
+ */
+ssize_t xd_readline_n(char **buf, size_t *cap);
+
+/**
+ * @brief Allocates transient memory from the library's scratch arena, e.g. for
+ * the array returned by the completions generator and its strings.
+ *
+ * Memory from the arena is never freed individually, all of it is released at
+ * once when the current call to `xd_readline()` returns (or the next one when
+ * called outside of it). The arena keeps its largest size across calls, so
+ * once warmed up it doesn't allocate.
+ *
+ * @param size The number of bytes to allocate.
+ *
+ * @return Pointer to the allocated memory, suitably aligned for any type, or
+ * `NULL` on allocation failure. Must not be passed to `free()`.
+ */
+void *xd_readline_scratch_alloc(size_t size);
+
+/**
+ * @brief Sets the functions used for all the memory allocations made by the
+ * library (the input buffer, the history, and the strings returned by
+ * `xd_readline_history_get()`), stdio's internal buffers aside.
+ *
+ * Must be called before the library is initialized, i.e. before
+ * `xd_readline_init_ex()` and before the first call reading a line or using
+ * the history or the key bindings, since memory already allocated must be
+ * released with the allocator that allocated it.
+ * The completions returned by the generator are not affected, they are
+ * released with `free()`.
+ *
+ * @param alloc_func The allocation function.
+ * @param realloc_func The resizing function.
+ * @param free_func The freeing function.
+ * @param user Pointer passed as-is to the three functions, e.g. a per-session
+ * arena.
+ *
+ * If any of the functions is `NULL`, the default `malloc()`, `realloc()`, and
+ * `free()` are used for all three.
+ *
+ * @return `0` on success or `-1` with `errno` set to `EBUSY` if the library
+ * was already initialized.
+ */
+int xd_readline_set_allocator(xd_readline_alloc_func_t alloc_func,
+                              xd_readline_realloc_func_t realloc_func,
+                              xd_readline_free_func_t free_func, void *user);
+
+/**
+ * @brief Retrieves the current and peak memory usage of the passed subsystem,
+ * or of all of them with `XD_RL_MEMORY_TOTAL`.
+ *
+ * Buffers that grew to fit an unusually long line are shrunk back at the start
+ * of a later call to `xd_readline()`, once recent lines no longer need them.
+ *
+ * @param subsystem The subsystem to retrieve the usage of.
+ * @param usage Where to store the usage.
+ *
+ * @return `0` on success or `-1` if the subsystem is invalid or `usage` is
+ * `NULL`.
+ */
+int xd_readline_memory_get_usage(xd_readline_memory_subsystem_t subsystem,
+                                 xd_readline_memory_usage_t *usage);
+
 /**
  * @brief Clears the history.
  */
@@ -93,10 +525,14 @@ void xd_readline_history_clear();
  * @brief Adds a copy of the passed string (without trailing newline) to the
  * history.
  *
+ * If the history is full (by entry count or by `xd_readline_history_max_bytes`)
+ * entries are evicted according to `xd_readline_history_eviction`.
+ *
  * @param str The string to be added to the history, must be null-terminated.
  *
- * @return `0` on success or `-1` if the passed string is `NULL` or on
- * allcoation failure.
+ * @return `0` on success or `-1` if the passed string is `NULL`, longer than
+ * `xd_readline_history_max_bytes`, doesn't fit within
+ * `xd_readline_memory_budget`, or on allcoation failure.
  */
 int xd_readline_history_add(const char *str);
 
@@ -114,7 +550,9 @@ int xd_readline_history_add(const char *str);
  * @param n The number of the history entry to be returned.
  *
  * @return A newly allocated string containing the requested history entry, or
- * `NULL` if the index is out of bounds or on memory allocation failure.
+ * `NULL` if the index is out of bounds or on memory allocation failure. The
+ * caller owns the string and must release it with the allocator's free
+ * function (`free()` by default, see `xd_readline_set_allocator()`).
  */
 char *xd_readline_history_get(int n);
 
@@ -126,6 +564,10 @@ void xd_readline_history_print();
 /**
  * @brief Writes the history to a file.
  *
+ * Each entry is written on its own line, the newlines of multi-line entries
+ * as `\n` with the backslashes before them doubled, see
+ * `xd_readline_history_load_from_file()`.
+ *
  * @param path The path of the file to write the history to.
  * @param append Whether to append to the file (non-zero) or overwrite it
  * (zero).
@@ -137,10 +579,70 @@ int xd_readline_history_save_to_file(const char *path, int append);
 /**
  * @brief Loads the history from a file.
  *
+ * Only the last `XD_RL_HISTORY_MAX` lines of the file are read, since older
+ * lines would be overwritten anyway, so loading time doesn't grow with the
+ * file size. Each line is one entry, in which `\n` stands for a newline and
+ * `\\` for a backslash, other backslashes are kept as they are.
+ *
  * @param path The path of the file to read the history from.
  *
  * @return `0` on success `-1` on failure.
  */
 int xd_readline_history_load_from_file(const char *path);
 
+/**
+ * @brief Binds a key sequence to an editing action, replacing its previous
+ * binding.
+ *
+ * Example: `xd_readline_bind("\033[Z", XD_RL_ACTION_BACKWARD_WORD)` makes
+ * `Shift+Tab` move backward by one word.
+ *
+ * The bindings are compiled into dispatch tables the next time `xd_readline()`
+ * starts, so each key is dispatched in constant time however many are bound.
+ * A sequence that is also the prefix of longer bound sequences (e.g. a lone
+ * `ESC`) runs its binding when no byte continuing them arrives within the
+ * escape timeout, see `xd_readline_esc_timeout_ms`.
+ *
+ * @param sequence The bytes sent by the key, at most `31`.
+ * @param action The action to bind, or `XD_RL_ACTION_NONE` to unbind it.
+ *
+ * @return `0` on success or `-1` on failure, with `errno` set to `EINVAL` if
+ * the sequence is empty or too long, or `ENOMEM` on allocation failure.
+ */
+int xd_readline_bind(const char *sequence, xd_readline_action_t action);
+
+/**
+ * @brief Binds a key sequence to a macro, replacing its previous binding.
+ *
+ * When the sequence is read, the macro's text is handled as if typed, so it
+ * can contain bound keys too, e.g. `"\001sudo \005"` prepends `sudo ` to
+ * the input. Keys bound to macros are ignored within macros.
+ *
+ * @param sequence The bytes sent by the key, at most `31`.
+ * @param text The text of the macro.
+ *
+ * @return `0` on success or `-1` on failure, with `errno` set to `EINVAL` if
+ * the sequence is empty or too long, or `ENOMEM` on allocation failure.
+ */
+int xd_readline_bind_macro(const char *sequence, const char *text);
+
+/**
+ * @brief Loads key bindings from an inputrc file, in GNU Readline's format.
+ *
+ * Supported lines:
+ * - `"\C-x\C-r": reverse-search-history` or `Control-x: kill-line`, binding
+ *   a key sequence or key name to one of the actions in
+ *   `xd_readline_action_t`.
+ * - `"\ep": "\C-a\C-k"`, binding a key to a macro.
+ * - `$if`, `$else`, `$endif`, with `mode=emacs` and `term=` conditions, and
+ *   `$include`.
+ *
+ * Variables (`set`) are ignored, and so are unknown actions.
+ *
+ * @param path The path of the file to read the bindings from.
+ *
+ * @return `0` on success `-1` on failure.
+ */
+int xd_readline_bindings_load_from_file(const char *path);
+
 #endif  // XD_READLINE_H
@@ -22,6 +22,8 @@
 
 #include "xd_readline.h"
 
+#if XD_RL_ENABLE_COMPLETION
+
 /**
  * @brief Comparison function for sorting path strings.
  *
@@ -43,11 +45,8 @@ static int xd_path_cmp(const void *first, const void *second) {
  *
  * @param partial_path The partial path string to be complete.
  *
- * @return A newly-allocated, sorted, and null-terminated string array of
- * possible path completions.
- *
- * @note The caller is responsible for freeing the returned array and its
- * contents.
+ * @return A sorted and null-terminated string array of possible path
+ * completions, allocated from the scratch arena of `xd_readline()`.
  */
 char **xd_path_completions_generator(const char *partial_path) {
   // initialize glob pattern
@@ -62,22 +61,27 @@ char **xd_path_completions_generator(const char *partial_path) {
     return NULL;
   }
 
-  // allocate memory for the array of completions
+  // allocate memory for the array of completions, it is released when
+  // `xd_readline()` returns so it doesn't have to be freed
   int completions_count = (int)glob_result.gl_pathc;
-  char **completions =
-      (char **)malloc(sizeof(char *) * (completions_count + 1));
+  char **completions = (char **)xd_readline_scratch_alloc(
+      sizeof(char *) * (completions_count + 1));
   if (completions == NULL) {
+    globfree(&glob_result);
     return NULL;
   }
 
   // copy the glob matches to the array of completions
   for (int i = 0; i < completions_count; i++) {
-    completions[i] = strdup(glob_result.gl_pathv[i]);
+    size_t length = strlen(glob_result.gl_pathv[i]);
+    completions[i] = (char *)xd_readline_scratch_alloc(length + 1);
     if (completions[i] == NULL) {
       // allocation failure, stop adding and return
+      completions[i] = NULL;
       globfree(&glob_result);
       return completions;
     }
+    memcpy(completions[i], glob_result.gl_pathv[i], length + 1);
   }
   // add null-terminator to indicate end of array
   completions[completions_count] = NULL;
@@ -99,6 +103,21 @@ char **xd_completions_generator(const char *line, int start, int end) {
   return xd_path_completions_generator(partial_text);
 }  // xd_completions_generator()
 
+#endif  // XD_RL_ENABLE_COMPLETION
+
+/**
+ * @brief Reports whether the input is complete, input ending with a backslash
+ * continues on the next line.
+ *
+ * @param input The whole input.
+ *
+ * @return Non-zero if the input is complete, zero otherwise.
+ */
+int xd_input_complete(const char *input) {
+  size_t length = strlen(input);
+  return length == 0 || input[length - 1] != '\\';
+}  // xd_input_complete()
+
 /**
  * @brief Handles history expansion.
  *
@@ -115,35 +134,44 @@ void xd_history_expansion(const char *line) {
 
 int main() {
   xd_readline_prompt = "\033[0;101mxd\033[0m-rl> ";
+#if XD_RL_ENABLE_COMPLETION
   xd_readline_completions_generator = xd_completions_generator;
+#endif
+#if XD_RL_ENABLE_SUGGESTION
+  xd_readline_suggest_next_command = 1;
+#endif
+  xd_readline_omit_newline = 1;
+  xd_readline_input_complete = xd_input_complete;
 
   char *line = NULL;
-  while ((line = xd_readline()) != NULL) {
-    printf("Read: %s---------------------\n", line);
-    if (strcmp(line, "history\n") == 0) {
+  size_t capacity = 0;
+  while (xd_readline_n(&line, &capacity) != -1) {
+    printf("Read: %s\n---------------------\n", line);
+    if (strcmp(line, "history") == 0) {
       xd_readline_history_print();
     }
-    else if (strcmp(line, "history -c\n") == 0) {
+    else if (strcmp(line, "history -c") == 0) {
       xd_readline_history_clear();
       continue;
     }
-    else if (strcmp(line, "history -r\n") == 0) {
+    else if (strcmp(line, "history -r") == 0) {
       xd_readline_history_load_from_file("xd.history");
     }
-    else if (strcmp(line, "history -w\n") == 0) {
+    else if (strcmp(line, "history -w") == 0) {
       xd_readline_history_save_to_file("xd.history", 0);
     }
-    else if (strcmp(line, "history -a\n") == 0) {
+    else if (strcmp(line, "history -a") == 0) {
       xd_readline_history_save_to_file("xd.history", 1);
     }
     else if (line[0] == '!') {
       xd_history_expansion(line);
       continue;
     }
-    else if (strcmp(line, "exit\n") == 0) {
+    else if (strcmp(line, "exit") == 0) {
       break;
     }
     xd_readline_history_add(line);
   }
+  free(line);
   exit(EXIT_SUCCESS);
 }  // main()
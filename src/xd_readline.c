@@ -18,15 +18,28 @@
 #include <ctype.h>
 #include <errno.h>
 #include <limits.h>
+#include <poll.h>
 #include <signal.h>
 #include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <sys/ioctl.h>
+#include <sys/stat.h>
 #include <termios.h>
 #include <unistd.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#if XD_RL_HISTORY_MAX < 1
+#error "XD_RL_HISTORY_MAX must be at least 1"
+#endif
+
 // ========================
 // Macros and Constants
 // ========================
@@ -36,6 +49,226 @@
  */
 #define XD_RL_SMALL_BUFFER_SIZE (32)
 
+/**
+ * @brief Size of the buffer collecting the terminal output of a keystroke,
+ * written at once before waiting for the next one.
+ */
+#define XD_RL_OUTPUT_BUFFER_SIZE (4096)
+
+/**
+ * @brief Maximum time in milliseconds to wait for the terminal to reply to a
+ * query.
+ */
+#define XD_RL_QUERY_TIMEOUT (1000)
+
+/**
+ * @brief Path of the terminal capabilities cache file, relative to the cache
+ * directory.
+ */
+#define XD_RL_TERMINAL_CACHE_FILE "xd-readline/terminals"
+
+// terminal capabilities found by querying the terminal
+
+#define XD_RL_TTY_CAP_SYNC       (1 << 0)  // synchronized updates (mode 2026)
+#define XD_RL_TTY_CAP_KITTY_KEYS (1 << 1)  // progressive keyboard enhancement
+
+/**
+ * @brief Window width assumed when the terminal doesn't report one.
+ */
+#define XD_RL_DEFAULT_WIN_WIDTH (80)
+
+/**
+ * @brief Size of the blocks used for scanning the history file backward.
+ */
+#define XD_RL_FILE_BLOCK_SIZE (65536)
+
+/**
+ * @brief Capacity of the storage embedded in each history entry, strings
+ * shorter than this are stored inline without a separate allocation.
+ *
+ * Chosen so an entry is 64 bytes on 64-bit platforms.
+ */
+#define XD_RL_HISTORY_INLINE_SIZE (32)
+
+/**
+ * @brief Number of buckets in the hash table of interned history strings, must
+ * be a power of two.
+ */
+#define XD_RL_INTERN_BUCKETS (1024)
+
+/**
+ * @brief Number of commands whose successors are tracked for next command
+ * prediction, must be a power of two.
+ */
+#define XD_RL_PREDICT_BUCKETS (128)
+
+/**
+ * @brief Number of most frequent successors tracked per command.
+ */
+#define XD_RL_PREDICT_WAYS (3)
+
+/**
+ * @brief Maximum number of bytes in a UTF-8 encoded code point.
+ */
+#define XD_RL_UTF8_SEQ_MAX (4)
+
+/**
+ * @brief The largest valid Unicode code point.
+ */
+#define XD_RL_UNICODE_MAX (0x10FFFF)
+
+/**
+ * @brief The code point used in place of invalid UTF-8 sequences.
+ */
+#define XD_RL_UNICODE_REPLACEMENT (0xFFFD)
+
+/**
+ * @brief Number of low code point bits indexing into a block of the two-level
+ * display width table, each block covers 256 code points.
+ */
+#define XD_RL_WIDTH_BLOCK_BITS (8)
+
+/**
+ * @brief Number of bytes in a block of the display width table, each code
+ * point's width is packed in 2 bits.
+ */
+#define XD_RL_WIDTH_BLOCK_BYTES ((1 << XD_RL_WIDTH_BLOCK_BITS) / 4)
+
+/**
+ * @brief Number of entries in the first level of the display width table.
+ */
+#define XD_RL_WIDTH_STAGE1_SIZE \
+  ((XD_RL_UNICODE_MAX + 1) >> XD_RL_WIDTH_BLOCK_BITS)
+
+/**
+ * @brief Maximum number of distinct blocks in the display width table.
+ */
+#define XD_RL_WIDTH_BLOCKS_MAX (128)
+
+/**
+ * @brief Number of input buffer bytes summarized by each entry of the display
+ * column index.
+ */
+#define XD_RL_COLUMN_CHUNK_SIZE (64)
+
+/**
+ * @brief Initial capacity of the line index of the input buffer, allocated
+ * when the input gets its first new-line.
+ */
+#define XD_RL_INPUT_LINES_MIN (16)
+
+/**
+ * @brief Character class of the bytes which are part of a word.
+ */
+#define XD_RL_CHAR_CLASS_WORD (1)
+
+/**
+ * @brief Character class of the bytes which delimit the word to be completed.
+ */
+#define XD_RL_CHAR_CLASS_TAB_DELIM (2)
+
+/**
+ * @brief Maximum number of extra word characters handled by the vectorized
+ * word scanning, more than this falls back to scanning byte by byte.
+ */
+#define XD_RL_WORD_SIMD_EXTRA_MAX (8)
+
+#ifdef XD_RL_DEBUG_ALLOCS
+/**
+ * @brief Marks the start of a region whose allocations are expected while
+ * handling a keystroke (buffer growth, persisting history edits, and `Tab`
+ * completion), so they are not reported by the keystroke allocation check.
+ */
+#define XD_RL_ALLOC_EXPECTED_BEGIN() (xd_debug_alloc_expected++)
+
+/**
+ * @brief Marks the end of a region started by `XD_RL_ALLOC_EXPECTED_BEGIN()`.
+ */
+#define XD_RL_ALLOC_EXPECTED_END() (xd_debug_alloc_expected--)
+#else
+#define XD_RL_ALLOC_EXPECTED_BEGIN() ((void)0)
+#define XD_RL_ALLOC_EXPECTED_END()   ((void)0)
+#endif
+
+/**
+ * @brief Initial size in bytes of the per-call scratch arena.
+ */
+#define XD_RL_ARENA_INITIAL_SIZE (4096)
+
+/**
+ * @brief Alignment in bytes of the allocations made from the scratch arena.
+ */
+#define XD_RL_ARENA_ALIGNMENT (16)
+
+/**
+ * @brief Factor by which a buffer must exceed what recent lines needed before
+ * it is shrunk, buffers grow by doubling so anything less than `2` would make
+ * them oscillate.
+ */
+#define XD_RL_SHRINK_HYSTERESIS (4)
+
+/**
+ * @brief Largest number of bytes a growable buffer may be asked to hold, small
+ * enough that doubling its capacity and adding the size of its bookkeeping
+ * can't overflow `size_t`.
+ */
+#define XD_RL_CAPACITY_MAX (SIZE_MAX / 4)
+
+/**
+ * @brief Initial size of the buffer used for reading lines when not attached
+ * to a terminal, grown to fit longer lines.
+ */
+#define XD_RL_STREAM_BUFFER_SIZE (256 * 1024)
+
+/**
+ * @brief Number of bytes of the stream buffer covered by each word of its
+ * new-line bitmap, the buffer is allocated with this many extra bytes so the
+ * last block can be indexed whole.
+ */
+#define XD_RL_STREAM_BLOCK_SIZE (64)
+
+/**
+ * @brief Maximum length of a bound key sequence, plus one for the
+ * null-terminator.
+ */
+#define XD_RL_KEYMAP_SEQ_MAX (XD_RL_SMALL_BUFFER_SIZE)
+
+/**
+ * @brief Number of editing actions, the bindings of a dispatch table at or
+ * above it are macros.
+ */
+#define XD_RL_KEYMAP_ACTIONS (XD_RL_ACTION_ABORT + 1)
+
+/**
+ * @brief Maximum nesting of `$include` directives in inputrc files.
+ */
+#define XD_RL_KEYMAP_INCLUDE_MAX (8)
+
+/**
+ * @brief Size of the buffer of input bytes put back to be read again, e.g.
+ * keys typed while waiting for the replies of the terminal.
+ */
+#define XD_RL_INPUT_PENDING_MAX (256)
+
+/**
+ * @brief Default time in milliseconds to wait for the next byte of a key
+ * sequence on a local terminal.
+ */
+#define XD_RL_ESC_TIMEOUT_LOCAL (25)
+
+/**
+ * @brief Default time in milliseconds to wait for the next byte of a key
+ * sequence over SSH, where the bytes may be delayed by the network.
+ */
+#define XD_RL_ESC_TIMEOUT_REMOTE (100)
+
+/**
+ * @brief Maximum time in milliseconds the automatic timeout is raised to when
+ * key sequences are seen split.
+ */
+#define XD_RL_ESC_TIMEOUT_MAX (400)
+
+#if XD_RL_ENABLE_SEARCH
 /**
  * @brief The prompt for reverse history serach.
  */
@@ -73,6 +306,7 @@
  * navigation index is at the last history entry).
  */
 #define XD_RL_SEARCH_IDX_OUT_OF_BOUNDS (-2)
+#endif
 
 // ASCII control characters
 
@@ -88,12 +322,31 @@
 #define XD_RL_ASCII_LF  (10)   // ASCII for `LF` (`Enter`)
 #define XD_RL_ASCII_VT  (11)   // ASCII for `VT` (`Ctrl+K`)
 #define XD_RL_ASCII_FF  (12)   // ASCII for `FF` (`Ctrl+L`)
+#define XD_RL_ASCII_CR  (13)   // ASCII for `CR` (`Ctrl+M`)
 #define XD_RL_ASCII_DC2 (18)   // ASCII for `DC2` (`Ctrl+R`)
 #define XD_RL_ASCII_DC3 (19)   // ASCII for `DC3` (`Ctrl+S`)
 #define XD_RL_ASCII_NAK (21)   // ASCII for `NAK` (`Ctrl+U`)
 #define XD_RL_ASCII_ESC (27)   // ASCII for `ESC` (`Esc`)
 #define XD_RL_ASCII_DEL (127)  // ASCII for `DEL` (`Backspace`)
 
+// Control keys for keyboard shortcuts
+
+#define XD_RL_KEY_CTRL_A    "\001"  // `Ctrl+A` key
+#define XD_RL_KEY_CTRL_B    "\002"  // `Ctrl+B` key
+#define XD_RL_KEY_CTRL_D    "\004"  // `Ctrl+D` key
+#define XD_RL_KEY_CTRL_E    "\005"  // `Ctrl+E` key
+#define XD_RL_KEY_CTRL_F    "\006"  // `Ctrl+F` key
+#define XD_RL_KEY_CTRL_G    "\007"  // `Ctrl+G` key
+#define XD_RL_KEY_CTRL_H    "\010"  // `Ctrl+H` key
+#define XD_RL_KEY_TAB       "\011"  // `Tab` key
+#define XD_RL_KEY_ENTER     "\012"  // `Enter` key
+#define XD_RL_KEY_CTRL_K    "\013"  // `Ctrl+K` key
+#define XD_RL_KEY_CTRL_L    "\014"  // `Ctrl+L` key
+#define XD_RL_KEY_CTRL_R    "\022"  // `Ctrl+R` key
+#define XD_RL_KEY_CTRL_S    "\023"  // `Ctrl+S` key
+#define XD_RL_KEY_CTRL_U    "\025"  // `Ctrl+U` key
+#define XD_RL_KEY_BACKSPACE "\177"  // `Backspace` key
+
 // ANSI escape sequences for keyboard shortcuts
 
 #define XD_RL_ANSI_UP_ARROW    "\033[A"  // ANSI for `Up Arrow` key
@@ -124,18 +377,60 @@
 
 // ANSI sequences' formats
 
-#define XD_RL_ANSI_CRSR_SET_COL "\033[%dG"   // ANSI for setting cursor column
+#define XD_RL_ANSI_CSI_PARAM    "\033[%zu%c"  // ANSI for a CSI with a parameter
 #define XD_RL_ANSI_CRSR_MV_HOME "\033[H"     // ANSI for moving cursor to (1, 1)
-#define XD_RL_ANSI_CRSR_MV_UP   "\033[%dA"   // ANSI for moving cursor up
-#define XD_RL_ANSI_CRSR_MV_DN   "\033[%dB"   // ANSI for moving cursor down
 #define XD_RL_ANSI_LINE_CLR     "\033[2K\r"  // ANSI for clearing current line
+#define XD_RL_ANSI_LINE_CLR_END "\033[K"    // ANSI for clearing to line end
 #define XD_RL_ANSI_SCRN_CLR     "\033[2J"    // ANSI for clearing the screen
+#define XD_RL_ANSI_CLR_BELOW    "\033[J"     // ANSI for clearing below crsr
+
+// final bytes of the CSI sequences used for moving the cursor
+
+#define XD_RL_CSI_CRSR_UP    'A'  // CSI final byte for moving cursor up
+#define XD_RL_CSI_CRSR_DOWN  'B'  // CSI final byte for moving cursor down
+#define XD_RL_CSI_CRSR_RIGHT 'C'  // CSI final byte for moving cursor right
+#define XD_RL_CSI_CRSR_LEFT  'D'  // CSI final byte for moving cursor left
+#define XD_RL_CSI_CRSR_COL   'G'  // CSI final byte for setting cursor column
 
 #define XD_RL_ANSI_CRSR_REQ_POS "\033[6n"  // ANSI for requesting crsr position
 
+#define XD_RL_ANSI_SYNC_REQ   "\033[?2026$p"  // ANSI for requesting sync mode
+#define XD_RL_ANSI_SYNC_REPLY "\033[?2026;"   // ANSI for sync mode report
+#define XD_RL_ANSI_SYNC_BEGIN "\033[?2026h"   // ANSI for beginning sync update
+#define XD_RL_ANSI_SYNC_END   "\033[?2026l"   // ANSI for ending sync update
+#define XD_RL_ANSI_KITTY_REQ  "\033[?u"       // ANSI for requesting key flags
+#define XD_RL_ANSI_KITTY_PUSH "\033[>1u"      // ANSI for disambiguating keys
+#define XD_RL_ANSI_KITTY_POP  "\033[<u"       // ANSI for restoring key flags
+
+// modifier bits of the keys reported by the keyboard enhancement protocol
+
+#define XD_RL_KITTY_MOD_SHIFT (1)          // `Shift` modifier bit
+#define XD_RL_KITTY_MOD_ALT   (2)          // `Alt` modifier bit
+#define XD_RL_KITTY_MOD_CTRL  (4)          // `Ctrl` modifier bit
+#define XD_RL_KITTY_MOD_LOCKS (64 | 128)   // `Caps Lock` and `Num Lock` bits
+
 #define XD_RL_ANSI_TEXT_HIGHLIGHT "\033[30;107m"  // ANSI for text highlight
+#define XD_RL_ANSI_TEXT_DIM       "\033[2m"       // ANSI for dim text
 #define XD_RL_ANSI_TEXT_RESET     "\033[0m"       // ANSI for text restore
 
+/**
+ * @brief Size of the buffer used for formatting a transition between two text
+ * attribute states, enough for every attribute and two RGB colors.
+ */
+#define XD_RL_SGR_BUFFER_SIZE (4 * XD_RL_SMALL_BUFFER_SIZE)
+
+// encoding of the colors of a text attribute state
+
+#define XD_RL_SGR_COLOR_DEFAULT (0)          // the terminal's default color
+#define XD_RL_SGR_COLOR_INDEXED (0x100)      // flag of a palette color index
+#define XD_RL_SGR_COLOR_RGB     (0x1000000)  // flag of a 24-bit RGB color
+
+/**
+ * @brief Mask of the attributes turned off together by the SGR code 22 (normal
+ * intensity), bold (1) and dim (2).
+ */
+#define XD_RL_SGR_INTENSITY ((1 << 1) | (1 << 2))
+
 // ========================
 // Typedefs
 // ========================
@@ -146,22 +441,118 @@
 typedef void (*xd_input_handler_func)(void);
 
 /**
- * @brief Represents an ANSI escape sequence to input handler function binding.
+ * @brief Represents a default key sequence to editing action binding.
+ */
+typedef struct xd_keymap_default_t {
+  const char *sequence;               // The key sequence string.
+  const xd_readline_action_t action;  // The bound action.
+} xd_keymap_default_t;
+
+/**
+ * @brief Represents a key binding added with `xd_readline_bind()` or
+ * `xd_readline_bind_macro()`, overriding the default one.
+ */
+typedef struct xd_keymap_binding_t {
+  char *sequence;               // The key sequence string.
+  char *macro;                  // The macro text, or `NULL` for an action.
+  xd_readline_action_t action;  // The bound action, unless a macro.
+} xd_keymap_binding_t;
+
+/**
+ * @brief Represents the binding of a byte in a dispatch table.
+ */
+typedef struct xd_keymap_entry_t {
+  uint16_t binding;  // The action bound to the sequence ending with the byte,
+                     // or `XD_RL_KEYMAP_ACTIONS` plus its macro binding index.
+  uint16_t next;     // Index of the table of the bytes following the byte in
+                     // longer bound sequences, or `0` if none.
+} xd_keymap_entry_t;
+
+/**
+ * @brief Dispatch table of the bindings of every byte after a key sequence
+ * prefix, tables form a trie rooted at the table for the first byte.
  */
-typedef struct xd_esc_seq_binding_t {
-  const char *sequence;                 // The escape sequence string.
-  const xd_input_handler_func handler;  // The handler function.
-} xd_esc_seq_binding_t;
+typedef xd_keymap_entry_t xd_keymap_table_t[256];
+
+/**
+ * @brief Represents an overflow block of the scratch arena, allocated when an
+ * allocation doesn't fit in the arena's main block.
+ */
+typedef struct xd_arena_block_t {
+  struct xd_arena_block_t *next;  // The previously allocated overflow block.
+  size_t capacity;                // The size of the block's data in bytes.
+  size_t used;                    // The number of bytes allocated so far.
+  _Alignas(XD_RL_ARENA_ALIGNMENT) unsigned char data[];  // The block's data.
+} xd_arena_block_t;
 
 /**
  * @brief Represents a history entry.
  */
 typedef struct xd_history_entry_t {
-  char *str;     // The history string.
-  int capacity;  // The capacity of the history string.
-  int length;    // The length of the history string.
+  char *str;      // The history string, inline or owned by an interned string.
+  size_t length;  // The length of the history string.
+  uint64_t mask;  // Bitmask of the bytes present in the history string.
+  uint32_t hash;  // The hash of the history string.
+  int hits;       // Number of times the entry was recalled and accepted.
+  char inline_str[XD_RL_HISTORY_INLINE_SIZE];  // Storage for short strings.
 } xd_history_entry_t;
 
+/**
+ * @brief Represents an interned history string, shared by all the history
+ * entries having the same (long) string.
+ */
+typedef struct xd_intern_t {
+  struct xd_intern_t *next;  // The next interned string in the same bucket.
+  uint32_t hash;             // The hash of the string.
+  int refcount;              // The number of references to the string.
+  size_t length;             // The length of the string.
+  char str[];                // The null-terminated string.
+} xd_intern_t;
+
+/**
+ * @brief Represents a command that followed another command in the history,
+ * and how many times it did.
+ */
+typedef struct xd_successor_t {
+  xd_history_entry_t command;  // The following command.
+  int count;                   // The number of times it followed.
+} xd_successor_t;
+
+/**
+ * @brief Represents the most frequent successors of a command.
+ */
+typedef struct xd_successor_set_t {
+  uint32_t hash;  // The hash of the preceding command.
+  int used;       // Whether the set is in use (non-zero) or not (zero).
+  xd_successor_t successors[XD_RL_PREDICT_WAYS];  // The successors.
+} xd_successor_set_t;
+
+/**
+ * @brief Represents an inclusive range of Unicode code points.
+ */
+typedef struct xd_unicode_range_t {
+  uint32_t first;  // The first code point in the range.
+  uint32_t last;   // The last code point in the range.
+} xd_unicode_range_t;
+
+/**
+ * @brief Represents the text attributes set by SGR sequences.
+ */
+typedef struct xd_tty_sgr_t {
+  uint32_t attrs;  // Bit `n` is set when the attribute of SGR code `n` is on.
+  uint32_t fg;     // The foreground color, see `XD_RL_SGR_COLOR_*`.
+  uint32_t bg;     // The background color, see `XD_RL_SGR_COLOR_*`.
+} xd_tty_sgr_t;
+
+/**
+ * @brief Represents a logical line of the input after the first, which starts
+ * after a new-line.
+ */
+typedef struct xd_input_line_t {
+  size_t start;  // The index of the line's first byte in the input buffer.
+  size_t row;    // The row the line was last displayed from (1-based).
+} xd_input_line_t;
+
 /**
  * @brief Represents the running mode of `xd_readline`.
  */
@@ -175,48 +566,173 @@ typedef enum xd_readline_mode_t {
 // Function Declarations
 // ========================
 
-static char *xd_util_longest_common_prefix(const char **strings);
+static void *xd_util_malloc(size_t size);
+static void *xd_util_realloc(void *ptr, size_t size);
+static void xd_util_free(void *ptr);
+static char *xd_util_strndup(const char *str, size_t length);
+static ssize_t xd_util_read_line(FILE *file, char **line, size_t *capacity);
+
+static int xd_memory_fits(size_t size);
+static void xd_memory_account(xd_readline_memory_subsystem_t subsystem,
+                              size_t old_size, size_t new_size);
+static size_t xd_memory_grow_target(size_t capacity, size_t length,
+                                    size_t extra, size_t minimum);
+static size_t xd_memory_shrink_target(size_t capacity, size_t recent,
+                                      size_t minimum);
+static void xd_memory_shrink();
+
+static void *xd_arena_alloc(size_t size);
+static void xd_arena_reset();
+static void xd_arena_destroy();
+
+#if XD_RL_ENABLE_COMPLETION
+static int xd_arena_owns(const void *ptr);
+static size_t xd_util_longest_common_prefix(const char **strings);
+#if XD_RL_ENABLE_COMPLETION_LIST
 static void xd_util_print_completions(char **completions);
 static const char *xd_util_base_name_keep_trailing_slash(const char *path);
-
-static void xd_readline_init() __attribute__((constructor));
+#endif
+#endif
+static uint64_t xd_util_byte_mask(const char *str, size_t length);
+static uint32_t xd_util_hash(const char *str, size_t length);
+static off_t xd_util_file_tail_offset(FILE *file, int lines);
+static void xd_util_width_table_init();
+static int xd_util_codepoint_width(uint32_t codepoint);
+static size_t xd_util_utf8_decode(const char *str, size_t length,
+                                  uint32_t *codepoint);
+static size_t xd_util_utf8_encode(uint32_t codepoint, char *str);
+static size_t xd_util_str_width(const char *str, size_t length);
+static size_t xd_util_str_advance(const char *str, size_t length, size_t pos,
+                                  size_t win_width);
+static size_t xd_util_utf8_next(const char *str, size_t length, size_t idx);
+static size_t xd_util_utf8_prev(const char *str, size_t idx);
+static size_t xd_util_utf8_sync(const char *str, size_t length, size_t idx);
+static void xd_util_char_class_init(const char *word_chars);
+static int xd_util_is_word_char(char chr);
+static size_t xd_util_word_scan_forward(const char *str, size_t idx,
+                                        size_t length, int in_word);
+static size_t xd_util_word_scan_backward(const char *str, size_t idx,
+                                         int in_word);
+
+static int xd_readline_lazy_init();
 static void xd_readline_destroy() __attribute__((destructor));
 
-static void xd_readline_history_init();
+static int xd_readline_buffers_init();
+static void xd_readline_buffers_destroy();
+
+static int xd_readline_history_init();
+static size_t xd_readline_history_tables_size();
 static void xd_readline_history_destroy();
+static int xd_readline_history_evict(int interned_only);
+static int xd_readline_history_add_n(const char *str, size_t length);
+
+static xd_intern_t *xd_intern_acquire(const char *str, size_t length,
+                                      uint32_t hash);
+static void xd_intern_release(xd_intern_t *intern);
+
+static int xd_history_entry_is_interned(
+    const xd_history_entry_t *history_entry);
+static void xd_history_entry_reset(xd_history_entry_t *history_entry);
+static int xd_history_entry_set(xd_history_entry_t *history_entry,
+                                const char *str, size_t length, uint32_t hash);
+static int xd_history_scratch_set(const char *str, size_t length,
+                                  uint32_t hash);
+static void xd_history_entry_write(const xd_history_entry_t *history_entry,
+                                   FILE *file);
+static size_t xd_history_record_unescape(char *record, size_t length);
+
+#if XD_RL_ENABLE_SUGGESTION
+static int xd_history_entry_equals(const xd_history_entry_t *first,
+                                   const xd_history_entry_t *second);
+static void xd_readline_predict_reset();
+static void xd_readline_predict_update(const xd_history_entry_t *command);
+static const xd_history_entry_t *xd_readline_predict_next();
+#endif
 
 static void xd_input_buffer_insert(char chr);
-static void xd_input_buffer_insert_string(const char *str);
-static void xd_input_buffer_remove_before_cursor(int n);
-static void xd_input_buffer_remove_from_cursor(int n);
-
-static int xd_input_buffer_get_current_word_end();
-static int xd_input_buffer_get_current_word_start();
-
+#if XD_RL_ENABLE_COMPLETION
+static void xd_input_buffer_insert_string(const char *str, size_t length);
+#endif
+static int xd_input_buffer_reserve(size_t n);
+static size_t xd_input_buffer_size(size_t capacity);
+static int xd_input_buffer_exchange(char **buffer, size_t *capacity);
+
+static void xd_input_buffer_invalidate(size_t idx);
+static size_t xd_input_buffer_advance(size_t start, size_t end, size_t pos);
+static size_t xd_input_buffer_column(size_t idx);
+static size_t xd_input_buffer_width(size_t start, size_t end);
+static int xd_input_lines_reserve(size_t n);
+static int xd_input_lines_update(size_t idx);
+static size_t xd_input_lines_find(size_t idx);
+static inline size_t xd_input_line_start(size_t line);
+static size_t xd_input_line_end(size_t line);
+static void xd_input_buffer_remove_before_cursor(size_t n);
+static void xd_input_buffer_remove_from_cursor(size_t n);
+
+static size_t xd_input_buffer_get_current_word_end();
+static size_t xd_input_buffer_get_current_word_start();
+
+static void xd_input_buffer_move_to_line(size_t line);
 static void xd_input_buffer_save_to_history();
 static void xd_input_buffer_load_from_history();
+static void xd_input_buffer_load_entry(const xd_history_entry_t *entry);
+#if XD_RL_ENABLE_SUGGESTION
+static int xd_input_buffer_accept_suggestion();
+#endif
 
-static void xd_tty_raw();
+static int xd_tty_raw();
 static void xd_tty_restore();
-
+static void xd_tty_win_width_update();
+
+static size_t xd_tty_query(const char *query, char terminator, char *replies,
+                           size_t size);
+static int xd_tty_caps_cache_path(char *path, size_t size);
+static size_t xd_tty_caps_cache_key(char *key, size_t size);
+static int xd_tty_caps_cache_load();
+static void xd_tty_caps_cache_save();
 static void xd_tty_cursor_fix_initial_pos();
 
 static inline void xd_tty_bell();
 
 static void xd_tty_input_clear();
 static void xd_tty_input_redraw();
+static int xd_tty_input_repaint();
+static size_t xd_tty_input_flat_pos(size_t idx);
+static size_t xd_tty_input_cursor_pos(size_t idx);
 
 static void xd_tty_screen_resize();
 
 static void xd_tty_write_ansii_sequence(const char *format, ...);
-static void xd_tty_write(const void *data, int length);
-static void xd_tty_write_track(const void *data, int length);
-static void xd_tty_write_colored_track(const void *data, int length);
-
-static void xd_tty_cursor_move_left_wrap(int n);
-static void xd_tty_cursor_move_right_wrap(int n);
-
-static void xd_input_handle_printable(char chr);
+static size_t xd_tty_write_direct(const void *data, size_t length);
+static size_t xd_tty_write(const void *data, size_t length);
+static void xd_tty_flush();
+static void xd_tty_write_track(const void *data, size_t length);
+static void xd_tty_write_colored_track(const void *data, size_t length);
+static void xd_tty_write_input(size_t start, size_t end);
+
+static int xd_tty_sgr_parse(const char *params, size_t length,
+                            xd_tty_sgr_t *state);
+static size_t xd_tty_sgr_format_code(char *buffer, size_t length,
+                                     unsigned int code);
+static size_t xd_tty_sgr_format_color(char *buffer, size_t length,
+                                      uint32_t color, unsigned int base);
+static size_t xd_tty_sgr_format(char *buffer, const xd_tty_sgr_t *from,
+                                const xd_tty_sgr_t *to);
+static void xd_tty_sgr_set(const char *seq, size_t length);
+static void xd_tty_sgr_sync();
+
+static size_t xd_tty_csi_length(size_t n);
+static size_t xd_tty_csi_format(char *buffer, size_t n, char final);
+static void xd_tty_cursor_move_to(size_t row, size_t col, const char *text,
+                                  size_t length);
+static void xd_tty_cursor_move_left_wrap(size_t n);
+static void xd_tty_cursor_move_right_wrap(size_t n);
+static void xd_tty_cursor_move_input(size_t from, size_t to);
+
+static void xd_input_handle_printable(const char *str, size_t length);
+static void xd_input_handle_utf8(char lead);
+static void xd_input_handle_csi(char *seq, size_t length);
+static void xd_input_handle_kitty_key(const char *params);
 
 static void xd_input_handle_ctrl_a();
 static void xd_input_handle_ctrl_b();
@@ -227,50 +743,69 @@ static void xd_input_handle_ctrl_g();
 static void xd_input_handle_ctrl_h();
 static void xd_input_handle_ctrl_k();
 static void xd_input_handle_ctrl_l();
+#if XD_RL_ENABLE_SEARCH
 static void xd_input_handle_ctrl_r();
 static void xd_input_handle_ctrl_s();
+#endif
 static void xd_input_handle_ctrl_u();
 
+#if XD_RL_ENABLE_COMPLETION
 static void xd_input_handle_tab();
+#endif
 
-static void xd_input_handle_backspace();
 static void xd_input_handle_enter();
 
 static void xd_input_handle_up_arrow();
 static void xd_input_handle_down_arrow();
-static void xd_input_handle_right_arrow();
-static void xd_input_handle_left_arrow();
 
-static void xd_input_handle_page_up();
-static void xd_input_handle_page_down();
-static void xd_input_handle_home();
-static void xd_input_handle_end();
 static void xd_input_handle_delete();
 
 static void xd_input_handler_ctrl_up_arrow();
 static void xd_input_handler_ctrl_down_arrow();
-static void xd_input_handle_ctrl_right_arrow();
-static void xd_input_handle_ctrl_left_arrow();
-
-static void xd_input_handler_ctrl_page_up();
-static void xd_input_handler_ctrl_page_down();
-static void xd_input_handle_ctrl_delete();
 
 static void xd_input_handle_alt_f();
 static void xd_input_handle_alt_b();
 static void xd_input_handle_alt_d();
 static void xd_input_handle_alt_backspace();
 
-static void xd_input_handle_escape_sequence();
-
-static void xd_input_handle_control(char chr);
-
+static ssize_t xd_input_read_byte(char *chr);
+static void xd_input_unread_byte(char chr);
+static void xd_input_pending_prepend(const char *bytes, size_t length);
+static int xd_input_byte_ready(int timeout);
+static int xd_input_esc_timeout();
 static void xd_input_handler(char chr);
 
+static int xd_keymap_set(const char *sequence, xd_readline_action_t action,
+                         const char *macro);
+static int xd_keymap_compile();
+static int xd_keymap_compile_add(const char *sequence, uint16_t binding,
+                                 size_t *length, size_t capacity);
+static void xd_keymap_execute(uint16_t binding, char chr);
+static void xd_keymap_destroy();
+static xd_readline_action_t xd_keymap_action_from_name(const char *name);
+static size_t xd_keymap_unescape(char *str, char quote, char **end);
+static size_t xd_keymap_parse_key_name(const char *name, char *sequence);
+static int xd_keymap_condition(const char *condition);
+static int xd_keymap_load_file(const char *path, int depth);
+static void xd_keymap_load_line(char *line);
+
+#if XD_RL_ENABLE_SEARCH
 static void xd_readline_history_reverse_search();
 static void xd_readline_history_forward_search();
+#endif
+
+static size_t xd_stream_size(size_t capacity);
+static int xd_stream_resize(size_t capacity);
+static void xd_stream_index(size_t from);
+static size_t xd_stream_find_newline(size_t idx);
+static ssize_t xd_stream_fill();
+static char *xd_stream_read_line();
+static void xd_stream_destroy();
 
 static void xd_sigwinch_handler(int sig_num);
+static void xd_sigwinch_install();
+static void xd_sigwinch_restore();
+
 
 // ========================
 // Variables
@@ -284,30 +819,104 @@ static struct termios xd_original_tty_attributes;
 /**
  * @brief The terminal current window width.
  */
-static int xd_tty_win_width = 0;
+static size_t xd_tty_win_width = 0;
+
+/**
+ * @brief The terminal output buffered since the last flush.
+ */
+static char xd_tty_output[XD_RL_OUTPUT_BUFFER_SIZE];
+
+/**
+ * @brief The length of the buffered terminal output.
+ */
+static size_t xd_tty_output_length = 0;
+
+/**
+ * @brief Whether a synchronized update was begun for the buffered output
+ * (non-zero) or not (zero), it's ended when the output is flushed.
+ */
+static int xd_tty_output_synced = 0;
+
+/**
+ * @brief The capabilities of the terminal, see `XD_RL_TTY_CAP_*`, or `-1` if
+ * it hasn't been asked yet.
+ */
+static int xd_tty_caps = -1;
 
 /**
  * @brief Indicates whether `SIGWINCH` signal has been received.
  */
 static volatile sig_atomic_t xd_tty_win_resized = 0;
 
+/**
+ * @brief Whether to handle `SIGWINCH` while `xd_readline()` is running
+ * (non-zero) or leave its disposition untouched (zero), see
+ * `xd_readline_init_ex()`.
+ */
+static int xd_sigwinch_enabled = 1;
+
+/**
+ * @brief Whether the `SIGWINCH` handler is currently installed (non-zero) or
+ * not (zero).
+ */
+static int xd_sigwinch_installed = 0;
+
+/**
+ * @brief The `SIGWINCH` disposition replaced while `xd_readline()` is running,
+ * restored when it returns.
+ */
+static struct sigaction xd_sigwinch_original_action;
+
 /**
  * @brief The terminal cursor row position (1-based) relative to the beginning
  * of the prompt.
  */
-static int xd_tty_cursor_row = 1;
+static size_t xd_tty_cursor_row = 1;
 
 /**
  * @brief The terminal cursor column position (1-based) relative to the
  * beginning of the prompt.
  */
-static int xd_tty_cursor_col = 1;
+static size_t xd_tty_cursor_col = 1;
 
 /**
  * @brief The number of characters currently displayed in the terminal (prompt +
  * input).
  */
-static int xd_tty_chars_count = 0;
+static size_t xd_tty_chars_count = 0;
+
+/**
+ * @brief The flat position (`(row - 1) * xd_tty_win_width + col - 1`) the
+ * input is displayed from, right after the prompt.
+ */
+static size_t xd_tty_input_origin = 0;
+
+/**
+ * @brief The number of logical lines of the input displayed as laid out in
+ * `xd_input_lines`, so edits are repainted from the first modified line, or
+ * `0` if the prompt and the input must be redrawn whole.
+ */
+static size_t xd_tty_lines_drawn = 0;
+
+/**
+ * @brief The text attributes the terminal currently has.
+ */
+static xd_tty_sgr_t xd_tty_sgr_current;
+
+/**
+ * @brief The text attributes the next written text should have, the terminal
+ * is only switched to them right before writing text and at the end of a
+ * redraw.
+ */
+static xd_tty_sgr_t xd_tty_sgr_wanted;
+
+/**
+ * @brief Whether SGR sequences are written as is (non-zero) since the terminal
+ * may have attributes that aren't tracked, until a supported sequence resets
+ * them. It's set at the start of every line since the caller may have left
+ * attributes on, and when a sequence has codes that aren't supported.
+ */
+static int xd_tty_sgr_verbatim = 1;
 
 /**
  * @brief The previous char read from `stdin` using `read()`.
@@ -322,406 +931,3053 @@ static char *xd_input_buffer = NULL;
 /**
  * @brief The current capacity (max-length) of the input buffer.
  */
-static int xd_input_capacity = LINE_MAX;
+static size_t xd_input_capacity = LINE_MAX;
 
 /**
  * @brief The current length of the input buffer.
  */
-static int xd_input_length = 0;
+static size_t xd_input_length = 0;
 
 /**
  * @brief The logical position of the cursor within the input buffer.
  */
-static int xd_input_cursor = 0;
+static size_t xd_input_cursor = 0;
 
 /**
- * @brief Indicates whether to redraw the prompt and input befor reading another
- * character (non-zero) or not (zero).
+ * @brief Display column index of the input buffer, entry `i` holds the number
+ * of columns the input before byte `i * XD_RL_COLUMN_CHUNK_SIZE` advances the
+ * cursor by when displayed, including the columns left empty at the end of
+ * rows.
  */
-static int xd_readline_redraw = 0;
+static size_t *xd_input_column_prefix = NULL;
 
 /**
- * @brief Indicates whether readline finished (non-zero) or not (zero).
+ * @brief Number of leading entries of `xd_input_column_prefix` after the first
+ * which are up to date, entry `0` is always `0`.
  */
-static int xd_readline_finished = 0;
+static size_t xd_input_column_valid = 0;
 
 /**
- * @brief The pointer to be returned when `xd_readline()` finishes.
+ * @brief The column (0-based) the input is displayed from that the display
+ * column index was built for, which decides where rows end within the input.
  */
-static char *xd_readline_return = NULL;
+static size_t xd_input_column_origin = 0;
 
 /**
- * @brief The length of the input prompt string.
+ * @brief The terminal width the display column index was built for.
  */
-static int xd_readline_prompt_length = 0;
+static size_t xd_input_column_win_width = 0;
 
 /**
- * @brief The history array (circular buffer)
+ * @brief Line index of the input buffer, entry `i` describes the logical line
+ * following the `i + 1`-th new-line, so the line holding an index is found by
+ * a binary search.
  */
-static xd_history_entry_t **xd_history = NULL;
+static xd_input_line_t *xd_input_lines = NULL;
 
 /**
- * @brief Index of the current history entry.
+ * @brief The number of entries `xd_input_lines` can hold.
  */
-static int xd_history_nav_idx = XD_RL_HISTORY_MAX;
+static size_t xd_input_lines_capacity = 0;
 
 /**
- * @brief Index of the first history entry.
+ * @brief Number of leading entries of `xd_input_lines` which are up to date.
  */
-static int xd_history_start_idx = 0;
+static size_t xd_input_lines_count = 0;
 
 /**
- * @brief Index of the last history entry.
+ * @brief Index of the input buffer before which all the new-lines are in the
+ * line index.
  */
-static int xd_history_end_idx = XD_RL_HISTORY_MAX - 1;
+static size_t xd_input_lines_scanned = 0;
 
 /**
- * @brief The number of entries currently stored in history.
+ * @brief Index of the first byte of the input buffer modified since the input
+ * was last displayed, or `SIZE_MAX` if none.
  */
-static int xd_history_length = 0;
+static size_t xd_input_dirty_idx = SIZE_MAX;
 
 /**
- * @brief The current running mode of `xd_readline`.
+ * @brief Buffer of the input read when not attached to a terminal, the lines
+ * returned are null-terminated in place.
  */
-static xd_readline_mode_t xd_readline_mode = XD_READLINE_NORMAL;
+static char *xd_stream_buffer = NULL;
 
 /**
- * @brief History search prompt.
+ * @brief Bitmap of the new-lines in the stream buffer, bit `i % 64` of word
+ * `i / 64` is set if byte `i` is a new-line, built once as the input is read so
+ * finding the end of each line takes a few bit operations.
  */
-static const char *xd_search_prompt = "";
+static uint64_t *xd_stream_newlines = NULL;
 
 /**
- * @brief History search query.
+ * @brief The capacity of the stream buffer, excluding the bytes reserved after
+ * it for terminating the last line and for indexing.
  */
-static char *xd_search_query_buffer = NULL;
+static size_t xd_stream_capacity = 0;
 
 /**
- * @brief History search query length.
+ * @brief Index of the first byte of the stream buffer not returned yet.
  */
-static int xd_search_query_length = 0;
+static size_t xd_stream_start = 0;
 
 /**
- * @brief History index used while searching.
+ * @brief Index after the last byte read into the stream buffer.
  */
-static int xd_search_idx = XD_RL_SEARCH_IDX_NEW;
+static size_t xd_stream_end = 0;
 
 /**
- * @brief History navigation index before starting history search.
+ * @brief The byte at `xd_stream_start` overwritten by the null-terminator of
+ * the last line returned, restored on the next read, or `-1` if none.
  */
-static int xd_search_original_nav_idx = 0;
+static int xd_stream_saved_char = -1;
 
 /**
- * @brief Input cursor before starting history search.
+ * @brief Indicates whether to redraw the prompt and input befor reading another
+ * character (non-zero) or not (zero).
  */
-static int xd_search_original_input_cursor = 0;
-
-/**
- * @brief Start position of search result (current input) highlight.
- */
-static int xd_search_result_highlight_start = -1;
-
-/**
- * @brief Array mapping ANSI escape sequences to corresponding input
- * handlers.
- */
-static const xd_esc_seq_binding_t xd_esc_seq_bindings[] = {
-    {XD_RL_ANSI_UP_ARROW,     xd_input_handle_up_arrow        },
-    {XD_RL_ANSI_DOWN_ARROW,   xd_input_handle_down_arrow      },
-    {XD_RL_ANSI_RIGHT_ARROW,  xd_input_handle_right_arrow     },
-    {XD_RL_ANSI_LEFT_ARROW,   xd_input_handle_left_arrow      },
-    {XD_RL_ANSI_PAGE_UP,      xd_input_handle_page_up         },
-    {XD_RL_ANSI_PAGE_DOWN,    xd_input_handle_page_down       },
-    {XD_RL_ANSI_HOME,         xd_input_handle_home            },
-    {XD_RL_ANSI_END,          xd_input_handle_end             },
-    {XD_RL_ANSI_DELETE,       xd_input_handle_delete          },
-    {XD_RL_ANSI_ALT_F,        xd_input_handle_alt_f           },
-    {XD_RL_ANSI_ALT_B,        xd_input_handle_alt_b           },
-    {XD_RL_ANSI_ALT_D,        xd_input_handle_alt_d           },
-    {XD_RL_ANSI_ALT_BS,       xd_input_handle_alt_backspace   },
-    {XD_RL_ANSI_CTRL_UARROW,  xd_input_handler_ctrl_up_arrow  },
-    {XD_RL_ANSI_CTRL_DARROW,  xd_input_handler_ctrl_down_arrow},
-    {XD_RL_ANSI_CTRL_RARROW,  xd_input_handle_ctrl_right_arrow},
-    {XD_RL_ANSI_CTRL_LARROW,  xd_input_handle_ctrl_left_arrow },
-    {XD_RL_ANSI_CTRL_PAGE_UP, xd_input_handler_ctrl_page_up   },
-    {XD_RL_ANSI_CTRL_PAGE_DN, xd_input_handler_ctrl_page_down },
-    {XD_RL_ANSI_CTRL_DELETE,  xd_input_handle_ctrl_delete     },
-};
+static int xd_readline_redraw = 0;
 
 /**
- * @brief Number of defined escape sequence bindings.
+ * @brief Indicates whether readline finished (non-zero) or not (zero).
  */
-static const int xd_esc_seq_bindings_length =
-    sizeof(xd_esc_seq_bindings) / sizeof(xd_esc_seq_bindings[0]);
+static int xd_readline_finished = 0;
 
-// ========================
-// Public Variables
-// ========================
+/**
+ * @brief The pointer to be returned when `xd_readline()` finishes.
+ */
+static char *xd_readline_return = NULL;
 
-xd_readline_completion_gen_func_t xd_readline_completions_generator = NULL;
+/**
+ * @brief The length of the line returned by the last call to `xd_readline()`.
+ */
+static size_t xd_readline_return_length = 0;
 
-const char *xd_readline_prompt = NULL;
+/**
+ * @brief The length of the input prompt string.
+ */
+static size_t xd_readline_prompt_length = 0;
 
-// ========================
+/**
+ * @brief The history array (circular buffer)
+ */
+static xd_history_entry_t **xd_history = NULL;
+
+/**
+ * @brief Contiguous storage of the history entries pointed to by `xd_history`.
+ */
+static xd_history_entry_t *xd_history_entries = NULL;
+
+/**
+ * @brief Hash table of the interned history strings (separate chaining).
+ */
+static xd_intern_t **xd_intern_table = NULL;
+
+/**
+ * @brief Direct-mapped table of the most frequent successors of the commands
+ * added to the history, indexed by the hash of the preceding command.
+ */
+static xd_successor_set_t *xd_predict_table = NULL;
+
+#if XD_RL_ENABLE_SUGGESTION
+/**
+ * @brief The hash of the last command added to the history.
+ */
+static uint32_t xd_predict_last_hash = 0;
+
+/**
+ * @brief Indicates whether a command was added to the history since the
+ * prediction state was reset (non-zero) or not (zero).
+ */
+static int xd_predict_has_last = 0;
+
+/**
+ * @brief The command suggested while the input is empty, or `NULL` if there is
+ * none.
+ */
+static const xd_history_entry_t *xd_suggestion = NULL;
+#endif
+
+/**
+ * @brief Indicates whether the suggestion is currently displayed (non-zero) or
+ * not (zero).
+ */
+static int xd_suggestion_visible = 0;
+
+/**
+ * @brief Storage owned by the scratch history slot (at `XD_RL_HISTORY_MAX`)
+ * for input too long to fit inline, reused across keystrokes and lines so
+ * saving the input while navigating doesn't allocate.
+ */
+static char *xd_history_scratch = NULL;
+
+/**
+ * @brief Capacity of `xd_history_scratch`.
+ */
+static size_t xd_history_scratch_capacity = 0;
+
+/**
+ * @brief Index of the current history entry.
+ */
+static int xd_history_nav_idx = XD_RL_HISTORY_MAX;
+
+/**
+ * @brief Index of the first history entry.
+ */
+static int xd_history_start_idx = 0;
+
+/**
+ * @brief Index of the last history entry.
+ */
+static int xd_history_end_idx = XD_RL_HISTORY_MAX - 1;
+
+/**
+ * @brief The number of entries currently stored in history.
+ */
+static int xd_history_length = 0;
+
+/**
+ * @brief The total length of the strings of the entries currently stored in
+ * history.
+ */
+static size_t xd_history_bytes = 0;
+
+/**
+ * @brief The current running mode of `xd_readline`.
+ */
+static xd_readline_mode_t xd_readline_mode = XD_READLINE_NORMAL;
+
+#if XD_RL_ENABLE_SEARCH
+/**
+ * @brief History search prompt.
+ */
+static const char *xd_search_prompt = "";
+
+/**
+ * @brief History search query.
+ */
+static char *xd_search_query_buffer = NULL;
+
+/**
+ * @brief History search query length.
+ */
+static size_t xd_search_query_length = 0;
+
+/**
+ * @brief History index used while searching.
+ */
+static int xd_search_idx = XD_RL_SEARCH_IDX_NEW;
+
+/**
+ * @brief History navigation index before starting history search.
+ */
+static int xd_search_original_nav_idx = 0;
+
+/**
+ * @brief Input cursor before starting history search.
+ */
+static size_t xd_search_original_input_cursor = 0;
+
+/**
+ * @brief Start position of search result (current input) highlight, or `-1`
+ * if there is no result.
+ */
+static ptrdiff_t xd_search_result_highlight_start = -1;
+#endif
+
+/**
+ * @brief First level of the display width table, maps the high bits of a code
+ * point to the block holding the widths of its `256` code points.
+ */
+static uint8_t xd_width_stage1[XD_RL_WIDTH_STAGE1_SIZE];
+
+/**
+ * @brief Second level of the display width table, the distinct blocks of
+ * 2-bit packed code point widths.
+ */
+static uint8_t xd_width_stage2[XD_RL_WIDTH_BLOCKS_MAX][XD_RL_WIDTH_BLOCK_BYTES];
+
+/**
+ * @brief Number of distinct blocks in `xd_width_stage2`.
+ */
+static int xd_width_blocks_count = 0;
+
+/**
+ * @brief Ranges of zero-width code points (combining marks, format
+ * characters, and Hangul medial vowels and final consonants), generated from
+ * the Unicode Character Database 14.0.
+ */
+static const xd_unicode_range_t xd_unicode_zero_width_ranges[] = {
+    {0x0300, 0x036F}, {0x0483, 0x0489}, {0x0591, 0x05BD}, {0x05BF, 0x05BF},
+    {0x05C1, 0x05C2}, {0x05C4, 0x05C5}, {0x05C7, 0x05C7}, {0x0600, 0x0605},
+    {0x0610, 0x061A}, {0x061C, 0x061C}, {0x064B, 0x065F}, {0x0670, 0x0670},
+    {0x06D6, 0x06DD}, {0x06DF, 0x06E4}, {0x06E7, 0x06E8}, {0x06EA, 0x06ED},
+    {0x070F, 0x070F}, {0x0711, 0x0711}, {0x0730, 0x074A}, {0x07A6, 0x07B0},
+    {0x07EB, 0x07F3}, {0x07FD, 0x07FD}, {0x0816, 0x0819}, {0x081B, 0x0823},
+    {0x0825, 0x0827}, {0x0829, 0x082D}, {0x0859, 0x085B}, {0x0890, 0x089F},
+    {0x08CA, 0x0902}, {0x093A, 0x093A}, {0x093C, 0x093C}, {0x0941, 0x0948},
+    {0x094D, 0x094D}, {0x0951, 0x0957}, {0x0962, 0x0963}, {0x0981, 0x0981},
+    {0x09BC, 0x09BC}, {0x09C1, 0x09C4}, {0x09CD, 0x09CD}, {0x09E2, 0x09E3},
+    {0x09FE, 0x0A02}, {0x0A3C, 0x0A3C}, {0x0A41, 0x0A51}, {0x0A70, 0x0A71},
+    {0x0A75, 0x0A75}, {0x0A81, 0x0A82}, {0x0ABC, 0x0ABC}, {0x0AC1, 0x0AC8},
+    {0x0ACD, 0x0ACD}, {0x0AE2, 0x0AE3}, {0x0AFA, 0x0B01}, {0x0B3C, 0x0B3C},
+    {0x0B3F, 0x0B3F}, {0x0B41, 0x0B44}, {0x0B4D, 0x0B56}, {0x0B62, 0x0B63},
+    {0x0B82, 0x0B82}, {0x0BC0, 0x0BC0}, {0x0BCD, 0x0BCD}, {0x0C00, 0x0C00},
+    {0x0C04, 0x0C04}, {0x0C3C, 0x0C3C}, {0x0C3E, 0x0C40}, {0x0C46, 0x0C56},
+    {0x0C62, 0x0C63}, {0x0C81, 0x0C81}, {0x0CBC, 0x0CBC}, {0x0CBF, 0x0CBF},
+    {0x0CC6, 0x0CC6}, {0x0CCC, 0x0CCD}, {0x0CE2, 0x0CE3}, {0x0D00, 0x0D01},
+    {0x0D3B, 0x0D3C}, {0x0D41, 0x0D44}, {0x0D4D, 0x0D4D}, {0x0D62, 0x0D63},
+    {0x0D81, 0x0D81}, {0x0DCA, 0x0DCA}, {0x0DD2, 0x0DD6}, {0x0E31, 0x0E31},
+    {0x0E34, 0x0E3A}, {0x0E47, 0x0E4E}, {0x0EB1, 0x0EB1}, {0x0EB4, 0x0EBC},
+    {0x0EC8, 0x0ECD}, {0x0F18, 0x0F19}, {0x0F35, 0x0F35}, {0x0F37, 0x0F37},
+    {0x0F39, 0x0F39}, {0x0F71, 0x0F7E}, {0x0F80, 0x0F84}, {0x0F86, 0x0F87},
+    {0x0F8D, 0x0FBC}, {0x0FC6, 0x0FC6}, {0x102D, 0x1030}, {0x1032, 0x1037},
+    {0x1039, 0x103A}, {0x103D, 0x103E}, {0x1058, 0x1059}, {0x105E, 0x1060},
+    {0x1071, 0x1074}, {0x1082, 0x1082}, {0x1085, 0x1086}, {0x108D, 0x108D},
+    {0x109D, 0x109D}, {0x1160, 0x11FF}, {0x135D, 0x135F}, {0x1712, 0x1714},
+    {0x1732, 0x1733}, {0x1752, 0x1753}, {0x1772, 0x1773}, {0x17B4, 0x17B5},
+    {0x17B7, 0x17BD}, {0x17C6, 0x17C6}, {0x17C9, 0x17D3}, {0x17DD, 0x17DD},
+    {0x180B, 0x180F}, {0x1885, 0x1886}, {0x18A9, 0x18A9}, {0x1920, 0x1922},
+    {0x1927, 0x1928}, {0x1932, 0x1932}, {0x1939, 0x193B}, {0x1A17, 0x1A18},
+    {0x1A1B, 0x1A1B}, {0x1A56, 0x1A56}, {0x1A58, 0x1A60}, {0x1A62, 0x1A62},
+    {0x1A65, 0x1A6C}, {0x1A73, 0x1A7F}, {0x1AB0, 0x1B03}, {0x1B34, 0x1B34},
+    {0x1B36, 0x1B3A}, {0x1B3C, 0x1B3C}, {0x1B42, 0x1B42}, {0x1B6B, 0x1B73},
+    {0x1B80, 0x1B81}, {0x1BA2, 0x1BA5}, {0x1BA8, 0x1BA9}, {0x1BAB, 0x1BAD},
+    {0x1BE6, 0x1BE6}, {0x1BE8, 0x1BE9}, {0x1BED, 0x1BED}, {0x1BEF, 0x1BF1},
+    {0x1C2C, 0x1C33}, {0x1C36, 0x1C37}, {0x1CD0, 0x1CD2}, {0x1CD4, 0x1CE0},
+    {0x1CE2, 0x1CE8}, {0x1CED, 0x1CED}, {0x1CF4, 0x1CF4}, {0x1CF8, 0x1CF9},
+    {0x1DC0, 0x1DFF}, {0x200B, 0x200F}, {0x202A, 0x202E}, {0x2060, 0x206F},
+    {0x20D0, 0x20F0}, {0x2CEF, 0x2CF1}, {0x2D7F, 0x2D7F}, {0x2DE0, 0x2DFF},
+    {0x302A, 0x302D}, {0x3099, 0x309A}, {0xA66F, 0xA672}, {0xA674, 0xA67D},
+    {0xA69E, 0xA69F}, {0xA6F0, 0xA6F1}, {0xA802, 0xA802}, {0xA806, 0xA806},
+    {0xA80B, 0xA80B}, {0xA825, 0xA826}, {0xA82C, 0xA82C}, {0xA8C4, 0xA8C5},
+    {0xA8E0, 0xA8F1}, {0xA8FF, 0xA8FF}, {0xA926, 0xA92D}, {0xA947, 0xA951},
+    {0xA980, 0xA982}, {0xA9B3, 0xA9B3}, {0xA9B6, 0xA9B9}, {0xA9BC, 0xA9BD},
+    {0xA9E5, 0xA9E5}, {0xAA29, 0xAA2E}, {0xAA31, 0xAA32}, {0xAA35, 0xAA36},
+    {0xAA43, 0xAA43}, {0xAA4C, 0xAA4C}, {0xAA7C, 0xAA7C}, {0xAAB0, 0xAAB0},
+    {0xAAB2, 0xAAB4}, {0xAAB7, 0xAAB8}, {0xAABE, 0xAABF}, {0xAAC1, 0xAAC1},
+    {0xAAEC, 0xAAED}, {0xAAF6, 0xAAF6}, {0xABE5, 0xABE5}, {0xABE8, 0xABE8},
+    {0xABED, 0xABED}, {0xFB1E, 0xFB1E}, {0xFE00, 0xFE0F}, {0xFE20, 0xFE2F},
+    {0xFEFF, 0xFEFF}, {0xFFF9, 0xFFFB}, {0x101FD, 0x101FD}, {0x102E0, 0x102E0},
+    {0x10376, 0x1037A}, {0x10A01, 0x10A0F}, {0x10A38, 0x10A3F},
+    {0x10AE5, 0x10AE6}, {0x10D24, 0x10D27}, {0x10EAB, 0x10EAC},
+    {0x10F46, 0x10F50}, {0x10F82, 0x10F85}, {0x11001, 0x11001},
+    {0x11038, 0x11046}, {0x11070, 0x11070}, {0x11073, 0x11074},
+    {0x1107F, 0x11081}, {0x110B3, 0x110B6}, {0x110B9, 0x110BA},
+    {0x110BD, 0x110BD}, {0x110C2, 0x110CD}, {0x11100, 0x11102},
+    {0x11127, 0x1112B}, {0x1112D, 0x11134}, {0x11173, 0x11173},
+    {0x11180, 0x11181}, {0x111B6, 0x111BE}, {0x111C9, 0x111CC},
+    {0x111CF, 0x111CF}, {0x1122F, 0x11231}, {0x11234, 0x11234},
+    {0x11236, 0x11237}, {0x1123E, 0x1123E}, {0x112DF, 0x112DF},
+    {0x112E3, 0x112EA}, {0x11300, 0x11301}, {0x1133B, 0x1133C},
+    {0x11340, 0x11340}, {0x11366, 0x11374}, {0x11438, 0x1143F},
+    {0x11442, 0x11444}, {0x11446, 0x11446}, {0x1145E, 0x1145E},
+    {0x114B3, 0x114B8}, {0x114BA, 0x114BA}, {0x114BF, 0x114C0},
+    {0x114C2, 0x114C3}, {0x115B2, 0x115B5}, {0x115BC, 0x115BD},
+    {0x115BF, 0x115C0}, {0x115DC, 0x115DD}, {0x11633, 0x1163A},
+    {0x1163D, 0x1163D}, {0x1163F, 0x11640}, {0x116AB, 0x116AB},
+    {0x116AD, 0x116AD}, {0x116B0, 0x116B5}, {0x116B7, 0x116B7},
+    {0x1171D, 0x1171F}, {0x11722, 0x11725}, {0x11727, 0x1172B},
+    {0x1182F, 0x11837}, {0x11839, 0x1183A}, {0x1193B, 0x1193C},
+    {0x1193E, 0x1193E}, {0x11943, 0x11943}, {0x119D4, 0x119DB},
+    {0x119E0, 0x119E0}, {0x11A01, 0x11A0A}, {0x11A33, 0x11A38},
+    {0x11A3B, 0x11A3E}, {0x11A47, 0x11A47}, {0x11A51, 0x11A56},
+    {0x11A59, 0x11A5B}, {0x11A8A, 0x11A96}, {0x11A98, 0x11A99},
+    {0x11C30, 0x11C3D}, {0x11C3F, 0x11C3F}, {0x11C92, 0x11CA7},
+    {0x11CAA, 0x11CB0}, {0x11CB2, 0x11CB3}, {0x11CB5, 0x11CB6},
+    {0x11D31, 0x11D45}, {0x11D47, 0x11D47}, {0x11D90, 0x11D91},
+    {0x11D95, 0x11D95}, {0x11D97, 0x11D97}, {0x11EF3, 0x11EF4},
+    {0x13430, 0x13438}, {0x16AF0, 0x16AF4}, {0x16B30, 0x16B36},
+    {0x16F4F, 0x16F4F}, {0x16F8F, 0x16F92}, {0x16FE4, 0x16FE4},
+    {0x1BC9D, 0x1BC9E}, {0x1BCA0, 0x1CF46}, {0x1D167, 0x1D169},
+    {0x1D173, 0x1D182}, {0x1D185, 0x1D18B}, {0x1D1AA, 0x1D1AD},
+    {0x1D242, 0x1D244}, {0x1DA00, 0x1DA36}, {0x1DA3B, 0x1DA6C},
+    {0x1DA75, 0x1DA75}, {0x1DA84, 0x1DA84}, {0x1DA9B, 0x1DAAF},
+    {0x1E000, 0x1E02A}, {0x1E130, 0x1E136}, {0x1E2AE, 0x1E2AE},
+    {0x1E2EC, 0x1E2EF}, {0x1E8D0, 0x1E8D6}, {0x1E944, 0x1E94A},
+    {0xE0001, 0xE01EF},
+};
+
+/**
+ * @brief Ranges of double-width code points (East Asian Wide and Fullwidth,
+ * which include emoji presentation characters), generated from the Unicode
+ * Character Database 14.0.
+ */
+static const xd_unicode_range_t xd_unicode_wide_ranges[] = {
+    {0x1100, 0x115F}, {0x231A, 0x231B}, {0x2329, 0x232A}, {0x23E9, 0x23EC},
+    {0x23F0, 0x23F0}, {0x23F3, 0x23F3}, {0x25FD, 0x25FE}, {0x2614, 0x2615},
+    {0x2648, 0x2653}, {0x267F, 0x267F}, {0x2693, 0x2693}, {0x26A1, 0x26A1},
+    {0x26AA, 0x26AB}, {0x26BD, 0x26BE}, {0x26C4, 0x26C5}, {0x26CE, 0x26CE},
+    {0x26D4, 0x26D4}, {0x26EA, 0x26EA}, {0x26F2, 0x26F3}, {0x26F5, 0x26F5},
+    {0x26FA, 0x26FA}, {0x26FD, 0x26FD}, {0x2705, 0x2705}, {0x270A, 0x270B},
+    {0x2728, 0x2728}, {0x274C, 0x274C}, {0x274E, 0x274E}, {0x2753, 0x2755},
+    {0x2757, 0x2757}, {0x2795, 0x2797}, {0x27B0, 0x27B0}, {0x27BF, 0x27BF},
+    {0x2B1B, 0x2B1C}, {0x2B50, 0x2B50}, {0x2B55, 0x2B55}, {0x2E80, 0x3029},
+    {0x302E, 0x303E}, {0x3041, 0x3096}, {0x309B, 0x3247}, {0x3250, 0x4DBF},
+    {0x4E00, 0xA4C6}, {0xA960, 0xA97C}, {0xAC00, 0xD7A3}, {0xF900, 0xFAFF},
+    {0xFE10, 0xFE19}, {0xFE30, 0xFE6B}, {0xFF01, 0xFF60}, {0xFFE0, 0xFFE6},
+    {0x16FE0, 0x16FE3}, {0x16FF0, 0x1B2FB}, {0x1F004, 0x1F004},
+    {0x1F0CF, 0x1F0CF}, {0x1F18E, 0x1F18E}, {0x1F191, 0x1F19A},
+    {0x1F200, 0x1F320}, {0x1F32D, 0x1F335}, {0x1F337, 0x1F37C},
+    {0x1F37E, 0x1F393}, {0x1F3A0, 0x1F3CA}, {0x1F3CF, 0x1F3D3},
+    {0x1F3E0, 0x1F3F0}, {0x1F3F4, 0x1F3F4}, {0x1F3F8, 0x1F43E},
+    {0x1F440, 0x1F440}, {0x1F442, 0x1F4FC}, {0x1F4FF, 0x1F53D},
+    {0x1F54B, 0x1F54E}, {0x1F550, 0x1F567}, {0x1F57A, 0x1F57A},
+    {0x1F595, 0x1F596}, {0x1F5A4, 0x1F5A4}, {0x1F5FB, 0x1F64F},
+    {0x1F680, 0x1F6C5}, {0x1F6CC, 0x1F6CC}, {0x1F6D0, 0x1F6D2},
+    {0x1F6D5, 0x1F6DF}, {0x1F6EB, 0x1F6EC}, {0x1F6F4, 0x1F6FC},
+    {0x1F7E0, 0x1F7F0}, {0x1F90C, 0x1F93A}, {0x1F93C, 0x1F945},
+    {0x1F947, 0x1F9FF}, {0x1FA70, 0x1FAF6}, {0x20000, 0x3FFFD},
+};
+
+/**
+ * @brief Number of ranges of zero-width code points.
+ */
+static const int xd_unicode_zero_width_ranges_length =
+    sizeof(xd_unicode_zero_width_ranges) /
+    sizeof(xd_unicode_zero_width_ranges[0]);
+
+/**
+ * @brief Number of ranges of double-width code points.
+ */
+static const int xd_unicode_wide_ranges_length =
+    sizeof(xd_unicode_wide_ranges) / sizeof(xd_unicode_wide_ranges[0]);
+
+/**
+ * @brief Array of the default key bindings, printable characters are bound to
+ * `XD_RL_ACTION_SELF_INSERT`.
+ */
+static const xd_keymap_default_t xd_keymap_defaults[] = {
+    {XD_RL_KEY_CTRL_A,        XD_RL_ACTION_BEGINNING_OF_LINE     },
+    {XD_RL_KEY_CTRL_B,        XD_RL_ACTION_BACKWARD_CHAR         },
+    {XD_RL_KEY_CTRL_D,        XD_RL_ACTION_DELETE_CHAR_OR_EOF    },
+    {XD_RL_KEY_CTRL_E,        XD_RL_ACTION_END_OF_LINE           },
+    {XD_RL_KEY_CTRL_F,        XD_RL_ACTION_FORWARD_CHAR          },
+    {XD_RL_KEY_CTRL_G,        XD_RL_ACTION_ABORT                 },
+    {XD_RL_KEY_CTRL_H,        XD_RL_ACTION_BACKWARD_DELETE_CHAR  },
+    {XD_RL_KEY_TAB,           XD_RL_ACTION_COMPLETE              },
+    {XD_RL_KEY_ENTER,         XD_RL_ACTION_ACCEPT_LINE           },
+    {XD_RL_KEY_CTRL_K,        XD_RL_ACTION_KILL_LINE             },
+    {XD_RL_KEY_CTRL_L,        XD_RL_ACTION_CLEAR_SCREEN          },
+    {XD_RL_KEY_CTRL_R,        XD_RL_ACTION_REVERSE_SEARCH_HISTORY},
+    {XD_RL_KEY_CTRL_S,        XD_RL_ACTION_FORWARD_SEARCH_HISTORY},
+    {XD_RL_KEY_CTRL_U,        XD_RL_ACTION_UNIX_LINE_DISCARD     },
+    {XD_RL_KEY_BACKSPACE,     XD_RL_ACTION_BACKWARD_DELETE_CHAR  },
+    {XD_RL_ANSI_UP_ARROW,     XD_RL_ACTION_PREVIOUS_HISTORY      },
+    {XD_RL_ANSI_DOWN_ARROW,   XD_RL_ACTION_NEXT_HISTORY          },
+    {XD_RL_ANSI_RIGHT_ARROW,  XD_RL_ACTION_FORWARD_CHAR          },
+    {XD_RL_ANSI_LEFT_ARROW,   XD_RL_ACTION_BACKWARD_CHAR         },
+    {XD_RL_ANSI_PAGE_UP,      XD_RL_ACTION_PREVIOUS_HISTORY      },
+    {XD_RL_ANSI_PAGE_DOWN,    XD_RL_ACTION_NEXT_HISTORY          },
+    {XD_RL_ANSI_HOME,         XD_RL_ACTION_BEGINNING_OF_LINE     },
+    {XD_RL_ANSI_END,          XD_RL_ACTION_END_OF_LINE           },
+    {XD_RL_ANSI_DELETE,       XD_RL_ACTION_DELETE_CHAR           },
+    {XD_RL_ANSI_ALT_F,        XD_RL_ACTION_FORWARD_WORD          },
+    {XD_RL_ANSI_ALT_B,        XD_RL_ACTION_BACKWARD_WORD         },
+    {XD_RL_ANSI_ALT_D,        XD_RL_ACTION_KILL_WORD             },
+    {XD_RL_ANSI_ALT_BS,       XD_RL_ACTION_BACKWARD_KILL_WORD    },
+    {XD_RL_ANSI_CTRL_UARROW,  XD_RL_ACTION_BEGINNING_OF_HISTORY  },
+    {XD_RL_ANSI_CTRL_DARROW,  XD_RL_ACTION_END_OF_HISTORY        },
+    {XD_RL_ANSI_CTRL_RARROW,  XD_RL_ACTION_FORWARD_WORD          },
+    {XD_RL_ANSI_CTRL_LARROW,  XD_RL_ACTION_BACKWARD_WORD         },
+    {XD_RL_ANSI_CTRL_PAGE_UP, XD_RL_ACTION_BEGINNING_OF_HISTORY  },
+    {XD_RL_ANSI_CTRL_PAGE_DN, XD_RL_ACTION_END_OF_HISTORY        },
+    {XD_RL_ANSI_CTRL_DELETE,  XD_RL_ACTION_KILL_WORD             },
+};
+
+/**
+ * @brief Number of default key bindings.
+ */
+static const int xd_keymap_defaults_length =
+    sizeof(xd_keymap_defaults) / sizeof(xd_keymap_defaults[0]);
+
+/**
+ * @brief Array mapping editing actions to their input handlers, actions of
+ * disabled features have none and do nothing.
+ */
+static const xd_input_handler_func xd_keymap_handlers[XD_RL_KEYMAP_ACTIONS] = {
+    [XD_RL_ACTION_BEGINNING_OF_LINE] = xd_input_handle_ctrl_a,
+    [XD_RL_ACTION_END_OF_LINE] = xd_input_handle_ctrl_e,
+    [XD_RL_ACTION_FORWARD_CHAR] = xd_input_handle_ctrl_f,
+    [XD_RL_ACTION_BACKWARD_CHAR] = xd_input_handle_ctrl_b,
+    [XD_RL_ACTION_FORWARD_WORD] = xd_input_handle_alt_f,
+    [XD_RL_ACTION_BACKWARD_WORD] = xd_input_handle_alt_b,
+    [XD_RL_ACTION_DELETE_CHAR] = xd_input_handle_delete,
+    [XD_RL_ACTION_DELETE_CHAR_OR_EOF] = xd_input_handle_ctrl_d,
+    [XD_RL_ACTION_BACKWARD_DELETE_CHAR] = xd_input_handle_ctrl_h,
+    [XD_RL_ACTION_KILL_WORD] = xd_input_handle_alt_d,
+    [XD_RL_ACTION_BACKWARD_KILL_WORD] = xd_input_handle_alt_backspace,
+    [XD_RL_ACTION_KILL_LINE] = xd_input_handle_ctrl_k,
+    [XD_RL_ACTION_UNIX_LINE_DISCARD] = xd_input_handle_ctrl_u,
+    [XD_RL_ACTION_CLEAR_SCREEN] = xd_input_handle_ctrl_l,
+    [XD_RL_ACTION_ACCEPT_LINE] = xd_input_handle_enter,
+    [XD_RL_ACTION_PREVIOUS_HISTORY] = xd_input_handle_up_arrow,
+    [XD_RL_ACTION_NEXT_HISTORY] = xd_input_handle_down_arrow,
+    [XD_RL_ACTION_BEGINNING_OF_HISTORY] = xd_input_handler_ctrl_up_arrow,
+    [XD_RL_ACTION_END_OF_HISTORY] = xd_input_handler_ctrl_down_arrow,
+#if XD_RL_ENABLE_SEARCH
+    [XD_RL_ACTION_REVERSE_SEARCH_HISTORY] = xd_input_handle_ctrl_r,
+    [XD_RL_ACTION_FORWARD_SEARCH_HISTORY] = xd_input_handle_ctrl_s,
+#endif
+#if XD_RL_ENABLE_COMPLETION
+    [XD_RL_ACTION_COMPLETE] = xd_input_handle_tab,
+#endif
+    [XD_RL_ACTION_ABORT] = xd_input_handle_ctrl_g,
+};
+
+/**
+ * @brief Array mapping editing actions to their names in inputrc files.
+ */
+static const char *const xd_keymap_action_names[XD_RL_KEYMAP_ACTIONS] = {
+    [XD_RL_ACTION_NONE] = NULL,
+    [XD_RL_ACTION_SELF_INSERT] = "self-insert",
+    [XD_RL_ACTION_BEGINNING_OF_LINE] = "beginning-of-line",
+    [XD_RL_ACTION_END_OF_LINE] = "end-of-line",
+    [XD_RL_ACTION_FORWARD_CHAR] = "forward-char",
+    [XD_RL_ACTION_BACKWARD_CHAR] = "backward-char",
+    [XD_RL_ACTION_FORWARD_WORD] = "forward-word",
+    [XD_RL_ACTION_BACKWARD_WORD] = "backward-word",
+    [XD_RL_ACTION_DELETE_CHAR] = "delete-char",
+    [XD_RL_ACTION_DELETE_CHAR_OR_EOF] = "delete-char-or-eof",
+    [XD_RL_ACTION_BACKWARD_DELETE_CHAR] = "backward-delete-char",
+    [XD_RL_ACTION_KILL_WORD] = "kill-word",
+    [XD_RL_ACTION_BACKWARD_KILL_WORD] = "backward-kill-word",
+    [XD_RL_ACTION_KILL_LINE] = "kill-line",
+    [XD_RL_ACTION_UNIX_LINE_DISCARD] = "unix-line-discard",
+    [XD_RL_ACTION_CLEAR_SCREEN] = "clear-screen",
+    [XD_RL_ACTION_ACCEPT_LINE] = "accept-line",
+    [XD_RL_ACTION_PREVIOUS_HISTORY] = "previous-history",
+    [XD_RL_ACTION_NEXT_HISTORY] = "next-history",
+    [XD_RL_ACTION_BEGINNING_OF_HISTORY] = "beginning-of-history",
+    [XD_RL_ACTION_END_OF_HISTORY] = "end-of-history",
+    [XD_RL_ACTION_REVERSE_SEARCH_HISTORY] = "reverse-search-history",
+    [XD_RL_ACTION_FORWARD_SEARCH_HISTORY] = "forward-search-history",
+    [XD_RL_ACTION_COMPLETE] = "complete",
+    [XD_RL_ACTION_ABORT] = "abort",
+};
+
+/**
+ * @brief Array of the key bindings added with `xd_readline_bind()` and
+ * `xd_readline_bind_macro()`, in the order they were first added.
+ */
+static xd_keymap_binding_t *xd_keymap_bindings = NULL;
+
+/**
+ * @brief Number of key bindings in `xd_keymap_bindings`.
+ */
+static size_t xd_keymap_bindings_length = 0;
+
+/**
+ * @brief Capacity of `xd_keymap_bindings`.
+ */
+static size_t xd_keymap_bindings_capacity = 0;
+
+/**
+ * @brief The dispatch tables compiled from the default and added bindings,
+ * the first one is for the first byte of a key sequence.
+ */
+static xd_keymap_table_t *xd_keymap_tables = NULL;
+
+/**
+ * @brief Number of dispatch tables in `xd_keymap_tables`.
+ */
+static size_t xd_keymap_tables_length = 0;
+
+/**
+ * @brief Whether the bindings changed since the dispatch tables were compiled
+ * (non-zero) or not (zero).
+ */
+static int xd_keymap_dirty = 1;
+
+/**
+ * @brief The rest of the text of the macro being run, read before `stdin`, or
+ * `NULL` if none.
+ */
+static const char *xd_keymap_macro = NULL;
+
+/**
+ * @brief Buffer of the bytes read from `stdin` and put back to be read again,
+ * kept across calls to `xd_readline()` since they can't be given back to
+ * `stdin`.
+ */
+static char xd_input_pending[XD_RL_INPUT_PENDING_MAX];
+
+/**
+ * @brief Index of the first byte of `xd_input_pending` not handled yet.
+ */
+static size_t xd_input_pending_start = 0;
+
+/**
+ * @brief Index after the last byte put back into `xd_input_pending`.
+ */
+static size_t xd_input_pending_end = 0;
+
+/**
+ * @brief The time to wait for the next byte of a key sequence when
+ * `xd_readline_esc_timeout_ms` is automatic, raised when key sequences are
+ * seen split.
+ */
+static int xd_input_esc_timeout_auto = XD_RL_ESC_TIMEOUT_LOCAL;
+
+/**
+ * @brief Whether the last key was a lone `ESC` (non-zero) or not (zero).
+ */
+static int xd_input_esc_timed_out = 0;
+
+/**
+ * @brief Whether the library was initialized (non-zero) or not (zero), it is
+ * initialized on first use, see `xd_readline_lazy_init()`.
+ */
+static int xd_readline_initialized = 0;
+
+/**
+ * @brief The allocation function set by `xd_readline_set_allocator()`, or
+ * `NULL` to use `malloc()`.
+ */
+static xd_readline_alloc_func_t xd_alloc_func = NULL;
+
+/**
+ * @brief The resizing function set by `xd_readline_set_allocator()`, or `NULL`
+ * to use `realloc()`.
+ */
+static xd_readline_realloc_func_t xd_realloc_func = NULL;
+
+/**
+ * @brief The freeing function set by `xd_readline_set_allocator()`, or `NULL`
+ * to use `free()`.
+ */
+static xd_readline_free_func_t xd_free_func = NULL;
+
+/**
+ * @brief The user data passed to the allocator functions.
+ */
+static void *xd_alloc_user = NULL;
+
+/**
+ * @brief Current and peak number of bytes allocated by each subsystem, the
+ * last element is for all subsystems together.
+ */
+static xd_readline_memory_usage_t xd_memory_usage[XD_RL_MEMORY_TOTAL + 1];
+
+/**
+ * @brief Decaying estimate of the input size needed by recent lines, halved
+ * on every line unless exceeded, used to decide when to shrink buffers.
+ */
+static size_t xd_memory_recent_input = 0;
+
+/**
+ * @brief The main block of the scratch arena, transient allocations made
+ * during a call to `xd_readline()` are bumped from it and released at once
+ * when the call returns.
+ */
+static unsigned char *xd_arena_base = NULL;
+
+/**
+ * @brief Size of `xd_arena_base` in bytes.
+ */
+static size_t xd_arena_capacity = 0;
+
+/**
+ * @brief Number of bytes of `xd_arena_base` allocated so far.
+ */
+static size_t xd_arena_used = 0;
+
+/**
+ * @brief Total number of bytes allocated from the scratch arena since it was
+ * last reset, including the overflow blocks.
+ */
+static size_t xd_arena_requested = 0;
+
+/**
+ * @brief The most recently allocated overflow block of the scratch arena, or
+ * `NULL` if everything fit in the main block.
+ */
+static xd_arena_block_t *xd_arena_overflow = NULL;
+
+/**
+ * @brief Decaying estimate of the scratch arena size needed by recent calls,
+ * halved on every call unless exceeded, used to decide when to shrink it.
+ */
+static size_t xd_arena_recent = 0;
+
+/**
+ * @brief Character class table, maps each byte to its `XD_RL_CHAR_CLASS_*`
+ * flags.
+ */
+static uint8_t xd_char_class[UCHAR_MAX + 1];
+
+/**
+ * @brief The extra word characters the character class table was built with.
+ */
+static const char *xd_char_class_word_chars = NULL;
+
+#ifdef XD_RL_DEBUG_ALLOCS
+/**
+ * @brief Depth of nested regions whose allocations are expected, see
+ * `XD_RL_ALLOC_EXPECTED_BEGIN()`.
+ */
+static int xd_debug_alloc_expected = 0;
+
+/**
+ * @brief Number of unexpected allocations made while handling the current
+ * keystroke.
+ */
+static size_t xd_debug_keystroke_allocs = 0;
+#endif
+
+#ifdef __SSE2__
+/**
+ * @brief The extra word characters matched by the vectorized word scanning.
+ */
+static char xd_word_simd_extra[XD_RL_WORD_SIMD_EXTRA_MAX];
+
+/**
+ * @brief Number of extra word characters in `xd_word_simd_extra`, or `-1` if
+ * there are too many and the vectorized word scanning is disabled.
+ */
+static int xd_word_simd_extra_count = 0;
+#endif
+
+// ========================
+// Public Variables
+// ========================
+
+#if XD_RL_ENABLE_COMPLETION
+xd_readline_completion_gen_func_t xd_readline_completions_generator = NULL;
+#endif
+
+xd_readline_input_complete_func_t xd_readline_input_complete = NULL;
+
+const char *xd_readline_prompt = NULL;
+
+xd_readline_history_eviction_t xd_readline_history_eviction =
+    XD_RL_HISTORY_EVICT_FIFO;
+
+size_t xd_readline_history_max_bytes = 0;
+
+#if XD_RL_ENABLE_SUGGESTION
+int xd_readline_suggest_next_command = 0;
+#endif
+
+const char *xd_readline_word_chars = NULL;
+
+size_t xd_readline_memory_budget = 0;
+
+int xd_readline_omit_newline = 0;
+
+int xd_readline_esc_timeout_ms = 0;
+
+int xd_readline_terminal_cache = 0;
+
+int xd_readline_kitty_keyboard = 0;
+
+#ifdef XD_RL_DEBUG_ALLOCS
+size_t xd_readline_debug_keystroke_allocs = 0;
+#endif
+
+// ========================
 // Function Definitions
 // ========================
 
 /**
- * @brief Returns the longest common prefix of the passed array of strings.
+ * @brief Allocates memory with the configured allocator.
+ *
+ * @param size The number of bytes to allocate.
+ *
+ * @return Pointer to the allocated memory, or `NULL` on failure.
+ */
+static void *xd_util_malloc(size_t size) {
+#ifdef XD_RL_DEBUG_ALLOCS
+  if (xd_debug_alloc_expected == 0) {
+    xd_debug_keystroke_allocs++;
+  }
+#endif
+  if (xd_alloc_func == NULL) {
+    return malloc(size);
+  }
+  return xd_alloc_func(size, xd_alloc_user);
+}  // xd_util_malloc()
+
+/**
+ * @brief Resizes memory allocated with the configured allocator.
+ *
+ * @param ptr The memory to resize, or `NULL` to allocate new memory.
+ * @param size The new size in bytes.
+ *
+ * @return Pointer to the resized memory, or `NULL` on failure in which case
+ * `ptr` is left untouched.
+ */
+static void *xd_util_realloc(void *ptr, size_t size) {
+  if (ptr == NULL) {
+    return xd_util_malloc(size);
+  }
+#ifdef XD_RL_DEBUG_ALLOCS
+  if (xd_debug_alloc_expected == 0) {
+    xd_debug_keystroke_allocs++;
+  }
+#endif
+  if (xd_realloc_func == NULL) {
+    return realloc(ptr, size);
+  }
+  return xd_realloc_func(ptr, size, xd_alloc_user);
+}  // xd_util_realloc()
+
+/**
+ * @brief Frees memory allocated with the configured allocator.
+ *
+ * @param ptr The memory to free, or `NULL` to do nothing.
+ */
+static void xd_util_free(void *ptr) {
+  if (ptr == NULL) {
+    return;
+  }
+  if (xd_free_func == NULL) {
+    free(ptr);
+    return;
+  }
+  xd_free_func(ptr, xd_alloc_user);
+}  // xd_util_free()
+
+/**
+ * @brief Duplicates the first `length` bytes of the passed string using the
+ * configured allocator.
+ *
+ * @param str The string to duplicate.
+ * @param length The number of bytes to duplicate.
+ *
+ * @return Pointer to the newly allocated null-terminated copy, or `NULL` on
+ * allocation failure.
+ */
+static char *xd_util_strndup(const char *str, size_t length) {
+  char *copy = (char *)xd_util_malloc(sizeof(char) * (length + 1));
+  if (copy == NULL) {
+    return NULL;
+  }
+  memcpy(copy, str, length);
+  copy[length] = XD_RL_ASCII_NUL;
+  return copy;
+}  // xd_util_strndup()
+
+/**
+ * @brief Checks whether allocating the passed number of bytes keeps the total
+ * memory usage within `xd_readline_memory_budget`.
+ *
+ * @param size The number of bytes to be allocated.
+ *
+ * @return Non-zero if the allocation fits in the budget or zero otherwise.
+ */
+static int xd_memory_fits(size_t size) {
+  if (xd_readline_memory_budget == 0) {
+    return 1;
+  }
+  size_t current = xd_memory_usage[XD_RL_MEMORY_TOTAL].current;
+  return current <= xd_readline_memory_budget &&
+         size <= xd_readline_memory_budget - current;
+}  // xd_memory_fits()
+
+/**
+ * @brief Computes the capacity a buffer that grows by doubling from the passed
+ * minimum should be grown to, so that it can take the passed number of bytes
+ * in addition to its contents.
+ *
+ * @param capacity The current capacity of the buffer, `0` if not allocated.
+ * @param length The number of bytes the buffer holds.
+ * @param extra The number of bytes to make room for.
+ * @param minimum The initial capacity of the buffer.
+ *
+ * @return The new capacity, `capacity` if the buffer doesn't have to grow, or
+ * `0` if more than `XD_RL_CAPACITY_MAX` bytes would be needed.
+ */
+static size_t xd_memory_grow_target(size_t capacity, size_t length,
+                                    size_t extra, size_t minimum) {
+  if (length > XD_RL_CAPACITY_MAX || extra > XD_RL_CAPACITY_MAX - length) {
+    return 0;
+  }
+  size_t needed = length + extra;
+  size_t target = capacity == 0 ? minimum : capacity;
+  while (target < needed) {
+    target *= 2;
+  }
+  return target;
+}  // xd_memory_grow_target()
+
+/**
+ * @brief Records that an allocation of the passed subsystem changed size,
+ * updating the current and peak usage of the subsystem and of the total.
+ *
+ * @param subsystem The subsystem owning the allocation.
+ * @param old_size The previous size in bytes, `0` for a new allocation.
+ * @param new_size The new size in bytes, `0` for a freed allocation.
+ */
+static void xd_memory_account(xd_readline_memory_subsystem_t subsystem,
+                              size_t old_size, size_t new_size) {
+  xd_readline_memory_usage_t *usages[] = {
+      &xd_memory_usage[subsystem],
+      &xd_memory_usage[XD_RL_MEMORY_TOTAL],
+  };
+  for (int i = 0; i < 2; i++) {
+    usages[i]->current = usages[i]->current - old_size + new_size;
+    if (usages[i]->current > usages[i]->peak) {
+      usages[i]->peak = usages[i]->current;
+    }
+  }
+}  // xd_memory_account()
+
+/**
+ * @brief Computes the capacity a buffer that grows by doubling from the passed
+ * minimum should be shrunk to, given what recent lines needed.
+ *
+ * The buffer is only shrunk when it is more than `XD_RL_SHRINK_HYSTERESIS`
+ * times larger than needed, so a buffer isn't shrunk and grown back
+ * repeatedly.
+ *
+ * @param capacity The current capacity of the buffer.
+ * @param recent The decaying estimate of the capacity needed by recent lines.
+ * @param minimum The initial capacity of the buffer.
+ *
+ * @return The new capacity, or `capacity` if the buffer shouldn't shrink.
+ */
+static size_t xd_memory_shrink_target(size_t capacity, size_t recent,
+                                      size_t minimum) {
+  size_t needed = recent > minimum ? recent : minimum;
+  if (capacity / XD_RL_SHRINK_HYSTERESIS <= needed) {
+    return capacity;
+  }
+  size_t target = minimum;
+  while (target < needed) {
+    target *= 2;
+  }
+  return target;
+}  // xd_memory_shrink_target()
+
+/**
+ * @brief Shrinks the input buffer and the scratch history slot's storage if
+ * they are much larger than what recent lines needed, e.g. after a giant
+ * paste.
+ *
+ * Must be called at the start of `xd_readline()` before the input is reset,
+ * the line returned by the previous call is valid until then.
+ */
+static void xd_memory_shrink() {
+  size_t needed = xd_input_length + XD_RL_UTF8_SEQ_MAX + 2;
+  if (needed < xd_memory_recent_input / 2) {
+    needed = xd_memory_recent_input / 2;
+  }
+  xd_memory_recent_input = needed;
+
+  size_t capacity = xd_memory_shrink_target(xd_input_capacity,
+                                            xd_memory_recent_input, LINE_MAX);
+  if (capacity < xd_input_capacity) {
+    char *ptr =
+        (char *)xd_util_realloc(xd_input_buffer, sizeof(char) * capacity);
+    if (ptr != NULL) {
+      // the column index may stay larger if this fails, which is harmless
+      size_t *prefix = (size_t *)xd_util_realloc(
+          xd_input_column_prefix,
+          sizeof(size_t) * ((capacity / XD_RL_COLUMN_CHUNK_SIZE) + 2));
+      if (prefix != NULL) {
+        xd_input_column_prefix = prefix;
+      }
+      xd_memory_account(XD_RL_MEMORY_INPUT,
+                        xd_input_buffer_size(xd_input_capacity),
+                        xd_input_buffer_size(capacity));
+      xd_input_buffer = ptr;
+      xd_input_capacity = capacity;
+      xd_input_length = 0;
+      xd_input_buffer[0] = XD_RL_ASCII_NUL;
+      xd_input_buffer_invalidate(0);
+    }
+  }
+
+  // the line index is regrown on demand, so it's dropped after lines with
+  // many new-lines
+  if (xd_input_lines_capacity > XD_RL_INPUT_LINES_MIN) {
+    xd_util_free(xd_input_lines);
+    xd_memory_account(XD_RL_MEMORY_INPUT,
+                      sizeof(xd_input_line_t) * xd_input_lines_capacity, 0);
+    xd_input_lines = NULL;
+    xd_input_lines_capacity = 0;
+    xd_input_lines_count = 0;
+    xd_input_lines_scanned = 0;
+  }
+
+  // the scratch history slot only holds the input while navigating, so its
+  // storage is dropped and regrown on demand
+  if (xd_history_scratch != NULL &&
+      xd_memory_shrink_target(xd_history_scratch_capacity,
+                              xd_memory_recent_input,
+                              LINE_MAX) < xd_history_scratch_capacity) {
+    xd_history_entry_t *scratch = xd_history[XD_RL_HISTORY_MAX];
+    scratch->str = scratch->inline_str;
+    xd_history_entry_reset(scratch);
+    xd_util_free(xd_history_scratch);
+    xd_memory_account(XD_RL_MEMORY_HISTORY, xd_history_scratch_capacity, 0);
+    xd_history_scratch = NULL;
+    xd_history_scratch_capacity = 0;
+  }
+}  // xd_memory_shrink()
+
+/**
+ * @brief Allocates memory from the scratch arena, the memory is not freed
+ * individually but released with the whole arena by `xd_arena_reset()`.
+ *
+ * @param size The number of bytes to allocate.
+ *
+ * @return Pointer to the allocated memory aligned to `XD_RL_ARENA_ALIGNMENT`,
+ * or `NULL` on failure.
+ */
+static void *xd_arena_alloc(size_t size) {
+  if (size > SIZE_MAX / 2) {
+    return NULL;
+  }
+  size = (size + XD_RL_ARENA_ALIGNMENT - 1) &
+         ~(size_t)(XD_RL_ARENA_ALIGNMENT - 1);
+  if (size == 0) {
+    size = XD_RL_ARENA_ALIGNMENT;
+  }
+
+  if (xd_arena_base == NULL) {
+    if (!xd_memory_fits(XD_RL_ARENA_INITIAL_SIZE)) {
+      return NULL;
+    }
+    XD_RL_ALLOC_EXPECTED_BEGIN();  // the arena keeps its size across calls
+    xd_arena_base = (unsigned char *)xd_util_malloc(XD_RL_ARENA_INITIAL_SIZE);
+    XD_RL_ALLOC_EXPECTED_END();
+    if (xd_arena_base == NULL) {
+      return NULL;
+    }
+    xd_arena_capacity = XD_RL_ARENA_INITIAL_SIZE;
+    xd_arena_used = 0;
+    xd_memory_account(XD_RL_MEMORY_COMPLETION, 0, xd_arena_capacity);
+  }
+
+  void *ptr = NULL;
+  if (xd_arena_overflow == NULL && size <= xd_arena_capacity - xd_arena_used) {
+    ptr = xd_arena_base + xd_arena_used;
+    xd_arena_used += size;
+  }
+  else if (xd_arena_overflow != NULL &&
+           size <= xd_arena_overflow->capacity - xd_arena_overflow->used) {
+    ptr = xd_arena_overflow->data + xd_arena_overflow->used;
+    xd_arena_overflow->used += size;
+  }
+  else {
+    // doesn't fit, chain an overflow block at least twice the previous one
+    size_t capacity = xd_arena_overflow == NULL ? xd_arena_capacity
+                                                : xd_arena_overflow->capacity;
+    capacity *= 2;
+    if (capacity < size) {
+      capacity = size;
+    }
+    if (!xd_memory_fits(sizeof(xd_arena_block_t) + capacity)) {
+      return NULL;
+    }
+    XD_RL_ALLOC_EXPECTED_BEGIN();  // merged into the main block on reset
+    xd_arena_block_t *block = (xd_arena_block_t *)xd_util_malloc(
+        sizeof(xd_arena_block_t) + capacity);
+    XD_RL_ALLOC_EXPECTED_END();
+    if (block == NULL) {
+      return NULL;
+    }
+    xd_memory_account(XD_RL_MEMORY_COMPLETION, 0,
+                      sizeof(xd_arena_block_t) + capacity);
+    block->next = xd_arena_overflow;
+    block->capacity = capacity;
+    block->used = size;
+    xd_arena_overflow = block;
+    ptr = block->data;
+  }
+  xd_arena_requested += size;
+  return ptr;
+}  // xd_arena_alloc()
+
+#if XD_RL_ENABLE_COMPLETION
+/**
+ * @brief Checks whether the passed pointer was allocated from the scratch
+ * arena.
+ *
+ * @param ptr The pointer to check.
+ *
+ * @return Non-zero if the pointer was allocated from the arena or zero
+ * otherwise.
+ */
+static int xd_arena_owns(const void *ptr) {
+  uintptr_t addr = (uintptr_t)ptr;
+  if (xd_arena_base != NULL && addr >= (uintptr_t)xd_arena_base &&
+      addr < (uintptr_t)(xd_arena_base + xd_arena_capacity)) {
+    return 1;
+  }
+  for (xd_arena_block_t *block = xd_arena_overflow; block != NULL;
+       block = block->next) {
+    if (addr >= (uintptr_t)block->data &&
+        addr < (uintptr_t)(block->data + block->capacity)) {
+      return 1;
+    }
+  }
+  return 0;
+}  // xd_arena_owns()
+#endif
+
+/**
+ * @brief Releases everything allocated from the scratch arena.
+ *
+ * In the common case this only rewinds the main block. If overflow blocks were
+ * needed, they are freed and the main block is grown to the high-water mark so
+ * that the same usage fits in it next time without allocating. If recent calls
+ * needed much less than the main block, it is shrunk.
+ */
+static void xd_arena_reset() {
+  if (xd_arena_requested < xd_arena_recent / 2) {
+    xd_arena_recent /= 2;
+  }
+  else {
+    xd_arena_recent = xd_arena_requested;
+  }
+
+  size_t capacity = xd_arena_capacity;
+  if (xd_arena_overflow != NULL) {
+    while (xd_arena_overflow != NULL) {
+      xd_arena_block_t *next = xd_arena_overflow->next;
+      xd_memory_account(XD_RL_MEMORY_COMPLETION,
+                        sizeof(xd_arena_block_t) + xd_arena_overflow->capacity,
+                        0);
+      xd_util_free(xd_arena_overflow);
+      xd_arena_overflow = next;
+    }
+    if (capacity == 0) {
+      capacity = XD_RL_ARENA_INITIAL_SIZE;
+    }
+    while (capacity < xd_arena_requested) {
+      capacity *= 2;
+    }
+  }
+  else {
+    capacity = xd_memory_shrink_target(xd_arena_capacity, xd_arena_recent,
+                                       XD_RL_ARENA_INITIAL_SIZE);
+  }
+
+  if (capacity != xd_arena_capacity) {
+    // the contents don't need to be preserved, so don't `realloc()`
+    xd_util_free(xd_arena_base);
+    xd_memory_account(XD_RL_MEMORY_COMPLETION, xd_arena_capacity, 0);
+    xd_arena_base = NULL;
+    xd_arena_capacity = 0;
+    if (xd_memory_fits(capacity)) {
+      xd_arena_base = (unsigned char *)xd_util_malloc(capacity);
+    }
+    if (xd_arena_base != NULL) {
+      xd_arena_capacity = capacity;
+      xd_memory_account(XD_RL_MEMORY_COMPLETION, 0, xd_arena_capacity);
+    }
+  }
+  xd_arena_used = 0;
+  xd_arena_requested = 0;
+}  // xd_arena_reset()
+
+/**
+ * @brief Frees the scratch arena.
+ */
+static void xd_arena_destroy() {
+  while (xd_arena_overflow != NULL) {
+    xd_arena_block_t *next = xd_arena_overflow->next;
+    xd_util_free(xd_arena_overflow);
+    xd_arena_overflow = next;
+  }
+  xd_util_free(xd_arena_base);
+  xd_memory_account(XD_RL_MEMORY_COMPLETION,
+                    xd_memory_usage[XD_RL_MEMORY_COMPLETION].current, 0);
+  xd_arena_base = NULL;
+  xd_arena_capacity = 0;
+  xd_arena_used = 0;
+  xd_arena_requested = 0;
+  xd_arena_recent = 0;
+}  // xd_arena_destroy()
+
+/**
+ * @brief Reads a whole line from the passed file into a buffer allocated with
+ * the configured allocator, like `getline()`.
+ *
+ * @param file The file to read from.
+ * @param line Pointer to the buffer, grown as needed, must be released with
+ * `xd_util_free()`.
+ * @param capacity Pointer to the capacity of the buffer.
+ *
+ * @return The length of the line read including the new-line if any, or `-1`
+ * on end of file, error, or allocation failure.
+ */
+static ssize_t xd_util_read_line(FILE *file, char **line, size_t *capacity) {
+  // read byte by byte so that NUL bytes are counted like any other byte
+  size_t length = 0;
+  ssize_t ret = 0;
+  flockfile(file);
+  while (1) {
+    int chr = getc_unlocked(file);
+    if (chr == EOF) {
+      break;
+    }
+    if (*capacity - length < 2) {
+      size_t new_capacity = xd_memory_grow_target(*capacity, length, 2,
+                                                  LINE_MAX);
+      char *ptr = new_capacity == 0 ? NULL
+                                    : (char *)xd_util_realloc(
+                                          *line, sizeof(char) * new_capacity);
+      if (ptr == NULL) {
+        errno = ENOMEM;
+        ret = -1;
+        break;
+      }
+      *line = ptr;
+      *capacity = new_capacity;
+    }
+    (*line)[length++] = (char)chr;
+    if (chr == XD_RL_ASCII_LF) {
+      break;
+    }
+  }
+  funlockfile(file);
+  if (ret == -1 || length == 0) {
+    return -1;
+  }
+  (*line)[length] = XD_RL_ASCII_NUL;
+  return (ssize_t)length;
+}  // xd_util_read_line()
+
+#if XD_RL_ENABLE_COMPLETION
+/**
+ * @brief Returns the length of the longest common prefix of the passed array
+ * of strings, the prefix itself is the beginning of the first string.
+ *
+ * @param strings Sorted, null-terminated array of strings.
+ *
+ * @return The length of the longest common prefix, or `0` if the passed array
+ * is `NULL` or empty.
+ */
+static size_t xd_util_longest_common_prefix(const char **strings) {
+  if (strings == NULL || strings[0] == NULL) {
+    return 0;
+  }
+  const char *first_str = strings[0];
+  size_t lcp_length = 0;
+  int done = 0;
+  while (!done) {
+    char chr = first_str[lcp_length];
+    if (chr == XD_RL_ASCII_NUL) {
+      break;
+    }
+    for (int i = 1; strings[i] != XD_RL_ASCII_NUL; i++) {
+      if (strings[i][lcp_length] != chr) {
+        done = 1;
+        break;
+      }
+    }
+    if (!done) {
+      lcp_length++;
+    }
+  }
+  return lcp_length;
+}  // xd_util_longest_common_prefix()
+#endif
+
+#if XD_RL_ENABLE_COMPLETION && XD_RL_ENABLE_COMPLETION_LIST
+/**
+ * @brief Helper used to print all possible completions when the `Tab` key is
+ * pressed more than once and there is more than one completion.
+ *
+ * @param completions Sorted, null-terminated array of possible completions.
+ */
+static void xd_util_print_completions(char **completions) {
+  if (completions == NULL || *completions == NULL) {
+    return;
+  }
+  // print below the input, then restore original terminal settings so we can
+  // use printf
+  xd_tty_cursor_move_input(xd_input_cursor, xd_input_length);
+  xd_tty_flush();
+  xd_tty_restore();
+
+  int completions_count = 0;
+  while (completions[completions_count] != NULL) {
+    completions_count++;
+  }
+
+  // measure the basenames once, they are printed padded by their width
+  const char **basenames = (const char **)xd_arena_alloc(
+      sizeof(const char *) * completions_count);
+  size_t *widths = (size_t *)xd_arena_alloc(sizeof(size_t) * completions_count);
+  if (basenames == NULL || widths == NULL) {
+    xd_tty_raw();
+    return;
+  }
+  size_t longest_completion_width = 0;
+  for (int i = 0; i < completions_count; i++) {
+    basenames[i] = xd_util_base_name_keep_trailing_slash(completions[i]);
+    widths[i] = xd_util_str_width(basenames[i], strlen(basenames[i]));
+    if (widths[i] > longest_completion_width) {
+      longest_completion_width = widths[i];
+    }
+  }
+
+  // calculate the number of rows and columns
+  size_t col_length = longest_completion_width + 2;
+  if (col_length > xd_tty_win_width) {
+    col_length = xd_tty_win_width;
+  }
+  int col_count = (int)(xd_tty_win_width / col_length);
+  int row_count = (completions_count + col_count - 1) / col_count;
+
+  // print completions
+  printf("\n");
+  for (int row = 0; row < row_count; row++) {
+    for (int col = 0; col < col_count; col++) {
+      int idx = row + (col * row_count);
+      if (idx < completions_count) {
+        // pad by display width, `printf()` pads by bytes
+        size_t width = widths[idx];
+        printf("%s%*s", basenames[idx],
+               width < col_length ? (int)(col_length - width) : 0, "");
+      }
+    }
+    printf("\n");
+  }
+
+  // change the terminal settings back to raw
+  xd_tty_raw();
+
+  // start fresh on new line
+  xd_tty_cursor_row = 1;
+  xd_tty_cursor_col = 1;
+  xd_tty_chars_count = 0;
+  xd_tty_lines_drawn = 0;
+  xd_readline_redraw = 1;
+}  // xd_util_print_completions()
+#endif
+
+#if XD_RL_ENABLE_COMPLETION && XD_RL_ENABLE_COMPLETION_LIST
+/**
+ * @brief Returns a pointer to the last segment of the passed path.
+ *
+ * @param path The path to return its last segment.
+ *
+ * @return Pointer to the beginning of the last segment.
+ */
+static const char *xd_util_base_name_keep_trailing_slash(const char *path) {
+  if (path == NULL || *path == '\0') {
+    return path;
+  }
+
+  // a trailing slash is part of the last segment, start before it
+  size_t path_length = strlen(path);
+  for (size_t i = path_length - 1; i > 0; i--) {
+    if (path[i - 1] == '/') {
+      return path + i;
+    }
+  }
+  return path;
+}  // xd_util_base_name_keep_trailing_slash()
+#endif
+
+/**
+ * @brief Computes a bitmask of the bytes present in the passed string, each
+ * byte sets the bit at its value modulo 64.
+ *
+ * Used as a cheap filter during history search: an entry can only contain the
+ * search query if its mask includes all the bits of the query mask.
+ *
+ * @param str The string to compute its mask.
+ * @param length The length of the string.
+ *
+ * @return The bitmask of the string.
+ */
+static uint64_t xd_util_byte_mask(const char *str, size_t length) {
+  uint64_t mask = 0;
+  for (size_t i = 0; i < length; i++) {
+    mask |= UINT64_C(1) << ((unsigned char)str[i] & 63);
+  }
+  return mask;
+}  // xd_util_byte_mask()
+
+/**
+ * @brief Computes the 32-bit FNV-1a hash of the passed string.
+ *
+ * @param str The string to be hashed.
+ * @param length The length of the string.
+ *
+ * @return The hash of the string.
+ */
+static uint32_t xd_util_hash(const char *str, size_t length) {
+  uint32_t hash = UINT32_C(2166136261);
+  for (size_t i = 0; i < length; i++) {
+    hash ^= (unsigned char)str[i];
+    hash *= UINT32_C(16777619);
+  }
+  return hash;
+}  // xd_util_hash()
+
+/**
+ * @brief Finds the offset at which the last `lines` lines of the passed file
+ * start by scanning the file backward block by block.
+ *
+ * Each newline ends a line, so for a history file the lines are its records,
+ * see `xd_history_entry_write()`.
+ *
+ * @param file The file to be scanned, must be a regular file for the scan to
+ * take place.
+ * @param lines The number of lines to look for.
+ *
+ * @return The offset of the first of the last `lines` lines, or `0` if the
+ * file has no more than `lines` lines, is not a regular file, or on failure.
+ */
+static off_t xd_util_file_tail_offset(FILE *file, int lines) {
+  int fd = fileno(file);
+  struct stat file_stat;
+  if (fd == -1 || fstat(fd, &file_stat) == -1 ||
+      !S_ISREG(file_stat.st_mode)) {
+    return 0;
+  }
+
+  // the block is too large for the small stacks of embedded callers
+  char *buffer = (char *)xd_util_malloc(XD_RL_FILE_BLOCK_SIZE);
+  if (buffer == NULL) {
+    return 0;
+  }
+  off_t file_size = file_stat.st_size;
+  off_t block_end = file_size;
+  off_t offset = 0;
+  int newlines = 0;
+  while (block_end > 0 && offset == 0) {
+    off_t block_start = block_end > XD_RL_FILE_BLOCK_SIZE
+                            ? block_end - XD_RL_FILE_BLOCK_SIZE
+                            : 0;
+    ssize_t block_length = block_end - block_start;
+    if (pread(fd, buffer, block_length, block_start) != block_length) {
+      break;
+    }
+    for (ssize_t i = block_length - 1; i >= 0; i--) {
+      // the newline at the very end terminates the last line
+      if (buffer[i] != XD_RL_ASCII_LF || block_start + i == file_size - 1) {
+        continue;
+      }
+      if (++newlines == lines) {
+        offset = block_start + i + 1;
+        break;
+      }
+    }
+    block_end = block_start;
+  }
+  xd_util_free(buffer);
+  return offset;
+}  // xd_util_file_tail_offset()
+
+/**
+ * @brief Builds the two-level display width table from the ranges of
+ * zero-width and double-width code points.
+ *
+ * Each block of `256` code points is packed into `64` bytes and identical
+ * blocks are shared, so the whole table takes about `12` KB and looking up the
+ * width of a code point costs two memory reads.
+ */
+static void xd_util_width_table_init() {
+  int zero_idx = 0;
+  int wide_idx = 0;
+  xd_width_blocks_count = 0;
+  for (uint32_t block = 0; block < XD_RL_WIDTH_STAGE1_SIZE; block++) {
+    uint32_t first = block << XD_RL_WIDTH_BLOCK_BITS;
+    uint32_t last = first + (1 << XD_RL_WIDTH_BLOCK_BITS) - 1;
+
+    // every code point is single-width unless a range says otherwise
+    uint8_t bits[XD_RL_WIDTH_BLOCK_BYTES];
+    memset(bits, 0x55, sizeof(bits));
+
+    // apply the wide ranges first so that zero-width overrides them
+    while (wide_idx < xd_unicode_wide_ranges_length &&
+           xd_unicode_wide_ranges[wide_idx].last < first) {
+      wide_idx++;
+    }
+    for (int i = wide_idx; i < xd_unicode_wide_ranges_length &&
+                           xd_unicode_wide_ranges[i].first <= last;
+         i++) {
+      const xd_unicode_range_t *range = &xd_unicode_wide_ranges[i];
+      uint32_t from = range->first > first ? range->first : first;
+      uint32_t to = range->last < last ? range->last : last;
+      for (uint32_t codepoint = from; codepoint <= to; codepoint++) {
+        uint32_t offset = codepoint - first;
+        bits[offset >> 2] &= ~(3 << ((offset & 3) << 1));
+        bits[offset >> 2] |= 2 << ((offset & 3) << 1);
+      }
+    }
+    while (zero_idx < xd_unicode_zero_width_ranges_length &&
+           xd_unicode_zero_width_ranges[zero_idx].last < first) {
+      zero_idx++;
+    }
+    for (int i = zero_idx; i < xd_unicode_zero_width_ranges_length &&
+                           xd_unicode_zero_width_ranges[i].first <= last;
+         i++) {
+      const xd_unicode_range_t *range = &xd_unicode_zero_width_ranges[i];
+      uint32_t from = range->first > first ? range->first : first;
+      uint32_t to = range->last < last ? range->last : last;
+      for (uint32_t codepoint = from; codepoint <= to; codepoint++) {
+        uint32_t offset = codepoint - first;
+        bits[offset >> 2] &= ~(3 << ((offset & 3) << 1));
+      }
+    }
+
+    // share the block with an identical one, most often the previous one
+    int block_id = -1;
+    if (block > 0 && memcmp(xd_width_stage2[xd_width_stage1[block - 1]], bits,
+                            sizeof(bits)) == 0) {
+      block_id = xd_width_stage1[block - 1];
+    }
+    for (int i = 0; block_id == -1 && i < xd_width_blocks_count; i++) {
+      if (memcmp(xd_width_stage2[i], bits, sizeof(bits)) == 0) {
+        block_id = i;
+      }
+    }
+    if (block_id == -1 && xd_width_blocks_count < XD_RL_WIDTH_BLOCKS_MAX) {
+      block_id = xd_width_blocks_count++;
+      memcpy(xd_width_stage2[block_id], bits, sizeof(bits));
+    }
+    // out of blocks (never with the built-in ranges), fall back to the first
+    // block which holds single-width code points only
+    xd_width_stage1[block] = block_id == -1 ? 0 : (uint8_t)block_id;
+  }
+}  // xd_util_width_table_init()
+
+/**
+ * @brief Returns the number of terminal columns taken by the passed code point.
+ *
+ * @param codepoint The code point to get its display width.
+ *
+ * @return `0` for combining and other zero-width code points, `2` for East
+ * Asian wide and fullwidth code points (including emoji), or `1` otherwise.
+ */
+static int xd_util_codepoint_width(uint32_t codepoint) {
+  if (codepoint < 0x80 || codepoint > XD_RL_UNICODE_MAX) {
+    return 1;
+  }
+  const uint8_t *block =
+      xd_width_stage2[xd_width_stage1[codepoint >> XD_RL_WIDTH_BLOCK_BITS]];
+  uint32_t offset = codepoint & ((1 << XD_RL_WIDTH_BLOCK_BITS) - 1);
+  return (block[offset >> 2] >> ((offset & 3) << 1)) & 3;
+}  // xd_util_codepoint_width()
+
+/**
+ * @brief Decodes the UTF-8 encoded code point at the beginning of the passed
+ * string.
+ *
+ * Invalid sequences (bad lead or continuation bytes, overlong encodings,
+ * surrogates, and code points beyond `U+10FFFF`) decode as one byte of
+ * `U+FFFD`.
+ *
+ * @param str The string to decode.
+ * @param length The number of bytes available in the string.
+ * @param codepoint Pointer to store the decoded code point.
+ *
+ * @return The number of bytes decoded, or `0` if `length` is `0`.
+ */
+static size_t xd_util_utf8_decode(const char *str, size_t length,
+                                  uint32_t *codepoint) {
+  const unsigned char *bytes = (const unsigned char *)str;
+  *codepoint = XD_RL_UNICODE_REPLACEMENT;
+  if (length == 0) {
+    return 0;
+  }
+  if (bytes[0] < 0x80) {
+    *codepoint = bytes[0];
+    return 1;
+  }
+
+  size_t seq_length = 0;
+  uint32_t value = 0;
+  uint32_t min_value = 0;
+  if ((bytes[0] & 0xE0) == 0xC0) {
+    seq_length = 2;
+    value = bytes[0] & 0x1F;
+    min_value = 0x80;
+  }
+  else if ((bytes[0] & 0xF0) == 0xE0) {
+    seq_length = 3;
+    value = bytes[0] & 0x0F;
+    min_value = 0x800;
+  }
+  else if ((bytes[0] & 0xF8) == 0xF0) {
+    seq_length = 4;
+    value = bytes[0] & 0x07;
+    min_value = 0x10000;
+  }
+  else {
+    return 1;  // continuation or invalid lead byte
+  }
+
+  if (seq_length > length) {
+    return 1;
+  }
+  for (size_t i = 1; i < seq_length; i++) {
+    if ((bytes[i] & 0xC0) != 0x80) {
+      return 1;
+    }
+    value = (value << 6) | (bytes[i] & 0x3F);
+  }
+  if (value < min_value || value > XD_RL_UNICODE_MAX ||
+      (value >= 0xD800 && value <= 0xDFFF)) {
+    return 1;
+  }
+  *codepoint = value;
+  return seq_length;
+}  // xd_util_utf8_decode()
+
+/**
+ * @brief Encodes a code point as UTF-8.
+ *
+ * @param codepoint The code point to encode.
+ * @param str The buffer to store the encoded bytes in, at least
+ * `XD_RL_UTF8_SEQ_MAX` bytes long.
+ *
+ * @return The number of bytes stored, or `0` for surrogates and code points
+ * beyond `U+10FFFF`.
+ */
+static size_t xd_util_utf8_encode(uint32_t codepoint, char *str) {
+  if (codepoint < 0x80) {
+    str[0] = (char)codepoint;
+    return 1;
+  }
+  if (codepoint < 0x800) {
+    str[0] = (char)(0xC0 | (codepoint >> 6));
+    str[1] = (char)(0x80 | (codepoint & 0x3F));
+    return 2;
+  }
+  if (codepoint >= 0xD800 && codepoint <= 0xDFFF) {
+    return 0;
+  }
+  if (codepoint < 0x10000) {
+    str[0] = (char)(0xE0 | (codepoint >> 12));
+    str[1] = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+    str[2] = (char)(0x80 | (codepoint & 0x3F));
+    return 3;
+  }
+  if (codepoint > XD_RL_UNICODE_MAX) {
+    return 0;
+  }
+  str[0] = (char)(0xF0 | (codepoint >> 18));
+  str[1] = (char)(0x80 | ((codepoint >> 12) & 0x3F));
+  str[2] = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+  str[3] = (char)(0x80 | (codepoint & 0x3F));
+  return 4;
+}  // xd_util_utf8_encode()
+
+/**
+ * @brief Returns the number of terminal columns taken by the passed UTF-8
+ * string.
+ *
+ * @param str The string to get its display width.
+ * @param length The length of the string in bytes.
+ *
+ * @return The display width of the string.
+ */
+static size_t xd_util_str_width(const char *str, size_t length) {
+  size_t width = 0;
+  size_t idx = 0;
+  while (idx < length) {
+    if ((unsigned char)str[idx] < 0x80) {
+      width++;
+      idx++;
+      continue;
+    }
+    uint32_t codepoint;
+    idx += xd_util_utf8_decode(str + idx, length - idx, &codepoint);
+    width += xd_util_codepoint_width(codepoint);
+  }
+  return width;
+}  // xd_util_str_width()
+
+/**
+ * @brief Returns the flat position the cursor is at after writing the passed
+ * UTF-8 string to the terminal.
+ *
+ * A double-width character written at the last column of a row doesn't fit,
+ * the terminal moves it to the next row and leaves that column empty.
+ *
+ * @param str The string to be written.
+ * @param length The length of the string in bytes.
+ * @param pos The flat position the string is written from.
+ * @param win_width The width of the terminal.
+ *
+ * @return The flat position after the string.
+ */
+static size_t xd_util_str_advance(const char *str, size_t length, size_t pos,
+                                  size_t win_width) {
+  size_t idx = 0;
+  while (idx < length) {
+    if ((unsigned char)str[idx] < 0x80) {
+      pos++;
+      idx++;
+      continue;
+    }
+    uint32_t codepoint;
+    idx += xd_util_utf8_decode(str + idx, length - idx, &codepoint);
+    int width = xd_util_codepoint_width(codepoint);
+    if (width == 2 && win_width > 1 && pos % win_width == win_width - 1) {
+      pos++;
+    }
+    pos += width;
+  }
+  return pos;
+}  // xd_util_str_advance()
+
+/**
+ * @brief Finds the start of the character following the one at the passed
+ * index, zero-width code points are kept with the character preceding them.
+ *
+ * @param str The UTF-8 string.
+ * @param length The length of the string in bytes.
+ * @param idx The index of the current character.
+ *
+ * @return The index of the next character, or `length` if there is none.
+ */
+static size_t xd_util_utf8_next(const char *str, size_t length, size_t idx) {
+  if (idx >= length) {
+    return length;
+  }
+  uint32_t codepoint;
+  idx += xd_util_utf8_decode(str + idx, length - idx, &codepoint);
+  while (idx < length && (unsigned char)str[idx] >= 0x80) {
+    size_t seq_length =
+        xd_util_utf8_decode(str + idx, length - idx, &codepoint);
+    if (xd_util_codepoint_width(codepoint) != 0) {
+      break;
+    }
+    idx += seq_length;
+  }
+  return idx;
+}  // xd_util_utf8_next()
+
+/**
+ * @brief Finds the start of the character preceding the passed index,
+ * zero-width code points are kept with the character preceding them.
+ *
+ * @param str The UTF-8 string.
+ * @param idx The index of the current character.
+ *
+ * @return The index of the previous character, or `0` if there is none.
+ */
+static size_t xd_util_utf8_prev(const char *str, size_t idx) {
+  while (idx > 0) {
+    // step back over the continuation bytes to the lead byte
+    size_t start = idx - 1;
+    while (start > 0 && idx - start < XD_RL_UTF8_SEQ_MAX &&
+           ((unsigned char)str[start] & 0xC0) == 0x80) {
+      start--;
+    }
+    uint32_t codepoint;
+    if (xd_util_utf8_decode(str + start, idx - start, &codepoint) !=
+        idx - start) {
+      // not a valid sequence ending at `idx`, step back a single byte
+      start = idx - 1;
+      codepoint = XD_RL_UNICODE_REPLACEMENT;
+    }
+    idx = start;
+    if (xd_util_codepoint_width(codepoint) != 0) {
+      break;
+    }
+  }
+  return idx;
+}  // xd_util_utf8_prev()
+
+/**
+ * @brief Finds the first position at or after the passed index where a
+ * character starts when decoding the string from its beginning.
+ *
+ * Decoding only ever skips continuation bytes, so this only needs to look back
+ * at most `3` bytes for a lead byte whose sequence covers the index.
+ *
+ * @param str The UTF-8 string.
+ * @param length The length of the string in bytes.
+ * @param idx The index to synchronize.
+ *
+ * @return The index of the first character starting at or after `idx`.
+ */
+static size_t xd_util_utf8_sync(const char *str, size_t length, size_t idx) {
+  if (idx == 0 || idx >= length || ((unsigned char)str[idx] & 0xC0) != 0x80) {
+    return idx;
+  }
+  size_t start = idx - 1;
+  while (start > 0 && idx - start < XD_RL_UTF8_SEQ_MAX - 1 &&
+         ((unsigned char)str[start] & 0xC0) == 0x80) {
+    start--;
+  }
+  if (((unsigned char)str[start] & 0xC0) == 0x80) {
+    return idx;  // stray continuation byte, decoded on its own
+  }
+  uint32_t codepoint;
+  size_t seq_end = start + xd_util_utf8_decode(str + start, length - start,
+                                               &codepoint);
+  return seq_end > idx ? seq_end : idx;
+}  // xd_util_utf8_sync()
+
+/**
+ * @brief Builds the character class table used for word motion and for finding
+ * the word to be completed.
+ *
+ * Letters, digits, non-ASCII bytes (so that accented and non-Latin words move
+ * as a whole), and the passed extra characters are word characters.
+ *
+ * @param word_chars Extra word characters, or `NULL` for none.
+ */
+static void xd_util_char_class_init(const char *word_chars) {
+  memset(xd_char_class, 0, sizeof(xd_char_class));
+  for (int chr = 0; chr <= UCHAR_MAX; chr++) {
+    if ((chr >= '0' && chr <= '9') || (chr >= 'a' && chr <= 'z') ||
+        (chr >= 'A' && chr <= 'Z') || chr >= 0x80) {
+      xd_char_class[chr] |= XD_RL_CHAR_CLASS_WORD;
+    }
+  }
+  for (const char *chr = XD_RL_TAB_COMP_DELIMITERS; *chr != XD_RL_ASCII_NUL;
+       chr++) {
+    xd_char_class[(unsigned char)*chr] |= XD_RL_CHAR_CLASS_TAB_DELIM;
+  }
+
+#ifdef __SSE2__
+  xd_word_simd_extra_count = 0;
+#endif
+  for (const char *chr = word_chars; chr != NULL && *chr != XD_RL_ASCII_NUL;
+       chr++) {
+    unsigned char byte = (unsigned char)*chr;
+    if (xd_char_class[byte] & XD_RL_CHAR_CLASS_WORD) {
+      continue;
+    }
+    xd_char_class[byte] |= XD_RL_CHAR_CLASS_WORD;
+#ifdef __SSE2__
+    if (xd_word_simd_extra_count == XD_RL_WORD_SIMD_EXTRA_MAX) {
+      xd_word_simd_extra_count = -1;
+    }
+    if (xd_word_simd_extra_count != -1) {
+      xd_word_simd_extra[xd_word_simd_extra_count++] = *chr;
+    }
+#endif
+  }
+  xd_char_class_word_chars = word_chars;
+}  // xd_util_char_class_init()
+
+/**
+ * @brief Checks whether the passed byte is part of a word.
+ *
+ * @param chr The byte to check.
+ *
+ * @return Non-zero if the byte is part of a word or zero otherwise.
+ */
+static int xd_util_is_word_char(char chr) {
+  return xd_char_class[(unsigned char)chr] & XD_RL_CHAR_CLASS_WORD;
+}  // xd_util_is_word_char()
+
+#ifdef __SSE2__
+/**
+ * @brief Classifies `16` bytes at once according to the character class
+ * table, vectorized version of `xd_util_is_word_char()`.
+ *
+ * @param block The bytes to classify.
+ *
+ * @return Bitmask with bit `i` set if byte `i` is part of a word.
+ */
+static inline int xd_util_word_mask_sse2(__m128i block) {
+  // bytes `>= 0x80` are negative, so the signed range checks exclude them
+  __m128i digit =
+      _mm_and_si128(_mm_cmpgt_epi8(block, _mm_set1_epi8('0' - 1)),
+                    _mm_cmplt_epi8(block, _mm_set1_epi8('9' + 1)));
+  __m128i lower = _mm_or_si128(block, _mm_set1_epi8(0x20));
+  __m128i letter =
+      _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+                    _mm_cmplt_epi8(lower, _mm_set1_epi8('z' + 1)));
+  __m128i word = _mm_or_si128(digit, letter);
+  for (int i = 0; i < xd_word_simd_extra_count; i++) {
+    word = _mm_or_si128(
+        word, _mm_cmpeq_epi8(block, _mm_set1_epi8(xd_word_simd_extra[i])));
+  }
+  return _mm_movemask_epi8(word) | _mm_movemask_epi8(block);
+}  // xd_util_word_mask_sse2()
+#endif
+
+/**
+ * @brief Finds the first byte at or after the passed index that is not in the
+ * passed word state, scanning `16` bytes at a time where SSE2 is available.
+ *
+ * @param str The string to scan.
+ * @param idx The index to start scanning from.
+ * @param length The length of the string.
+ * @param in_word Whether to skip word bytes (non-zero) or non-word bytes
+ * (zero).
+ *
+ * @return The index of the first byte not in the state, or `length`.
+ */
+static size_t xd_util_word_scan_forward(const char *str, size_t idx,
+                                        size_t length, int in_word) {
+#ifdef __SSE2__
+  while (xd_word_simd_extra_count != -1 && idx + 16 <= length) {
+    int mask =
+        xd_util_word_mask_sse2(_mm_loadu_si128((const __m128i *)(str + idx)));
+    int other = (in_word ? ~mask : mask) & 0xFFFF;
+    if (other != 0) {
+      return idx + __builtin_ctz(other);
+    }
+    idx += 16;
+  }
+#endif
+  while (idx < length && !xd_util_is_word_char(str[idx]) == !in_word) {
+    idx++;
+  }
+  return idx;
+}  // xd_util_word_scan_forward()
+
+/**
+ * @brief Finds the start of the run of bytes in the passed word state ending
+ * before the passed index, scanning `16` bytes at a time where SSE2 is
+ * available.
+ *
+ * @param str The string to scan.
+ * @param idx The index after the last byte of the run.
+ * @param in_word Whether to skip word bytes (non-zero) or non-word bytes
+ * (zero).
+ *
+ * @return The index of the first byte of the run, or `0`.
+ */
+static size_t xd_util_word_scan_backward(const char *str, size_t idx,
+                                         int in_word) {
+#ifdef __SSE2__
+  while (xd_word_simd_extra_count != -1 && idx >= 16) {
+    int mask = xd_util_word_mask_sse2(
+        _mm_loadu_si128((const __m128i *)(str + idx - 16)));
+    int other = (in_word ? ~mask : mask) & 0xFFFF;
+    if (other != 0) {
+      return idx - 16 + (32 - __builtin_clz(other));
+    }
+    idx -= 16;
+  }
+#endif
+  while (idx > 0 && !xd_util_is_word_char(str[idx - 1]) == !in_word) {
+    idx--;
+  }
+  return idx;
+}  // xd_util_word_scan_backward()
+
+/**
+ * @brief Initializes the `xd-readline` library on first use: allocates the
+ * history and the input buffers, and builds the lookup tables.
+ *
+ * Nothing is done before `main()`, and signal dispositions and terminal
+ * settings are only changed while `xd_readline()` is running, so processes
+ * that link the library but never read interactively don't pay for it.
+ *
+ * @return `0` on success or `-1` with `errno` set to `ENOMEM` on allocation
+ * failure.
+ */
+static int xd_readline_lazy_init() {
+  if (!xd_readline_initialized) {
+    xd_readline_initialized = 1;
+
+    // key sequences may arrive split over the network
+    if (getenv("SSH_CONNECTION") != NULL || getenv("SSH_TTY") != NULL) {
+      xd_input_esc_timeout_auto = XD_RL_ESC_TIMEOUT_REMOTE;
+    }
+
+    // build the display width and character class tables
+    xd_util_width_table_init();
+    xd_util_char_class_init(xd_readline_word_chars);
+  }
+  // initialize the history and the input buffers, again on later calls if
+  // the allocation failed since nothing is left allocated then
+  if (xd_input_buffer == NULL && xd_readline_buffers_init() == -1) {
+    errno = ENOMEM;
+    return -1;
+  }
+  return 0;
+}  // xd_readline_lazy_init()
+
+/**
+ * @brief Destructor, runs before exit to cleanup after the `xd-readline`
+ * library.
+ */
+static void xd_readline_destroy() {
+  xd_readline_buffers_destroy();
+}  // xd_readline_destroy()
+
+/**
+ * @brief Allocates the history and the input buffers with the configured
+ * allocator.
+ *
+ * @return `0` on success or `-1` on allocation failure, in which case nothing
+ * is left allocated.
+ */
+static int xd_readline_buffers_init() {
+  // initialize the history
+  if (xd_readline_history_init() == -1) {
+    return -1;
+  }
+
+  // initialize input buffer and its display column index
+  xd_input_capacity = LINE_MAX;
+  xd_input_buffer = (char *)xd_util_malloc(sizeof(char) * xd_input_capacity);
+  xd_input_column_prefix = (size_t *)xd_util_malloc(
+      sizeof(size_t) * ((xd_input_capacity / XD_RL_COLUMN_CHUNK_SIZE) + 2));
+  if (xd_input_buffer == NULL || xd_input_column_prefix == NULL) {
+    xd_readline_buffers_destroy();
+    return -1;
+  }
+  xd_input_length = 0;
+  xd_input_buffer[0] = XD_RL_ASCII_NUL;
+  xd_input_column_valid = 0;
+  xd_memory_account(XD_RL_MEMORY_INPUT, 0,
+                    xd_input_buffer_size(xd_input_capacity));
+  xd_memory_recent_input = 0;
+
+#if XD_RL_ENABLE_SEARCH
+  // initialize search query buffer
+  xd_search_query_buffer =
+      (char *)xd_util_malloc(sizeof(char) * XD_RL_SEARCH_QUERY_MAX);
+  if (xd_search_query_buffer == NULL) {
+    xd_readline_buffers_destroy();
+    return -1;
+  }
+  xd_search_query_length = 0;
+  xd_search_query_buffer[0] = XD_RL_ASCII_NUL;
+  xd_memory_account(XD_RL_MEMORY_SEARCH, 0,
+                    sizeof(char) * XD_RL_SEARCH_QUERY_MAX);
+#endif
+  return 0;
+}  // xd_readline_buffers_init()
+
+/**
+ * @brief Frees the history and the input buffers.
+ */
+static void xd_readline_buffers_destroy() {
+  xd_readline_history_destroy();
+  xd_arena_destroy();
+  xd_stream_destroy();
+  xd_keymap_destroy();
+  xd_util_free(xd_input_buffer);
+  xd_util_free(xd_input_column_prefix);
+  xd_util_free(xd_input_lines);
+  xd_memory_account(XD_RL_MEMORY_INPUT,
+                    xd_memory_usage[XD_RL_MEMORY_INPUT].current, 0);
+  xd_input_buffer = NULL;
+  xd_input_column_prefix = NULL;
+  xd_input_lines = NULL;
+  xd_input_lines_capacity = 0;
+  xd_input_lines_count = 0;
+  xd_input_lines_scanned = 0;
+#if XD_RL_ENABLE_SEARCH
+  xd_util_free(xd_search_query_buffer);
+  xd_memory_account(XD_RL_MEMORY_SEARCH,
+                    xd_memory_usage[XD_RL_MEMORY_SEARCH].current, 0);
+  xd_search_query_buffer = NULL;
+#endif
+}  // xd_readline_buffers_destroy()
+
+/**
+ * @brief Initialize the history array by allocating all the entries up-front in
+ * a single contiguous block to reduce the allocation-deallocation overhead.
+ *
+ * @return `0` on success or `-1` on allocation failure, in which case nothing
+ * is left allocated.
+ */
+static int xd_readline_history_init() {
+  xd_history = (xd_history_entry_t **)xd_util_malloc(
+      sizeof(xd_history_entry_t *) * (XD_RL_HISTORY_MAX + 1));
+  xd_history_entries = (xd_history_entry_t *)xd_util_malloc(
+      sizeof(xd_history_entry_t) * (XD_RL_HISTORY_MAX + 1));
+  xd_intern_table = (xd_intern_t **)xd_util_malloc(sizeof(xd_intern_t *) *
+                                                   XD_RL_INTERN_BUCKETS);
+#if XD_RL_ENABLE_SUGGESTION
+  xd_predict_table = (xd_successor_set_t *)xd_util_malloc(
+      sizeof(xd_successor_set_t) * XD_RL_PREDICT_BUCKETS);
+#endif
+  if (xd_history == NULL || xd_history_entries == NULL ||
+      xd_intern_table == NULL ||
+      (XD_RL_ENABLE_SUGGESTION && xd_predict_table == NULL)) {
+    xd_util_free((void *)xd_predict_table);
+    xd_util_free((void *)xd_history_entries);
+    xd_util_free((void *)xd_history);
+    xd_util_free((void *)xd_intern_table);
+    xd_history = NULL;
+    xd_history_entries = NULL;
+    xd_intern_table = NULL;
+    xd_predict_table = NULL;
+    return -1;
+  }
+
+  for (int i = 0; i < XD_RL_INTERN_BUCKETS; i++) {
+    xd_intern_table[i] = NULL;
+  }
+
+  for (int i = 0; i <= XD_RL_HISTORY_MAX; i++) {
+    xd_history[i] = &xd_history_entries[i];
+    xd_history[i]->str = xd_history[i]->inline_str;
+    xd_history_entry_reset(xd_history[i]);
+  }
+
+#if XD_RL_ENABLE_SUGGESTION
+  for (int i = 0; i < XD_RL_PREDICT_BUCKETS; i++) {
+    xd_predict_table[i].used = 0;
+    for (int j = 0; j < XD_RL_PREDICT_WAYS; j++) {
+      xd_successor_t *successor = &xd_predict_table[i].successors[j];
+      successor->command.str = successor->command.inline_str;
+      xd_history_entry_reset(&successor->command);
+      successor->count = 0;
+    }
+  }
+  xd_predict_has_last = 0;
+#endif
+
+  xd_history_nav_idx = XD_RL_HISTORY_MAX;
+  xd_history_start_idx = 0;
+  xd_history_end_idx = XD_RL_HISTORY_MAX - 1;
+  xd_history_length = 0;
+  xd_history_bytes = 0;
+  xd_memory_account(XD_RL_MEMORY_HISTORY, 0,
+                    xd_readline_history_tables_size());
+  return 0;
+}  // xd_readline_history_init()
+
+/**
+ * @brief Returns the size in bytes of the fixed-size history tables allocated
+ * by `xd_readline_history_init()`.
  *
- * @param strings Sorted, null-terminated array of strings.
+ * @return The size of the history tables.
+ */
+static size_t xd_readline_history_tables_size() {
+  return sizeof(xd_history_entry_t *) * (XD_RL_HISTORY_MAX + 1) +
+         sizeof(xd_history_entry_t) * (XD_RL_HISTORY_MAX + 1) +
+         sizeof(xd_intern_t *) * XD_RL_INTERN_BUCKETS +
+         (XD_RL_ENABLE_SUGGESTION
+              ? sizeof(xd_successor_set_t) * XD_RL_PREDICT_BUCKETS
+              : 0);
+}  // xd_readline_history_tables_size()
+
+/**
+ * @brief Frees the resources used for the history.
+ */
+static void xd_readline_history_destroy() {
+  if (xd_history == NULL) {
+    return;
+  }
+  for (int i = 0; i <= XD_RL_HISTORY_MAX; i++) {
+    xd_history_entry_reset(xd_history[i]);
+  }
+#if XD_RL_ENABLE_SUGGESTION
+  xd_readline_predict_reset();
+#endif
+  xd_util_free((void *)xd_predict_table);
+  xd_util_free((void *)xd_history_entries);
+  xd_util_free((void *)xd_history);
+  xd_util_free((void *)xd_intern_table);
+  xd_util_free(xd_history_scratch);
+  xd_memory_account(XD_RL_MEMORY_HISTORY,
+                    xd_memory_usage[XD_RL_MEMORY_HISTORY].current, 0);
+  xd_history = NULL;
+  xd_history_entries = NULL;
+  xd_intern_table = NULL;
+  xd_predict_table = NULL;
+  xd_history_scratch = NULL;
+  xd_history_scratch_capacity = 0;
+  xd_history_length = 0;
+}  // xd_readline_history_destroy()
+
+/**
+ * @brief Removes one entry from the beginning side of the history according to
+ * `xd_readline_history_eviction`, keeping the order of the remaining entries.
  *
- * @return Pointer to a newly allocated string containing the longest common
- * prefix, or `NULL` if the passed array is `NULL` or empty or on allocation
- * failure.
+ * Runs in constant time, at most `XD_RL_HISTORY_EVICT_WINDOW` entries are
+ * examined and shifted, unless only entries holding interned strings are
+ * candidates, in which case the entries holding inline strings before them
+ * are examined and shifted as well.
+ *
+ * @param interned_only Whether only the entries holding interned strings,
+ * the only ones whose eviction can release memory, are candidates (non-zero)
+ * or all of them are (zero).
+ *
+ * @return `0` on success or `-1` if there was no candidate.
  */
-static char *xd_util_longest_common_prefix(const char **strings) {
-  if (strings == NULL || strings[0] == NULL) {
+static int xd_readline_history_evict(int interned_only) {
+  int victim_offset = -1;
+  int first_offset = -1;
+  int candidates = 0;
+  for (int i = 0; i < xd_history_length; i++) {
+    xd_history_entry_t *history_entry =
+        xd_history[(xd_history_start_idx + i) % XD_RL_HISTORY_MAX];
+    if (interned_only && !xd_history_entry_is_interned(history_entry)) {
+      continue;
+    }
+    if (first_offset == -1) {
+      first_offset = i;
+    }
+    if (xd_readline_history_eviction != XD_RL_HISTORY_EVICT_FREQUENCY ||
+        history_entry->hits == 0) {
+      victim_offset = i;
+      break;
+    }
+    // passed over, decay its protection
+    history_entry->hits--;
+    if (++candidates == XD_RL_HISTORY_EVICT_WINDOW) {
+      break;
+    }
+  }
+  if (first_offset == -1) {
+    return -1;
+  }
+  // all entries in the window are protected, fall back to the oldest
+  if (victim_offset == -1) {
+    victim_offset = first_offset;
+  }
+
+  // shift the entries older than the victim forward by one so the freed slot
+  // ends up at the beginning of the history
+  int victim_idx = (xd_history_start_idx + victim_offset) % XD_RL_HISTORY_MAX;
+  xd_history_entry_t *victim = xd_history[victim_idx];
+  for (int i = victim_offset; i > 0; i--) {
+    xd_history[(xd_history_start_idx + i) % XD_RL_HISTORY_MAX] =
+        xd_history[(xd_history_start_idx + i - 1) % XD_RL_HISTORY_MAX];
+  }
+  xd_history[xd_history_start_idx] = victim;
+
+  xd_history_bytes -= victim->length;
+  xd_history_entry_reset(victim);
+
+  xd_history_start_idx = (xd_history_start_idx + 1) % XD_RL_HISTORY_MAX;
+  xd_history_length--;
+  return 0;
+}  // xd_readline_history_evict()
+
+/**
+ * @brief Adds the passed string to the end of the history, see
+ * `xd_readline_history_add()`.
+ *
+ * @param str The string to be added, may contain null bytes.
+ * @param length The length of the string.
+ *
+ * @return `0` on success or `-1` on failure.
+ */
+static int xd_readline_history_add_n(const char *str, size_t length) {
+  if (xd_readline_lazy_init() == -1) {
+    return -1;
+  }
+
+  // ignore the trailing newline at the end
+  if (length > 0 && str[length - 1] == XD_RL_ASCII_LF) {
+    length--;
+  }
+
+  if (xd_readline_history_max_bytes != 0 &&
+      length > xd_readline_history_max_bytes) {
+    return -1;
+  }
+
+  // hashed once, used for interning and later equality checks
+  uint32_t hash = xd_util_hash(str, length);
+
+  // strings that don't fit inline are interned, before any entry is evicted
+  // so that a failed allocation leaves the history unchanged
+  xd_intern_t *intern = NULL;
+  if (length >= XD_RL_HISTORY_INLINE_SIZE) {
+    size_t str_size = sizeof(xd_intern_t) + sizeof(char) * (length + 1);
+#if XD_RL_ENABLE_SUGGESTION
+    // over the memory budget, drop the predictions first since they are only
+    // a cache, and they keep evicted entries' strings alive
+    if (!xd_memory_fits(str_size)) {
+      xd_readline_predict_reset();
+    }
+#endif
+    // evict entries until the interned copy fits within the memory budget,
+    // only those holding interned strings since the others release nothing,
+    // and the usage may be over the budget for other reasons
+    while ((intern = xd_intern_acquire(str, length, hash)) == NULL &&
+           !xd_memory_fits(str_size) &&
+           xd_readline_history_evict(1) == 0) {
+    }
+    if (intern == NULL) {
+      // refusing an entry over the budget isn't reported as a failure
+      if (xd_memory_fits(str_size)) {
+        fprintf(stderr, "xd_readline: failed to allocate memory: %s\n",
+                strerror(errno));
+      }
+      return -1;
+    }
+  }
+
+  // evict entries until the new one fits within the limits
+  while (xd_history_length == XD_RL_HISTORY_MAX ||
+         (xd_readline_history_max_bytes != 0 &&
+          xd_history_bytes + length > xd_readline_history_max_bytes)) {
+    xd_readline_history_evict(0);
+  }
+
+  // doesn't allocate since the string is inline or already interned, the
+  // reference acquired above is dropped once the entry holds its own
+  int new_end_idx = (xd_history_end_idx + 1) % XD_RL_HISTORY_MAX;
+  xd_history_entry_t *history_entry = xd_history[new_end_idx];
+  xd_history_entry_set(history_entry, str, length, hash);
+  if (intern != NULL) {
+    xd_intern_release(intern);
+  }
+
+  // add to history
+  xd_history_length++;
+  xd_history_end_idx = new_end_idx;
+  xd_history_bytes += length;
+  history_entry->hits = 0;
+#if XD_RL_ENABLE_SUGGESTION
+  xd_readline_predict_update(history_entry);
+#endif
+
+  return 0;
+}  // xd_readline_history_add_n()
+
+/**
+ * @brief Returns a reference to the interned copy of the passed string,
+ * interning it first if it wasn't already.
+ *
+ * @param str The string to be interned, doesn't have to be null-terminated.
+ * @param length The length of the string.
+ * @param hash The hash of the string as returned by `xd_util_hash()`.
+ *
+ * @return The interned string, or `NULL` on allocation failure.
+ */
+static xd_intern_t *xd_intern_acquire(const char *str, size_t length,
+                                      uint32_t hash) {
+  xd_intern_t **bucket = &xd_intern_table[hash & (XD_RL_INTERN_BUCKETS - 1)];
+  for (xd_intern_t *intern = *bucket; intern != NULL; intern = intern->next) {
+    if (intern->hash == hash && intern->length == length &&
+        memcmp(intern->str, str, length) == 0) {
+      intern->refcount++;
+      return intern;
+    }
+  }
+
+  if (length > XD_RL_CAPACITY_MAX) {
+    errno = ENOMEM;
     return NULL;
   }
-  const char *first_str = strings[0];
-  int lcp_length = 0;
-  int done = 0;
-  while (!done) {
-    char chr = first_str[lcp_length];
-    if (chr == XD_RL_ASCII_NUL) {
-      break;
+  size_t size = sizeof(xd_intern_t) + sizeof(char) * (length + 1);
+  if (!xd_memory_fits(size)) {
+    errno = ENOMEM;
+    return NULL;
+  }
+  xd_intern_t *intern = (xd_intern_t *)xd_util_malloc(size);
+  if (intern == NULL) {
+    return NULL;
+  }
+  xd_memory_account(XD_RL_MEMORY_HISTORY, 0, size);
+  intern->hash = hash;
+  intern->refcount = 1;
+  intern->length = length;
+  memcpy(intern->str, str, length);
+  intern->str[length] = XD_RL_ASCII_NUL;
+  intern->next = *bucket;
+  *bucket = intern;
+  return intern;
+}  // xd_intern_acquire()
+
+/**
+ * @brief Drops a reference to the passed interned string, freeing it when no
+ * references are left.
+ *
+ * @param intern The interned string to be released.
+ */
+static void xd_intern_release(xd_intern_t *intern) {
+  if (--intern->refcount > 0) {
+    return;
+  }
+  xd_intern_t **link =
+      &xd_intern_table[intern->hash & (XD_RL_INTERN_BUCKETS - 1)];
+  while (*link != intern) {
+    link = &(*link)->next;
+  }
+  *link = intern->next;
+  xd_memory_account(XD_RL_MEMORY_HISTORY,
+                    sizeof(xd_intern_t) + sizeof(char) * (intern->length + 1),
+                    0);
+  xd_util_free(intern);
+}  // xd_intern_release()
+
+/**
+ * @brief Empties the passed history entry, releasing its interned string if it
+ * has one.
+ *
+ * @param history_entry The history entry to be reset.
+ */
+static void xd_history_entry_reset(xd_history_entry_t *history_entry) {
+  if (xd_history_entry_is_interned(history_entry)) {
+    xd_intern_release((xd_intern_t *)(history_entry->str -
+                                      offsetof(xd_intern_t, str)));
+    history_entry->str = history_entry->inline_str;
+  }
+  history_entry->hash = xd_util_hash(NULL, 0);
+  history_entry->length = 0;
+  history_entry->mask = 0;
+  history_entry->hits = 0;
+  history_entry->str[0] = XD_RL_ASCII_NUL;
+}  // xd_history_entry_reset()
+
+/**
+ * @brief Checks whether the string of the passed history entry is an interned
+ * string, rather than stored inline or in the scratch slot's own storage.
+ *
+ * @param history_entry The history entry to check.
+ *
+ * @return Non-zero if the string is interned or zero otherwise.
+ */
+static int xd_history_entry_is_interned(
+    const xd_history_entry_t *history_entry) {
+  return history_entry->str != history_entry->inline_str &&
+         history_entry->str != xd_history_scratch;
+}  // xd_history_entry_is_interned()
+
+/**
+ * @brief Sets the string of the passed history entry to the passed string,
+ * the string is copied inline if it fits, otherwise the entry references the
+ * interned copy of the string so identical long strings share storage.
+ *
+ * @param history_entry The history entry to be set.
+ * @param str The string to be copied, doesn't have to be null-terminated.
+ * @param length The number of characters to be copied.
+ * @param hash The hash of the string as returned by `xd_util_hash()`.
+ *
+ * @return `0` on success or `-1` on allocation failure, in which case the
+ * entry is left unchanged.
+ */
+static int xd_history_entry_set(xd_history_entry_t *history_entry,
+                                const char *str, size_t length, uint32_t hash) {
+  if (length < XD_RL_HISTORY_INLINE_SIZE) {
+    if (xd_history_entry_is_interned(history_entry)) {
+      xd_intern_release((xd_intern_t *)(history_entry->str -
+                                        offsetof(xd_intern_t, str)));
+      history_entry->str = history_entry->inline_str;
     }
-    for (int i = 1; strings[i] != XD_RL_ASCII_NUL; i++) {
-      if (strings[i][lcp_length] != chr) {
-        done = 1;
-        break;
+    memmove(history_entry->str, str, length);
+    history_entry->str[length] = XD_RL_ASCII_NUL;
+  }
+  else {
+    // acquire before releasing in case both are the same interned string
+    xd_intern_t *intern = xd_intern_acquire(str, length, hash);
+    if (intern == NULL) {
+      return -1;
+    }
+    if (xd_history_entry_is_interned(history_entry)) {
+      xd_intern_release((xd_intern_t *)(history_entry->str -
+                                        offsetof(xd_intern_t, str)));
+    }
+    history_entry->str = intern->str;
+  }
+
+  history_entry->hash = hash;
+  history_entry->length = length;
+  history_entry->mask = xd_util_byte_mask(str, length);
+  return 0;
+}  // xd_history_entry_set()
+
+#if XD_RL_ENABLE_SUGGESTION
+/**
+ * @brief Checks whether the passed history entries hold the same string.
+ *
+ * Long strings are interned, so they are equal only if they are the same
+ * interned string, short strings are compared after their hashes.
+ *
+ * @param first The first history entry.
+ * @param second The second history entry.
+ *
+ * @return Non-zero if the strings are equal or zero otherwise.
+ */
+static int xd_history_entry_equals(const xd_history_entry_t *first,
+                                   const xd_history_entry_t *second) {
+  if (first->hash != second->hash || first->length != second->length) {
+    return 0;
+  }
+  if (first->length >= XD_RL_HISTORY_INLINE_SIZE) {
+    return first->str == second->str;
+  }
+  return memcmp(first->str, second->str, first->length) == 0;
+}  // xd_history_entry_equals()
+#endif
+
+/**
+ * @brief Sets the string of the scratch history slot (at `XD_RL_HISTORY_MAX`)
+ * to the passed string, the string is copied inline if it fits, otherwise to
+ * the slot's own storage which only grows, so this doesn't allocate once it is
+ * large enough.
+ *
+ * @param str The string to be copied, doesn't have to be null-terminated.
+ * @param length The number of characters to be copied.
+ * @param hash The hash of the string as returned by `xd_util_hash()`.
+ *
+ * @return `0` on success or `-1` on allocation failure, in which case the
+ * slot is left unchanged.
+ */
+static int xd_history_scratch_set(const char *str, size_t length,
+                                  uint32_t hash) {
+  xd_history_entry_t *scratch = xd_history[XD_RL_HISTORY_MAX];
+  if (length < XD_RL_HISTORY_INLINE_SIZE) {
+    scratch->str = scratch->inline_str;
+  }
+  else {
+    if (length + 1 > xd_history_scratch_capacity) {
+      size_t new_capacity = xd_memory_grow_target(xd_history_scratch_capacity,
+                                                  length, 1, LINE_MAX);
+      if (new_capacity == 0 ||
+          !xd_memory_fits(new_capacity - xd_history_scratch_capacity)) {
+        return -1;
+      }
+      XD_RL_ALLOC_EXPECTED_BEGIN();  // growth is amortized over the line
+      char *ptr = (char *)xd_util_realloc(xd_history_scratch,
+                                          sizeof(char) * new_capacity);
+      XD_RL_ALLOC_EXPECTED_END();
+      if (ptr == NULL) {
+        return -1;
       }
+      xd_memory_account(XD_RL_MEMORY_HISTORY, xd_history_scratch_capacity,
+                        new_capacity);
+      xd_history_scratch = ptr;
+      xd_history_scratch_capacity = new_capacity;
     }
-    if (!done) {
-      lcp_length++;
+    scratch->str = xd_history_scratch;
+  }
+  memmove(scratch->str, str, length);
+  scratch->str[length] = XD_RL_ASCII_NUL;
+  scratch->hash = hash;
+  scratch->length = length;
+  scratch->mask = xd_util_byte_mask(str, length);
+  return 0;
+}  // xd_history_scratch_set()
+
+/**
+ * @brief Writes the passed history entry to a history file as one record
+ * ended by a newline.
+ *
+ * The newlines of multi-line entries are written as `\n`, and a backslash is
+ * doubled when it comes before a backslash, an `n`, or a newline, so other
+ * backslashes are written as they are.
+ *
+ * @param history_entry The history entry to be written.
+ * @param file The file to write to.
+ */
+static void xd_history_entry_write(const xd_history_entry_t *history_entry,
+                                   FILE *file) {
+  const char *str = history_entry->str;
+  size_t length = history_entry->length;
+  for (size_t i = 0; i < length; i++) {
+    if (str[i] == XD_RL_ASCII_LF) {
+      fputs("\\n", file);
+      continue;
+    }
+    if (str[i] == '\\' && i + 1 < length &&
+        (str[i + 1] == '\\' || str[i + 1] == 'n' ||
+         str[i + 1] == XD_RL_ASCII_LF)) {
+      fputc('\\', file);
     }
+    fputc(str[i], file);
   }
-  return lcp_length == 0 ? NULL : strndup(first_str, lcp_length);
-}  // xd_util_longest_common_prefix()
+  fputc(XD_RL_ASCII_LF, file);
+}  // xd_history_entry_write()
 
 /**
- * @brief Helper used to print all possible completions when the `Tab` key is
- * pressed more than once and there is more than one completion.
+ * @brief Turns a record read from a history file back into the history entry
+ * written by `xd_history_entry_write()`, in place.
  *
- * @param completions Sorted, null-terminated array of possible completions.
+ * @param record The record, without its terminating newline.
+ * @param length The length of the record.
+ *
+ * @return The length of the history entry.
  */
-static void xd_util_print_completions(char **completions) {
-  if (completions == NULL || *completions == NULL) {
+static size_t xd_history_record_unescape(char *record, size_t length) {
+  size_t dst = 0;
+  for (size_t src = 0; src < length; src++) {
+    if (record[src] == '\\' && src + 1 < length) {
+      if (record[src + 1] == 'n') {
+        record[dst++] = XD_RL_ASCII_LF;
+        src++;
+        continue;
+      }
+      if (record[src + 1] == '\\') {
+        src++;
+      }
+    }
+    record[dst++] = record[src];
+  }
+  return dst;
+}  // xd_history_record_unescape()
+
+#if XD_RL_ENABLE_SUGGESTION
+/**
+ * @brief Forgets all the learned successors.
+ */
+static void xd_readline_predict_reset() {
+  for (int i = 0; i < XD_RL_PREDICT_BUCKETS; i++) {
+    xd_successor_set_t *set = &xd_predict_table[i];
+    if (!set->used) {
+      continue;
+    }
+    set->used = 0;
+    for (int j = 0; j < XD_RL_PREDICT_WAYS; j++) {
+      xd_history_entry_reset(&set->successors[j].command);
+      set->successors[j].count = 0;
+    }
+  }
+  xd_predict_has_last = 0;
+}  // xd_readline_predict_reset()
+#endif
+
+#if XD_RL_ENABLE_SUGGESTION
+/**
+ * @brief Records the passed command as a successor of the previously added
+ * command, in constant time.
+ *
+ * If the successor set is full, the least frequent successor is replaced.
+ *
+ * @param command The history entry of the command that was just added.
+ */
+static void xd_readline_predict_update(const xd_history_entry_t *command) {
+  if (xd_predict_has_last) {
+    xd_successor_set_t *set =
+        &xd_predict_table[xd_predict_last_hash & (XD_RL_PREDICT_BUCKETS - 1)];
+    if (!set->used || set->hash != xd_predict_last_hash) {
+      // empty, or taken by another command: start over
+      for (int i = 0; i < XD_RL_PREDICT_WAYS; i++) {
+        xd_history_entry_reset(&set->successors[i].command);
+        set->successors[i].count = 0;
+      }
+      set->hash = xd_predict_last_hash;
+      set->used = 1;
+    }
+
+    xd_successor_t *least = &set->successors[0];
+    xd_successor_t *match = NULL;
+    for (int i = 0; i < XD_RL_PREDICT_WAYS && match == NULL; i++) {
+      xd_successor_t *successor = &set->successors[i];
+      if (successor->count > 0 &&
+          xd_history_entry_equals(&successor->command, command)) {
+        match = successor;
+      }
+      else if (successor->count < least->count) {
+        least = successor;
+      }
+    }
+
+    if (match != NULL) {
+      match->count++;
+    }
+    else if (xd_history_entry_set(&least->command, command->str,
+                                  command->length, command->hash) == 0) {
+      least->count = 1;
+    }
+  }
+  xd_predict_last_hash = command->hash;
+  xd_predict_has_last = 1;
+}  // xd_readline_predict_update()
+#endif
+
+#if XD_RL_ENABLE_SUGGESTION
+/**
+ * @brief Returns the most frequent successor of the last command added to the
+ * history, in constant time.
+ *
+ * @return The history entry of the predicted next command, or `NULL` if there
+ * is no prediction.
+ */
+static const xd_history_entry_t *xd_readline_predict_next() {
+  if (!xd_predict_has_last) {
+    return NULL;
+  }
+  const xd_successor_set_t *set =
+      &xd_predict_table[xd_predict_last_hash & (XD_RL_PREDICT_BUCKETS - 1)];
+  if (!set->used || set->hash != xd_predict_last_hash) {
+    return NULL;
+  }
+  const xd_successor_t *best = NULL;
+  for (int i = 0; i < XD_RL_PREDICT_WAYS; i++) {
+    if (set->successors[i].count > 0 &&
+        (best == NULL || set->successors[i].count > best->count)) {
+      best = &set->successors[i];
+    }
+  }
+  return best == NULL || best->command.length == 0 ? NULL : &best->command;
+}  // xd_readline_predict_next()
+#endif
+
+/**
+ * @brief Inserts the passed character into the input buffer at the cursor
+ * position.
+ *
+ * @param chr The character to be inserted.
+ */
+static void xd_input_buffer_insert(char chr) {
+  if (chr == XD_RL_ASCII_NUL || xd_input_length + 2 > xd_input_capacity) {
     return;
   }
-  // restore original terminal settings so we can use printf
-  xd_tty_restore();
+  xd_input_buffer_invalidate(xd_input_cursor);
+  // shift all the characters starting from the cursor by one to the right
+  for (size_t i = xd_input_length; i > xd_input_cursor; i--) {
+    xd_input_buffer[i] = xd_input_buffer[i - 1];
+  }
+  // insert the new character
+  xd_input_buffer[xd_input_cursor++] = chr;
+  xd_input_buffer[++xd_input_length] = XD_RL_ASCII_NUL;
+}  // xd_input_buffer_insert()
 
-  int longest_completion_length = 0;
-  int completions_count = 0;
-  for (int i = 0; completions[i] != NULL; i++) {
-    if ((int)strlen(completions[i]) > longest_completion_length) {
-      longest_completion_length = (int)strlen(completions[i]);
+#if XD_RL_ENABLE_COMPLETION
+/**
+ * @brief Inserts the characters of the passed string into the input buffer at
+ * the cursor position.
+ *
+ * @param str The string to be inserted.
+ * @param length The number of characters to be inserted.
+ */
+static void xd_input_buffer_insert_string(const char *str, size_t length) {
+  if (str == NULL || length == 0) {
+    return;
+  }
+  if (xd_input_buffer_reserve(length) == -1) {
+    return;  // allocation error, stop inserting
+  }
+  for (size_t i = 0; i < length; i++) {
+    xd_input_buffer_insert(str[i]);
+  }
+}  // xd_input_buffer_insert_string()
+#endif
+
+/**
+ * @brief Grows the input buffer if needed so that it can take the passed number
+ * of bytes in addition to its contents, a new-line, and a null-terminator.
+ *
+ * @param n The number of bytes to make room for.
+ *
+ * @return `0` on success or `-1` on allocation failure, or if the input would
+ * exceed `XD_RL_CAPACITY_MAX` bytes.
+ */
+static int xd_input_buffer_reserve(size_t n) {
+  size_t new_capacity = xd_memory_grow_target(
+      xd_input_capacity, xd_input_length + 2, n, LINE_MAX);
+  if (new_capacity == 0) {
+    return -1;
+  }
+  if (new_capacity == xd_input_capacity) {
+    return 0;
+  }
+  if (!xd_memory_fits(xd_input_buffer_size(new_capacity) -
+                      xd_input_buffer_size(xd_input_capacity))) {
+    return -1;
+  }
+  XD_RL_ALLOC_EXPECTED_BEGIN();  // growth is amortized over the line
+  size_t *prefix = (size_t *)xd_util_realloc(
+      xd_input_column_prefix,
+      sizeof(size_t) * ((new_capacity / XD_RL_COLUMN_CHUNK_SIZE) + 2));
+  char *ptr = NULL;
+  if (prefix != NULL) {
+    xd_input_column_prefix = prefix;
+    ptr = (char *)xd_util_realloc(xd_input_buffer, sizeof(char) * new_capacity);
+  }
+  XD_RL_ALLOC_EXPECTED_END();
+  if (ptr == NULL) {
+    return -1;
+  }
+  xd_memory_account(XD_RL_MEMORY_INPUT, xd_input_buffer_size(xd_input_capacity),
+                    xd_input_buffer_size(new_capacity));
+  xd_input_capacity = new_capacity;
+  xd_input_buffer = ptr;
+  return 0;
+}  // xd_input_buffer_reserve()
+
+/**
+ * @brief Returns the size in bytes of the input buffer and its display column
+ * index for the passed capacity.
+ *
+ * @param capacity The capacity of the input buffer.
+ *
+ * @return The size of the input buffer and its index.
+ */
+static size_t xd_input_buffer_size(size_t capacity) {
+  return sizeof(char) * capacity +
+         sizeof(size_t) * ((capacity / XD_RL_COLUMN_CHUNK_SIZE) + 2);
+}  // xd_input_buffer_size()
+
+/**
+ * @brief Exchanges the input buffer holding the line read with the passed
+ * buffer, which becomes the input buffer, so the line is handed over without
+ * copying it.
+ *
+ * @param buffer Pointer to the buffer to exchange, allocated with the
+ * configured allocator or `NULL`, receives the input buffer.
+ * @param capacity Pointer to the capacity of the buffer, receives the capacity
+ * of the input buffer.
+ *
+ * @return `0` on success or `-1` on allocation failure or if the buffer would
+ * exceed the memory budget, in which case the input buffer is left unchanged
+ * and the passed buffer may have been grown.
+ */
+static int xd_input_buffer_exchange(char **buffer, size_t *capacity) {
+  char *other = *buffer;
+  size_t other_capacity = other == NULL ? 0 : *capacity;
+  if (other_capacity < LINE_MAX) {
+    // too small to edit the next line in
+    other = (char *)xd_util_realloc(other, sizeof(char) * LINE_MAX);
+    if (other == NULL) {
+      return -1;
     }
-    completions_count++;
+    other_capacity = LINE_MAX;
+    *buffer = other;
+    *capacity = other_capacity;
   }
 
-  // calculate the number of rows and columns
-  int col_length = longest_completion_length + 2;
-  if (col_length > xd_tty_win_width) {
-    col_length = xd_tty_win_width;
+  size_t old_size = xd_input_buffer_size(xd_input_capacity);
+  size_t new_size = xd_input_buffer_size(other_capacity);
+  if (new_size > old_size && !xd_memory_fits(new_size - old_size)) {
+    return -1;
   }
-  int col_count = xd_tty_win_width / col_length;
-  int row_count = (completions_count + col_count - 1) / col_count;
-
-  // print completions
-  printf("\n");
-  for (int row = 0; row < row_count; row++) {
-    for (int col = 0; col < col_count; col++) {
-      int idx = row + (col * row_count);
-      if (idx < completions_count) {
-        const char *basename =
-            xd_util_base_name_keep_trailing_slash(completions[idx]);
-        printf("%-*s", col_length, basename);
-      }
-    }
-    printf("\n");
+  size_t *prefix = (size_t *)xd_util_realloc(
+      xd_input_column_prefix,
+      sizeof(size_t) * ((other_capacity / XD_RL_COLUMN_CHUNK_SIZE) + 2));
+  if (prefix == NULL) {
+    return -1;
   }
+  xd_input_column_prefix = prefix;
+  xd_memory_account(XD_RL_MEMORY_INPUT, old_size, new_size);
 
-  // change the terminal settings back to raw
-  xd_tty_raw();
-
-  // start fresh on new line
-  xd_tty_cursor_row = 1;
-  xd_tty_cursor_col = 1;
-  xd_tty_chars_count = 0;
-  xd_readline_redraw = 1;
-}  // xd_util_print_completions()
+  *buffer = xd_input_buffer;
+  *capacity = xd_input_capacity;
+  xd_input_buffer = other;
+  xd_input_capacity = other_capacity;
+  xd_input_length = 0;
+  xd_input_buffer[0] = XD_RL_ASCII_NUL;
+  xd_input_buffer_invalidate(0);
+  return 0;
+}  // xd_input_buffer_exchange()
 
 /**
- * @brief Returns a pointer to the last segment of the passed path.
+ * @brief Marks the display column index and the line index as out of date from
+ * the passed index of the input buffer onward, must be called whenever the
+ * buffer is modified, before modifying it.
  *
- * @param path The path to return its last segment.
+ * Edits at the end of the input only invalidate the last chunk, while edits in
+ * the middle invalidate the rest of the indexes, which are rebuilt lazily by
+ * the next query past the edit point.
  *
- * @return Pointer to the beginning of the last segment.
+ * @param idx The index of the first modified byte.
  */
-static const char *xd_util_base_name_keep_trailing_slash(const char *path) {
-  if (path == NULL || *path == '\0') {
-    return path;
+static void xd_input_buffer_invalidate(size_t idx) {
+  // a character starting in an earlier chunk may span up to the modified byte
+  size_t chunk = idx > XD_RL_UTF8_SEQ_MAX
+                     ? (idx - XD_RL_UTF8_SEQ_MAX) / XD_RL_COLUMN_CHUNK_SIZE
+                     : 0;
+  if (chunk < xd_input_column_valid) {
+    xd_input_column_valid = chunk;
   }
 
-  int path_length = (int)strlen(path);
-  const char *last_slash = NULL;
-  for (int i = path_length - 1; i >= 0; i--) {
-    if (path[i] == '/' && i != path_length - 1) {
-      last_slash = path + i + 1;
-      break;
-    }
+  // lines starting up to the modified byte are kept
+  if (idx < xd_input_lines_scanned) {
+    xd_input_lines_count = xd_input_lines_find(idx);
+    xd_input_lines_scanned = idx;
   }
-  return last_slash == NULL ? path : last_slash;
-}  // xd_util_base_name_keep_trailing_slash()
+  if (idx < xd_input_dirty_idx) {
+    xd_input_dirty_idx = idx;
+  }
+}  // xd_input_buffer_invalidate()
 
 /**
- * @brief Constructor, runs before main to initialize the `xd-readline`
- * library.
+ * @brief Returns the flat position the cursor is at after displaying the
+ * input buffer between the passed indices, every logical line starts on a new
+ * row.
+ *
+ * @param start The index of the first character.
+ * @param end The index after the last character.
+ * @param pos The flat position the input is displayed from.
+ *
+ * @return The flat position after the input.
  */
-static void xd_readline_init() {
-  if (!isatty(STDIN_FILENO) || !isatty(STDOUT_FILENO)) {
-    return;
-  }
-
-  // register `SIGWINCH` singal handler
-  if (signal(SIGWINCH, xd_sigwinch_handler) == SIG_ERR) {
-    fprintf(stderr, "xd_readline: failed to set `SIGWINCH` handler: \n");
-    exit(EXIT_FAILURE);
+static size_t xd_input_buffer_advance(size_t start, size_t end, size_t pos) {
+  while (start < end) {
+    const char *newline =
+        memchr(xd_input_buffer + start, XD_RL_ASCII_LF, end - start);
+    size_t stop = newline == NULL ? end : (size_t)(newline - xd_input_buffer);
+    pos = xd_util_str_advance(xd_input_buffer + start, stop - start, pos,
+                              xd_tty_win_width);
+    if (newline == NULL) {
+      break;
+    }
+    pos = ((pos / xd_tty_win_width) + 1) * xd_tty_win_width;
+    start = stop + 1;
   }
+  return pos;
+}  // xd_input_buffer_advance()
 
-  // initialize the history
-  xd_readline_history_init();
-
-  // initialize input buffer
-  xd_input_buffer = (char *)malloc(sizeof(char) * xd_input_capacity);
-  if (xd_input_buffer == NULL) {
-    fprintf(stderr, "xd_readline: failed to allocate memory: %s\n",
-            strerror(errno));
-    exit(EXIT_FAILURE);
+/**
+ * @brief Returns the display column of the passed index of the input buffer,
+ * relative to where the input is displayed from.
+ *
+ * Whole chunks are looked up in the column index, so only the bytes between
+ * the start of the index's chunk and the index itself are decoded. The index
+ * is rebuilt when the input moves to another column or the terminal is
+ * resized, since that changes where rows end within the input.
+ *
+ * @param idx The index of a character in the input buffer.
+ *
+ * @return The number of columns the input before `idx` advances the cursor
+ * by.
+ */
+static size_t xd_input_buffer_column(size_t idx) {
+  size_t chunk = idx / XD_RL_COLUMN_CHUNK_SIZE;
+  size_t origin = xd_tty_input_origin % xd_tty_win_width;
+  if (origin != xd_input_column_origin ||
+      xd_tty_win_width != xd_input_column_win_width) {
+    xd_input_column_origin = origin;
+    xd_input_column_win_width = xd_tty_win_width;
+    xd_input_column_valid = 0;
   }
-  xd_input_length = 0;
-  xd_input_buffer[0] = XD_RL_ASCII_NUL;
 
-  // initialize search query buffer
-  xd_search_query_buffer =
-      (char *)malloc(sizeof(char) * XD_RL_SEARCH_QUERY_MAX);
-  if (xd_search_query_buffer == NULL) {
-    fprintf(stderr, "xd_readline: failed to allocate memory: %s\n",
-            strerror(errno));
-    exit(EXIT_FAILURE);
+  // bring the index up to date until the chunk
+  xd_input_column_prefix[0] = 0;
+  while (xd_input_column_valid < chunk) {
+    size_t start = xd_util_utf8_sync(
+        xd_input_buffer, xd_input_length,
+        xd_input_column_valid * XD_RL_COLUMN_CHUNK_SIZE);
+    size_t end = xd_util_utf8_sync(
+        xd_input_buffer, xd_input_length,
+        (xd_input_column_valid + 1) * XD_RL_COLUMN_CHUNK_SIZE);
+    size_t pos = origin + xd_input_column_prefix[xd_input_column_valid];
+    xd_input_column_prefix[xd_input_column_valid + 1] =
+        xd_input_buffer_advance(start, end, pos) - origin;
+    xd_input_column_valid++;
   }
-  xd_search_query_length = 0;
-  xd_search_query_buffer[0] = XD_RL_ASCII_NUL;
 
-  // get terminal window width
-  struct winsize wsz;
-  if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &wsz) == -1) {
-    fprintf(stderr, "xd_readline: failed to get tty window width\n");
-    exit(EXIT_FAILURE);
-  }
-  xd_tty_win_width = wsz.ws_col;
-}  // xd_readline_init()
+  size_t start = xd_util_utf8_sync(xd_input_buffer, xd_input_length,
+                                   chunk * XD_RL_COLUMN_CHUNK_SIZE);
+  return xd_input_buffer_advance(start, idx,
+                                 origin + xd_input_column_prefix[chunk]) -
+         origin;
+}  // xd_input_buffer_column()
 
 /**
- * @brief Destructor, runs before exit to cleanup after the `xd-readline`
- * library.
+ * @brief Returns the number of columns the input buffer between the passed
+ * indices advances the cursor by when displayed.
+ *
+ * @param start The index of the first character.
+ * @param end The index after the last character.
+ *
+ * @return The display width of the input from `start` up to `end`, including
+ * the columns left empty at the end of rows.
  */
-static void xd_readline_destroy() {
-  if (xd_input_buffer == NULL) {
-    return;
-  }
-  xd_readline_history_destroy();
-  free(xd_input_buffer);
-  free(xd_search_query_buffer);
-}  // xd_readline_destroy()
+static size_t xd_input_buffer_width(size_t start, size_t end) {
+  return xd_input_buffer_column(end) - xd_input_buffer_column(start);
+}  // xd_input_buffer_width()
 
 /**
- * @brief Initialize the history array by allocating all needed memory up-front
- * to reduce the allocation-deallocation overhead.
+ * @brief Grows the line index if needed so that it can take the passed number
+ * of entries.
+ *
+ * @param n The number of entries to make room for.
  *
- * @note This function must be called first thing inside the constructor
- * `xd_readline_init()` beacuse it calls `exit()` on failure.
+ * @return `0` on success or `-1` on allocation failure, or if the index would
+ * exceed the memory budget.
  */
-static void xd_readline_history_init() {
-  xd_history = (xd_history_entry_t **)malloc(sizeof(xd_history_entry_t *) *
-                                             (XD_RL_HISTORY_MAX + 1));
-  if (xd_history == NULL) {
-    fprintf(stderr, "xd_readline: failed to allocate memory: %s\n",
-            strerror(errno));
-    exit(EXIT_FAILURE);
+static int xd_input_lines_reserve(size_t n) {
+  if (n <= xd_input_lines_capacity) {
+    return 0;
+  }
+  size_t new_capacity = xd_input_lines_capacity == 0
+                            ? XD_RL_INPUT_LINES_MIN
+                            : xd_input_lines_capacity * 2;
+  if (new_capacity < n) {
+    new_capacity = n;
+  }
+  size_t old_size = sizeof(xd_input_line_t) * xd_input_lines_capacity;
+  size_t new_size = sizeof(xd_input_line_t) * new_capacity;
+  if (!xd_memory_fits(new_size - old_size)) {
+    return -1;
   }
+  XD_RL_ALLOC_EXPECTED_BEGIN();  // growth is amortized over the line
+  xd_input_line_t *ptr =
+      (xd_input_line_t *)xd_util_realloc(xd_input_lines, new_size);
+  XD_RL_ALLOC_EXPECTED_END();
+  if (ptr == NULL) {
+    return -1;
+  }
+  xd_memory_account(XD_RL_MEMORY_INPUT, old_size, new_size);
+  xd_input_lines = ptr;
+  xd_input_lines_capacity = new_capacity;
+  return 0;
+}  // xd_input_lines_reserve()
 
-  for (int i = 0; i <= XD_RL_HISTORY_MAX; i++) {
-    xd_history[i] = (xd_history_entry_t *)malloc(sizeof(xd_history_entry_t));
-    if (xd_history[i] == NULL) {
-      fprintf(stderr, "xd_readline: failed to allocate memory: %s\n",
-              strerror(errno));
-      exit(EXIT_FAILURE);
+/**
+ * @brief Brings the line index up to date until the passed index of the input
+ * buffer, by looking for the new-lines after the last one indexed.
+ *
+ * @param idx The index of the input buffer to index the new-lines before.
+ *
+ * @return `0` on success or `-1` if the line index couldn't grow, in which
+ * case the new-lines after the last one indexed are taken for characters.
+ */
+static int xd_input_lines_update(size_t idx) {
+  while (xd_input_lines_scanned < idx) {
+    const char *newline =
+        memchr(xd_input_buffer + xd_input_lines_scanned, XD_RL_ASCII_LF,
+               idx - xd_input_lines_scanned);
+    if (newline == NULL) {
+      xd_input_lines_scanned = idx;
+      break;
     }
-
-    xd_history[i]->capacity = LINE_MAX;
-    xd_history[i]->length = 0;
-    xd_history[i]->str = (char *)malloc(sizeof(char) * LINE_MAX);
-    if (xd_history[i]->str == NULL) {
-      free(xd_history[i]);
-      xd_history[i] = NULL;
-      fprintf(stderr, "xd_readline: failed to allocate memory: %s\n",
-              strerror(errno));
-      exit(EXIT_FAILURE);
+    if (xd_input_lines_reserve(xd_input_lines_count + 1) == -1) {
+      return -1;
     }
-    xd_history[i]->str[0] = XD_RL_ASCII_NUL;
+    // the row is set when the line is displayed
+    xd_input_lines[xd_input_lines_count++].start =
+        (size_t)(newline - xd_input_buffer) + 1;
+    xd_input_lines_scanned = xd_input_lines[xd_input_lines_count - 1].start;
   }
-}  // xd_readline_history_init()
+  return 0;
+}  // xd_input_lines_update()
 
 /**
- * @brief Frees the resources used for the history.
+ * @brief Finds the logical line of the input holding the passed index of the
+ * input buffer, by a binary search of the line index.
+ *
+ * @param idx The index of a character in the input buffer.
+ *
+ * @return The number of new-lines before `idx`.
  */
-static void xd_readline_history_destroy() {
-  for (int i = 0; i <= XD_RL_HISTORY_MAX; i++) {
-    if (xd_history[i] == NULL) {
-      break;
+static size_t xd_input_lines_find(size_t idx) {
+  xd_input_lines_update(idx);
+  size_t low = 0;
+  size_t high = xd_input_lines_count;
+  while (low < high) {
+    size_t mid = low + (high - low) / 2;
+    if (xd_input_lines[mid].start <= idx) {
+      low = mid + 1;
+    }
+    else {
+      high = mid;
     }
-    free(xd_history[i]->str);
-    free(xd_history[i]);
   }
-  free((void *)xd_history);
-}  // xd_readline_history_destroy()
+  return low;
+}  // xd_input_lines_find()
 
 /**
- * @brief Inserts the passed character into the input buffer at the cursor
- * position.
+ * @brief Returns the index of the first character of the passed logical line
+ * of the input.
  *
- * @param chr The character to be inserted.
+ * @param line The logical line, as returned by `xd_input_lines_find()`.
+ *
+ * @return The index of the line's start in the input buffer.
  */
-static void xd_input_buffer_insert(char chr) {
-  if (chr == XD_RL_ASCII_NUL) {
-    return;
-  }
-  // shift all the characters starting from the cursor by one to the right
-  for (int i = xd_input_length; i > xd_input_cursor; i--) {
-    xd_input_buffer[i] = xd_input_buffer[i - 1];
-  }
-  // insert the new character
-  xd_input_buffer[xd_input_cursor++] = chr;
-  xd_input_buffer[++xd_input_length] = XD_RL_ASCII_NUL;
-}  // xd_input_buffer_insert()
+static inline size_t xd_input_line_start(size_t line) {
+  return line == 0 ? 0 : xd_input_lines[line - 1].start;
+}  // xd_input_line_start()
 
 /**
- * @brief Inserts the characters of the passed string into the input buffer at
- * the cursor position.
+ * @brief Returns the index after the last character of the passed logical line
+ * of the input, which is its new-line or the end of the input.
  *
- * @param str The string to be inserted.
+ * @param line The logical line, as returned by `xd_input_lines_find()`.
+ *
+ * @return The index of the line's end in the input buffer.
  */
-static void xd_input_buffer_insert_string(const char *str) {
-  if (str == NULL || str[0] == XD_RL_ASCII_NUL) {
-    return;
-  }
-  for (int i = 0; str[i] != XD_RL_ASCII_NUL; i++) {
-    xd_input_buffer_insert(str[i]);
-  }
-}  // xd_input_buffer_insert_string()
+static size_t xd_input_line_end(size_t line) {
+  xd_input_lines_update(xd_input_length);
+  return line < xd_input_lines_count ? xd_input_lines[line].start - 1
+                                     : xd_input_length;
+}  // xd_input_line_end()
 
 /**
  * @brief Removes a number of characters before the cursor from the input
@@ -729,13 +3985,14 @@ static void xd_input_buffer_insert_string(const char *str) {
  *
  * @param n The number of characters to be removed
  */
-static void xd_input_buffer_remove_before_cursor(int n) {
+static void xd_input_buffer_remove_before_cursor(size_t n) {
   if (xd_input_cursor < n) {
     return;
   }
 
+  xd_input_buffer_invalidate(xd_input_cursor - n);
   // shift all characters starting from the cursor by n to the left
-  for (int i = xd_input_cursor; i < xd_input_length; i++) {
+  for (size_t i = xd_input_cursor; i < xd_input_length; i++) {
     xd_input_buffer[i - n] = xd_input_buffer[i];
   }
   xd_input_cursor -= n;
@@ -749,13 +4006,14 @@ static void xd_input_buffer_remove_before_cursor(int n) {
  *
  * @param n The number of characters to be removed
  */
-static void xd_input_buffer_remove_from_cursor(int n) {
+static void xd_input_buffer_remove_from_cursor(size_t n) {
   if (xd_input_length - xd_input_cursor < n) {
     return;
   }
 
+  xd_input_buffer_invalidate(xd_input_cursor);
   // shift the characters after the ones being removed by n to the left
-  for (int i = xd_input_cursor; i < xd_input_length - n; i++) {
+  for (size_t i = xd_input_cursor; i < xd_input_length - n; i++) {
     xd_input_buffer[i] = xd_input_buffer[i + n];
   }
   xd_input_length -= n;
@@ -768,17 +4026,11 @@ static void xd_input_buffer_remove_from_cursor(int n) {
  *
  * @return The index of the current word end.
  */
-static int xd_input_buffer_get_current_word_end() {
-  int idx = xd_input_cursor;
-  // skip all non-alphanumeric characters
-  while (idx < xd_input_length && !isalnum(xd_input_buffer[idx])) {
-    idx++;
-  }
-  // skip the word
-  while (idx < xd_input_length && isalnum(xd_input_buffer[idx])) {
-    idx++;
-  }
-  return idx;
+static size_t xd_input_buffer_get_current_word_end() {
+  // skip all non-word characters then the word
+  size_t idx = xd_util_word_scan_forward(xd_input_buffer, xd_input_cursor,
+                                      xd_input_length, 0);
+  return xd_util_word_scan_forward(xd_input_buffer, idx, xd_input_length, 1);
 }  // xd_input_buffer_get_current_word_end()
 
 /**
@@ -787,19 +4039,38 @@ static int xd_input_buffer_get_current_word_end() {
  *
  * @return The index of the current word start.
  */
-static int xd_input_buffer_get_current_word_start() {
-  int idx = xd_input_cursor;
-  // skip all non-alphanumeric characters
-  while (idx > 0 && !isalnum(xd_input_buffer[idx - 1])) {
-    idx--;
-  }
-  // skip the word
-  while (idx > 0 && isalnum(xd_input_buffer[idx - 1])) {
-    idx--;
-  }
-  return idx;
+static size_t xd_input_buffer_get_current_word_start() {
+  // skip all non-word characters then the word
+  size_t idx = xd_util_word_scan_backward(xd_input_buffer, xd_input_cursor, 0);
+  return xd_util_word_scan_backward(xd_input_buffer, idx, 1);
 }  // xd_input_buffer_get_current_word_start()
 
+/**
+ * @brief Moves the cursor to the passed logical line of the input, to the
+ * character at the display column the cursor is at on its line, or to the end
+ * of the line if it's shorter.
+ *
+ * @param line The logical line to move to.
+ */
+static void xd_input_buffer_move_to_line(size_t line) {
+  size_t col = xd_input_buffer_width(
+      xd_input_line_start(xd_input_lines_find(xd_input_cursor)),
+      xd_input_cursor);
+  size_t idx = xd_input_line_start(line);
+  size_t end = xd_input_line_end(line);
+  while (idx < end) {
+    size_t next = xd_util_utf8_next(xd_input_buffer, end, idx);
+    size_t width = xd_util_str_width(xd_input_buffer + idx, next - idx);
+    if (width > col) {
+      break;
+    }
+    col -= width;
+    idx = next;
+  }
+  xd_tty_cursor_move_input(xd_input_cursor, idx);
+  xd_input_cursor = idx;
+}  // xd_input_buffer_move_to_line()
+
 /**
  * @brief Saves the contents of the input buffer to the current navigation entry
  * in the history (at `xd_history_nav_idx`).
@@ -807,26 +4078,26 @@ static int xd_input_buffer_get_current_word_start() {
 static void xd_input_buffer_save_to_history() {
   xd_history_entry_t *history_entry = xd_history[xd_history_nav_idx];
 
-  // resize the history entry string if needed
-  if (xd_input_length > history_entry->capacity - 1) {
-    // resize to multiple of `LINE_MAX`
-    int new_capacity = xd_input_length + 1;
-    if (new_capacity % LINE_MAX != 0) {
-      new_capacity += LINE_MAX - (new_capacity % LINE_MAX);
-    }
+  uint32_t hash = xd_util_hash(xd_input_buffer, xd_input_length);
+  if (history_entry->hash == hash && history_entry->length == xd_input_length &&
+      memcmp(history_entry->str, xd_input_buffer, xd_input_length) == 0) {
+    return;  // unchanged, nothing to save
+  }
 
-    char *ptr =
-        (char *)realloc(history_entry->str, sizeof(char) * new_capacity);
-    if (ptr == NULL) {
-      return;  // allocation error, stop saving
-    }
-    history_entry->capacity = new_capacity;
-    history_entry->str = ptr;
+  if (xd_history_nav_idx == XD_RL_HISTORY_MAX) {
+    xd_history_scratch_set(xd_input_buffer, xd_input_length, hash);
+    return;
   }
 
-  memcpy(history_entry->str, xd_input_buffer, xd_input_length);
-  history_entry->str[xd_input_length] = XD_RL_ASCII_NUL;
-  history_entry->length = xd_input_length;
+  size_t old_length = history_entry->length;
+  XD_RL_ALLOC_EXPECTED_BEGIN();  // edits to history entries are kept
+  int ret = xd_history_entry_set(history_entry, xd_input_buffer,
+                                 xd_input_length, hash);
+  XD_RL_ALLOC_EXPECTED_END();
+  if (ret == -1) {
+    return;  // allocation error, stop saving
+  }
+  xd_history_bytes = xd_history_bytes - old_length + xd_input_length;
 }  // xd_input_buffer_save_to_history()
 
 /**
@@ -834,98 +4105,330 @@ static void xd_input_buffer_save_to_history() {
  * `xd_history_nav_idx`) to the input buffer.
  */
 static void xd_input_buffer_load_from_history() {
-  xd_history_entry_t *history_entry = xd_history[xd_history_nav_idx];
+  xd_input_buffer_load_entry(xd_history[xd_history_nav_idx]);
+}  // xd_input_buffer_load_from_history()
 
+/**
+ * @brief Replaces the contents of the input buffer with the string of the
+ * passed history entry and moves the cursor to the end.
+ *
+ * @param entry The history entry to be loaded.
+ */
+static void xd_input_buffer_load_entry(const xd_history_entry_t *entry) {
   // resize the input buffer if needed
-  if (history_entry->length > xd_input_capacity - 1) {
-    // resize to multiple of `LINE_MAX`
-    int new_capacity = history_entry->length + 1;
-    if (new_capacity % LINE_MAX != 0) {
-      new_capacity += LINE_MAX - (new_capacity % LINE_MAX);
+  if (entry->length > xd_input_length &&
+      xd_input_buffer_reserve(entry->length - xd_input_length) == -1) {
+    return;  // allocation error, stop loading
+  }
+
+  xd_input_buffer_invalidate(0);
+  xd_tty_lines_drawn = 0;  // the lines may all be different, redraw them
+  xd_input_length = entry->length;
+  xd_input_cursor = xd_input_length;
+  memcpy(xd_input_buffer, entry->str, xd_input_length);
+  xd_input_buffer[xd_input_length] = XD_RL_ASCII_NUL;
+}  // xd_input_buffer_load_entry()
+
+#if XD_RL_ENABLE_SUGGESTION
+/**
+ * @brief Loads the suggested next command into the input buffer if the input
+ * is empty and a suggestion is displayed.
+ *
+ * @return Non-zero if the suggestion was accepted or zero otherwise.
+ */
+static int xd_input_buffer_accept_suggestion() {
+  if (!xd_suggestion_visible || xd_input_length != 0) {
+    return 0;
+  }
+  xd_input_buffer_load_entry(xd_suggestion);
+  xd_readline_redraw = 1;
+  return 1;
+}  // xd_input_buffer_accept_suggestion()
+#endif
+
+/**
+ * @brief Changes the terminal input settings to raw.
+ *
+ * @return `0` on success or `-1` on failure with `errno` set, in which case
+ * the terminal settings are left unchanged.
+ */
+static int xd_tty_raw() {
+  // store original tty attributes
+  if (tcgetattr(STDIN_FILENO, &xd_original_tty_attributes) == -1) {
+    fprintf(stderr, "xd_readline: failed to get tty attributes\n");
+    return -1;
+  }
+
+  // set tty input to raw
+  struct termios xd_getline_tty_attributes = xd_original_tty_attributes;
+  xd_getline_tty_attributes.c_lflag &= ~(ICANON | ECHO);
+  xd_getline_tty_attributes.c_cc[VTIME] = 0;
+  xd_getline_tty_attributes.c_cc[VMIN] = 1;
+  while (tcsetattr(STDIN_FILENO, TCSANOW, &xd_getline_tty_attributes) == -1) {
+    if (errno == EINTR) {
+      continue;
     }
+    fprintf(stderr, "xd_readline: failed to set tty attributes\n");
+    return -1;
+  }
+  return 0;
+}  // xd_tty_raw()
 
-    char *ptr = (char *)realloc(xd_input_buffer, sizeof(char) * new_capacity);
-    if (ptr == NULL) {
-      return;  // allocation error, stop loading
+/**
+ * @brief Restore original terminal settings.
+ */
+static void xd_tty_restore() {
+  while (tcsetattr(STDIN_FILENO, TCSANOW, &xd_original_tty_attributes) == -1) {
+    if (errno == EINTR) {
+      continue;
+    }
+    fprintf(stderr, "xd_readline: failed to reset tty attributes\n");
+    return;
+  }
+}  // xd_tty_restore()
+
+/**
+ * @brief Writes queries to the terminal and reads its replies, up to the reply
+ * ending with the passed byte or until it doesn't reply in time. Any other
+ * input that arrives meanwhile, e.g. keys typed ahead, is kept to be read
+ * after the replies.
+ *
+ * @param query The queries to write at once.
+ * @param terminator The final byte of the reply to the last query.
+ * @param replies The buffer to store the replies in, null-terminated.
+ * @param size The size of the buffer.
+ *
+ * @return The length of the replies, `0` if none arrived in time.
+ */
+static size_t xd_tty_query(const char *query, char terminator, char *replies,
+                           size_t size) {
+  xd_tty_flush();
+  xd_tty_write_direct(query, strlen(query));
+
+  char typeahead[XD_RL_INPUT_PENDING_MAX];
+  size_t typeahead_length = 0;
+  char seq[XD_RL_SMALL_BUFFER_SIZE];
+  size_t seq_length = 0;
+  size_t replies_length = 0;
+  int done = 0;
+  char chr;
+  while (!done && xd_input_byte_ready(XD_RL_QUERY_TIMEOUT) &&
+         xd_input_read_byte(&chr) == 1) {
+    if (seq_length == 0 && chr != XD_RL_ASCII_ESC) {
+      if (typeahead_length < XD_RL_INPUT_PENDING_MAX) {
+        typeahead[typeahead_length++] = chr;
+      }
+      continue;
+    }
+    seq[seq_length++] = chr;
+    if (seq_length == 1) {
+      continue;
+    }
+    unsigned char byte = (unsigned char)chr;
+    int is_csi = seq[1] == '[';
+    if (is_csi && seq_length < XD_RL_SMALL_BUFFER_SIZE &&
+        (seq_length == 2 || byte < 0x40 || byte > 0x7E)) {
+      // the sequence isn't complete yet
+      continue;
+    }
+
+    // replies are CSI sequences: cursor position `row;colR`, mode report
+    // `?mode;value$y`, and keyboard flags `?flagsu`
+    int is_reply = is_csi && (chr == 'R' || chr == 'y' || chr == 'u') &&
+                   seq_length + 1 < size - replies_length;
+    if (is_reply) {
+      memcpy(replies + replies_length, seq, seq_length);
+      replies_length += seq_length;
+      done = chr == terminator;
+    }
+    else if (seq_length <= XD_RL_INPUT_PENDING_MAX - typeahead_length) {
+      memcpy(typeahead + typeahead_length, seq, seq_length);
+      typeahead_length += seq_length;
+    }
+    seq_length = 0;
+  }
+  if (seq_length <= XD_RL_INPUT_PENDING_MAX - typeahead_length) {
+    // a key sequence cut off by the timeout
+    memcpy(typeahead + typeahead_length, seq, seq_length);
+    typeahead_length += seq_length;
+  }
+  xd_input_pending_prepend(typeahead, typeahead_length);
+  replies[replies_length] = XD_RL_ASCII_NUL;
+  return replies_length;
+}  // xd_tty_query()
+
+/**
+ * @brief Gets the path of the terminal capabilities cache file.
+ *
+ * @param path The buffer to store the path in.
+ * @param size The size of the buffer.
+ *
+ * @return `0` on success, or `-1` if there's no cache directory.
+ */
+static int xd_tty_caps_cache_path(char *path, size_t size) {
+  const char *cache = getenv("XDG_CACHE_HOME");
+  const char *home = getenv("HOME");
+  int length;
+  if (cache != NULL && cache[0] == '/') {
+    length = snprintf(path, size, "%s/%s", cache, XD_RL_TERMINAL_CACHE_FILE);
+  }
+  else if (home != NULL && home[0] == '/') {
+    length =
+        snprintf(path, size, "%s/.cache/%s", home, XD_RL_TERMINAL_CACHE_FILE);
+  }
+  else {
+    return -1;
+  }
+  return length > 0 && (size_t)length < size ? 0 : -1;
+}  // xd_tty_caps_cache_path()
+
+/**
+ * @brief Builds the key of the current terminal in the capabilities cache,
+ * `$TERM` and `$TERM_PROGRAM` followed by tabs.
+ *
+ * @param key The buffer to store the key in.
+ * @param size The size of the buffer.
+ *
+ * @return The length of the key, or `0` if it doesn't fit.
+ */
+static size_t xd_tty_caps_cache_key(char *key, size_t size) {
+  const char *term = getenv("TERM");
+  const char *program = getenv("TERM_PROGRAM");
+  int length = snprintf(key, size, "%s\t%s\t", term == NULL ? "" : term,
+                        program == NULL ? "" : program);
+  if (length <= 0 || (size_t)length >= size ||
+      strchr(key, XD_RL_ASCII_LF) != NULL) {
+    return 0;
+  }
+  return (size_t)length;
+}  // xd_tty_caps_cache_key()
+
+/**
+ * @brief Looks the current terminal up in the capabilities cache.
+ *
+ * @return The cached capabilities, or `-1` if they aren't cached.
+ */
+static int xd_tty_caps_cache_load() {
+  char path[PATH_MAX];
+  char key[XD_RL_SMALL_BUFFER_SIZE * 4];
+  size_t key_length = xd_tty_caps_cache_key(key, sizeof(key));
+  if (!xd_readline_terminal_cache || key_length == 0 ||
+      xd_tty_caps_cache_path(path, sizeof(path)) == -1) {
+    return -1;
+  }
+  FILE *file = fopen(path, "r");
+  if (file == NULL) {
+    return -1;
+  }
+  int caps = -1;
+  char *line = NULL;
+  size_t capacity = 0;
+  while (caps == -1 && xd_util_read_line(file, &line, &capacity) != -1) {
+    if (strncmp(line, key, key_length) == 0) {
+      caps = (int)strtol(line + key_length, NULL, 10);
     }
-    xd_input_capacity = new_capacity;
-    xd_input_buffer = ptr;
   }
-
-  xd_input_length = history_entry->length;
-  xd_input_cursor = xd_input_length;
-  memcpy(xd_input_buffer, history_entry->str, xd_input_length);
-  xd_input_buffer[xd_input_length] = XD_RL_ASCII_NUL;
-}  // xd_input_buffer_load_from_history()
+  xd_util_free(line);
+  fclose(file);
+  return caps < 0 ? -1 : caps;
+}  // xd_tty_caps_cache_load()
 
 /**
- * @brief Changes the terminal input settings to raw.
+ * @brief Stores the capabilities of the current terminal in the cache, the
+ * file is replaced at once so concurrent processes never read half of it.
  */
-static void xd_tty_raw() {
-  // store original tty attributes
-  if (tcgetattr(STDIN_FILENO, &xd_original_tty_attributes) == -1) {
-    fprintf(stderr, "xd_readline: failed to get tty attributes\n");
-    exit(EXIT_FAILURE);
+static void xd_tty_caps_cache_save() {
+  char path[PATH_MAX];
+  char tmp_path[PATH_MAX];
+  char key[XD_RL_SMALL_BUFFER_SIZE * 4];
+  size_t key_length = xd_tty_caps_cache_key(key, sizeof(key));
+  if (!xd_readline_terminal_cache || key_length == 0 ||
+      xd_tty_caps_cache_path(path, sizeof(path)) == -1 ||
+      snprintf(tmp_path, sizeof(tmp_path), "%s.%ld", path, (long)getpid()) >=
+          (int)sizeof(tmp_path)) {
+    return;
   }
 
-  // set tty input to raw
-  struct termios xd_getline_tty_attributes;
-  if (tcgetattr(STDIN_FILENO, &xd_getline_tty_attributes) == -1) {
-    fprintf(stderr, "xd_readline: failed to get tty attributes\n");
-    exit(EXIT_FAILURE);
+  // create the cache directory and its parent if needed
+  char *slash = strrchr(path, '/');
+  *slash = XD_RL_ASCII_NUL;
+  char *parent_slash = strrchr(path, '/');
+  *parent_slash = XD_RL_ASCII_NUL;
+  mkdir(path, 0700);
+  *parent_slash = '/';
+  mkdir(path, 0700);
+  *slash = '/';
+
+  FILE *tmp_file = fopen(tmp_path, "w");
+  if (tmp_file == NULL) {
+    return;
   }
-  xd_getline_tty_attributes.c_lflag &= ~(ICANON | ECHO);
-  xd_getline_tty_attributes.c_cc[VTIME] = 0;
-  xd_getline_tty_attributes.c_cc[VMIN] = 1;
-  while (tcsetattr(STDIN_FILENO, TCSANOW, &xd_getline_tty_attributes) == -1) {
-    if (errno == EINTR) {
-      continue;
+  // keep the other terminals
+  FILE *file = fopen(path, "r");
+  if (file != NULL) {
+    char *line = NULL;
+    size_t capacity = 0;
+    while (xd_util_read_line(file, &line, &capacity) != -1) {
+      if (strncmp(line, key, key_length) != 0) {
+        fputs(line, tmp_file);
+      }
     }
-    fprintf(stderr, "xd_readline: failed to set tty attributes\n");
-    exit(EXIT_FAILURE);
+    xd_util_free(line);
+    fclose(file);
   }
-}  // xd_tty_raw()
-
-/**
- * @brief Restore original terminal settings.
- */
-static void xd_tty_restore() {
-  while (tcsetattr(STDIN_FILENO, TCSANOW, &xd_original_tty_attributes) == -1) {
-    if (errno == EINTR) {
-      continue;
-    }
-    fprintf(stderr, "xd_readline: failed to reset tty attributes\n");
-    exit(EXIT_FAILURE);
+  fprintf(tmp_file, "%s%d\n", key, xd_tty_caps);
+  if (fclose(tmp_file) != 0 || rename(tmp_path, path) == -1) {
+    unlink(tmp_path);
   }
-}  // xd_tty_restore()
+}  // xd_tty_caps_cache_save()
 
 /**
  * @brief Helper used to ensures the tty cursor is on a fresh new line first
  * thing after calling `xd_readline()`.
+ *
+ * The first call also asks what the terminal supports in the same write,
+ * unless it's cached, the cursor position reply ends the replies since every
+ * terminal sends it.
  */
 static void xd_tty_cursor_fix_initial_pos() {
-  xd_tty_write_ansii_sequence(XD_RL_ANSI_CRSR_REQ_POS);
-  tcdrain(STDOUT_FILENO);
+  int probe = 0;
+  if (xd_tty_caps == -1) {
+    xd_tty_caps = xd_tty_caps_cache_load();
+    probe = xd_tty_caps == -1;
+  }
 
-  char buf[XD_RL_SMALL_BUFFER_SIZE];
-  int idx = 0;
-  char chr = ' ';
-  while (idx < XD_RL_SMALL_BUFFER_SIZE - 1) {
-    ssize_t ret = read(STDIN_FILENO, &chr, 1);
-    if (ret <= 0) {
-      break;
+  char replies[4 * XD_RL_SMALL_BUFFER_SIZE];
+  size_t replies_length = xd_tty_query(
+      probe ? XD_RL_ANSI_SYNC_REQ XD_RL_ANSI_KITTY_REQ XD_RL_ANSI_CRSR_REQ_POS
+            : XD_RL_ANSI_CRSR_REQ_POS,
+      'R', replies, sizeof(replies));
+
+  if (probe) {
+    // the sync mode is supported if reported set (1) or reset (2), and the
+    // keyboard enhancement if its flags are reported
+    xd_tty_caps = 0;
+    const char *mode = strstr(replies, XD_RL_ANSI_SYNC_REPLY);
+    if (mode != NULL) {
+      mode += strlen(XD_RL_ANSI_SYNC_REPLY);
+      if ((mode[0] == '1' || mode[0] == '2') && mode[1] == '$') {
+        xd_tty_caps |= XD_RL_TTY_CAP_SYNC;
+      }
     }
-    buf[idx++] = chr;
-    if (chr == 'R') {
-      break;
+    if (strchr(replies, 'u') != NULL) {
+      xd_tty_caps |= XD_RL_TTY_CAP_KITTY_KEYS;
+    }
+    if (replies_length > 0 && replies[replies_length - 1] == 'R') {
+      // only complete answers are cached
+      xd_tty_caps_cache_save();
     }
   }
-  buf[idx] = '\0';
 
   int row = 1;
   int col = 1;
+  const char *position = strrchr(replies, XD_RL_ASCII_ESC);
 
-  if (sscanf(buf, "\033[%d;%dR", &row, &col) == 2 && col != 1) {
+  if (position != NULL &&
+      sscanf(position, "\033[%d;%dR", &row, &col) == 2 && col != 1) {
     // move to new line to preserve text on the same line
     xd_tty_write("\r\n", 2);
   }
@@ -945,18 +4448,17 @@ static inline void xd_tty_bell() {
  */
 static void xd_tty_input_clear() {
   // move to the end of the input
-  int cursor_flat_pos =
+  size_t cursor_flat_pos =
       ((xd_tty_cursor_row - 1) * xd_tty_win_width) + xd_tty_cursor_col - 1;
   xd_tty_cursor_move_right_wrap(xd_tty_chars_count - cursor_flat_pos);
 
   // clear all rows one by one bottom-up
-  int rows = (xd_tty_chars_count + xd_tty_win_width) / xd_tty_win_width;
-  for (int i = 0; i < rows; i++) {
+  size_t rows = (xd_tty_chars_count + xd_tty_win_width) / xd_tty_win_width;
+  for (size_t i = 0; i < rows; i++) {
     xd_tty_write_ansii_sequence(XD_RL_ANSI_LINE_CLR);
     xd_tty_cursor_col = 1;
     if (i < rows - 1) {
-      xd_tty_write_ansii_sequence(XD_RL_ANSI_CRSR_MV_UP, 1);
-      xd_tty_cursor_row--;
+      xd_tty_cursor_move_to(xd_tty_cursor_row - 1, 1, NULL, 0);
     }
   }
   xd_tty_chars_count = 0;
@@ -964,54 +4466,155 @@ static void xd_tty_input_clear() {
 
 /**
  * @brief Clears the prompt and the input then re-writes them and puts the
- * cursor in its proper position.
+ * cursor in its proper position, or only repaints the logical lines of the
+ * input affected by the edits since it was displayed when possible.
  */
 static void xd_tty_input_redraw() {
+  if (xd_tty_input_repaint()) {
+    return;
+  }
   xd_tty_input_clear();
+  xd_suggestion_visible = 0;
+  xd_tty_lines_drawn = 0;
   if (xd_readline_mode == XD_READLINE_NORMAL) {
     xd_tty_write_colored_track(xd_readline_prompt, xd_readline_prompt_length);
-    xd_tty_write_track(xd_input_buffer, xd_input_length);
+    xd_tty_input_origin =
+        ((xd_tty_cursor_row - 1) * xd_tty_win_width) + xd_tty_cursor_col - 1;
+    xd_tty_write_input(0, xd_input_length);
+    xd_tty_lines_drawn = xd_input_lines_count + 1;
+#if XD_RL_ENABLE_SUGGESTION
+    if (xd_input_length == 0 && xd_suggestion != NULL) {
+      // display the first line of the suggestion dimmed after the cursor
+      const char *newline =
+          memchr(xd_suggestion->str, XD_RL_ASCII_LF, xd_suggestion->length);
+      size_t length = newline == NULL
+                          ? xd_suggestion->length
+                          : (size_t)(newline - xd_suggestion->str);
+      size_t chars_count = xd_tty_chars_count;
+      xd_tty_sgr_set(XD_RL_ANSI_TEXT_DIM, strlen(XD_RL_ANSI_TEXT_DIM));
+      xd_tty_write_track(xd_suggestion->str, length);
+      xd_tty_sgr_set(XD_RL_ANSI_TEXT_RESET, strlen(XD_RL_ANSI_TEXT_RESET));
+      xd_tty_cursor_move_left_wrap(xd_tty_chars_count - chars_count);
+      xd_suggestion_visible = 1;
+    }
+#endif
   }
+#if XD_RL_ENABLE_SEARCH
   else {
     // search mode
-    xd_tty_write_track(xd_search_prompt, (int)strlen(xd_search_prompt));
+    xd_tty_write_track(xd_search_prompt, strlen(xd_search_prompt));
     xd_tty_write_track("'", 1);
     xd_tty_write_track(xd_search_query_buffer, xd_search_query_length);
     xd_tty_write_track("': ", 3);
+    xd_tty_input_origin =
+        ((xd_tty_cursor_row - 1) * xd_tty_win_width) + xd_tty_cursor_col - 1;
     if (xd_search_result_highlight_start != -1) {
-      char *input_hstart = xd_input_buffer + xd_search_result_highlight_start;
-      char *input_hend = xd_input_buffer + xd_search_result_highlight_start +
-                         xd_search_query_length;
-      int after_hlength = xd_input_length - xd_search_result_highlight_start -
-                          xd_search_query_length;
-      xd_tty_write_track(xd_input_buffer, xd_search_result_highlight_start);
-      xd_tty_write_ansii_sequence(XD_RL_ANSI_TEXT_HIGHLIGHT);
-      xd_tty_write_track(input_hstart, xd_search_query_length);
-      xd_tty_write_ansii_sequence(XD_RL_ANSI_TEXT_RESET);
-      xd_tty_write_track(input_hend, after_hlength);
+      size_t hstart = (size_t)xd_search_result_highlight_start;
+      size_t hend = hstart + xd_search_query_length;
+      xd_tty_write_input(0, hstart);
+      xd_tty_sgr_set(XD_RL_ANSI_TEXT_HIGHLIGHT,
+                     strlen(XD_RL_ANSI_TEXT_HIGHLIGHT));
+      xd_tty_write_input(hstart, hend);
+      xd_tty_sgr_set(XD_RL_ANSI_TEXT_RESET, strlen(XD_RL_ANSI_TEXT_RESET));
+      xd_tty_write_input(hend, xd_input_length);
     }
     else {
-      xd_tty_write_track(xd_input_buffer, xd_input_length);
+      xd_tty_write_input(0, xd_input_length);
     }
     if (strcmp(xd_search_prompt, XD_RL_REVERSE_SEARCH_PROMPT_FAILED) == 0) {
       xd_tty_bell();
     }
   }
-  xd_tty_cursor_move_left_wrap(xd_input_length - xd_input_cursor);
+#endif
+  // don't leave the terminal styled while waiting for input
+  xd_tty_sgr_sync();
+  xd_tty_cursor_move_input(xd_input_length, xd_input_cursor);
 }  // xd_tty_input_redraw()
 
+/**
+ * @brief Repaints the input from the first byte modified since it was
+ * displayed, leaving the prompt and the input before it untouched. Only the
+ * rest of its logical line is repainted if the line still takes the same rows,
+ * otherwise the lines after it are repainted too.
+ *
+ * @return Non-zero if the input was repainted, or zero if the prompt and the
+ * input must be redrawn whole.
+ */
+static int xd_tty_input_repaint() {
+  if (xd_tty_lines_drawn == 0 || xd_input_dirty_idx > xd_input_length ||
+      xd_input_length == 0 || xd_readline_mode != XD_READLINE_NORMAL ||
+      xd_suggestion_visible) {
+    return 0;
+  }
+
+  size_t start = xd_input_dirty_idx;
+  size_t line = xd_input_lines_find(start);
+  size_t end = xd_input_line_end(line);
+  size_t lines = xd_input_lines_count + 1;
+
+  // the input is displayed where it was up to the modified byte, since the
+  // input before it is unchanged
+  size_t flat_pos = xd_tty_input_flat_pos(start);
+  xd_tty_cursor_move_to((flat_pos / xd_tty_win_width) + 1,
+                        (flat_pos % xd_tty_win_width) + 1, NULL, 0);
+  if (lines == xd_tty_lines_drawn && end < xd_input_length &&
+      (xd_tty_input_flat_pos(end) / xd_tty_win_width) + 2 ==
+          xd_input_lines[line].row) {
+    // the next line is still displayed from the row after the line's end, so
+    // only the rows of the line are cleared
+    size_t chars_count = xd_tty_chars_count;
+    size_t row = xd_tty_cursor_row;
+    size_t last_row = xd_input_lines[line].row - 1;
+    xd_tty_write_ansii_sequence(XD_RL_ANSI_LINE_CLR_END);
+    while (xd_tty_cursor_row < last_row) {
+      xd_tty_cursor_move_to(xd_tty_cursor_row + 1, 1, NULL, 0);
+      xd_tty_write_ansii_sequence(XD_RL_ANSI_LINE_CLR_END);
+    }
+    if (xd_tty_cursor_row != row) {
+      xd_tty_cursor_move_to((flat_pos / xd_tty_win_width) + 1,
+                            (flat_pos % xd_tty_win_width) + 1, NULL, 0);
+    }
+    xd_tty_write_input(start, end);
+    xd_tty_chars_count = chars_count;
+  }
+  else {
+    xd_tty_write_ansii_sequence(XD_RL_ANSI_CLR_BELOW);
+    xd_tty_chars_count = flat_pos;
+    end = xd_input_length;
+    xd_tty_write_input(start, end);
+  }
+  xd_tty_cursor_move_input(end, xd_input_cursor);
+  xd_tty_lines_drawn = lines;
+  return 1;
+}  // xd_tty_input_repaint()
+
+/**
+ * @brief Gets the terminal window width, keeping the previous width (or
+ * `XD_RL_DEFAULT_WIN_WIDTH` if none) when the terminal doesn't report one.
+ */
+static void xd_tty_win_width_update() {
+  struct winsize wsz;
+  if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &wsz) == 0 && wsz.ws_col > 0) {
+    xd_tty_win_width = wsz.ws_col;
+  }
+  else if (xd_tty_win_width == 0) {
+    xd_tty_win_width = XD_RL_DEFAULT_WIN_WIDTH;
+  }
+}  // xd_tty_win_width_update()
+
 /**
  * @brief Handles terminal screen resize by getting the new window width and
  * calculating the new cursor position.
  */
 static void xd_tty_screen_resize() {
   struct winsize wsz;
-  if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &wsz) == 0) {
-    int cursor_flat_pos =
+  if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &wsz) == 0 && wsz.ws_col > 0) {
+    size_t cursor_flat_pos =
         ((xd_tty_cursor_row - 1) * xd_tty_win_width) + xd_tty_cursor_col - 1;
     xd_tty_win_width = wsz.ws_col;
     xd_tty_cursor_row = (cursor_flat_pos / xd_tty_win_width) + 1;
     xd_tty_cursor_col = (cursor_flat_pos % xd_tty_win_width) + 1;
+    xd_tty_lines_drawn = 0;
     xd_readline_redraw = 1;
   }
 }  // xd_tty_screen_resize()
@@ -1028,107 +4631,569 @@ static void xd_tty_write_ansii_sequence(const char *format, ...) {
   va_start(args, format);
   int length = vsnprintf(buffer, XD_RL_SMALL_BUFFER_SIZE, format, args);
   va_end(args);
-  write(STDOUT_FILENO, buffer, length);
+  xd_tty_write(buffer, (size_t)length);
 }  // xd_tty_write_ansii_sequence()
 
 /**
- * @brief Wrapper for `write()` used to write data to `stdout`.
+ * @brief Wrapper for `write()` used to write data to `stdout` right away,
+ * retrying until all of it is written since a single `write()` may be partial
+ * (Linux writes at most about 2 GB at once).
  *
  * @param data Pointer to the data to be written.
  * @param length The number of bytes to be written.
+ *
+ * @return The number of bytes written, less than `length` only on error.
  */
-static void xd_tty_write(const void *data, int length) {
-  if (length <= 0) {
-    return;
+static size_t xd_tty_write_direct(const void *data, size_t length) {
+  const char *bytes = data;
+  size_t written = 0;
+  while (written < length) {
+    ssize_t ret = write(STDOUT_FILENO, bytes + written, length - written);
+    if (ret == -1 && errno == EINTR) {
+      continue;
+    }
+    if (ret <= 0) {
+      break;
+    }
+    written += (size_t)ret;
+  }
+  return written;
+}  // xd_tty_write_direct()
+
+/**
+ * @brief Buffers data to be written to `stdout` with the rest of the output of
+ * the current keystroke, so the terminal gets a whole frame at once. The first
+ * write after a flush begins a synchronized update if the terminal supports
+ * them.
+ *
+ * @param data Pointer to the data to be written.
+ * @param length The number of bytes to be written.
+ *
+ * @return The number of bytes buffered or written, less than `length` only on
+ * error.
+ */
+static size_t xd_tty_write(const void *data, size_t length) {
+  if (length == 0) {
+    return 0;
+  }
+  if (xd_tty_output_length == 0 && !xd_tty_output_synced &&
+      xd_tty_caps != -1 && (xd_tty_caps & XD_RL_TTY_CAP_SYNC)) {
+    memcpy(xd_tty_output, XD_RL_ANSI_SYNC_BEGIN, strlen(XD_RL_ANSI_SYNC_BEGIN));
+    xd_tty_output_length = strlen(XD_RL_ANSI_SYNC_BEGIN);
+    xd_tty_output_synced = 1;
+  }
+  if (length > XD_RL_OUTPUT_BUFFER_SIZE - xd_tty_output_length) {
+    // the update stays open until the output is flushed
+    xd_tty_write_direct(xd_tty_output, xd_tty_output_length);
+    xd_tty_output_length = 0;
+    if (length > XD_RL_OUTPUT_BUFFER_SIZE) {
+      return xd_tty_write_direct(data, length);
+    }
   }
-  write(STDOUT_FILENO, data, length);
+  memcpy(xd_tty_output + xd_tty_output_length, data, length);
+  xd_tty_output_length += length;
+  return length;
 }  // xd_tty_write()
 
+/**
+ * @brief Writes the buffered output to `stdout`, ending the synchronized update
+ * if one was begun.
+ */
+static void xd_tty_flush() {
+  if (xd_tty_output_synced) {
+    if (strlen(XD_RL_ANSI_SYNC_END) >
+        XD_RL_OUTPUT_BUFFER_SIZE - xd_tty_output_length) {
+      xd_tty_write_direct(xd_tty_output, xd_tty_output_length);
+      xd_tty_output_length = 0;
+    }
+    memcpy(xd_tty_output + xd_tty_output_length, XD_RL_ANSI_SYNC_END,
+           strlen(XD_RL_ANSI_SYNC_END));
+    xd_tty_output_length += strlen(XD_RL_ANSI_SYNC_END);
+    xd_tty_output_synced = 0;
+  }
+  xd_tty_write_direct(xd_tty_output, xd_tty_output_length);
+  xd_tty_output_length = 0;
+}  // xd_tty_flush()
+
 /**
  * @brief Wrapper for `write()` used to write data to `stdout` while keeping
- * track of the number of chars written and the row and column positions of the
- * cursor and updating the cursor position manually.
+ * track of the number of columns written and the row and column positions of
+ * the cursor and updating the cursor position manually.
  *
- * @param data Pointer to the data to be written.
+ * @param data Pointer to the UTF-8 data to be written.
  * @param length The number of bytes to be written.
  */
-static void xd_tty_write_track(const void *data, int length) {
-  if (length <= 0) {
+static void xd_tty_write_track(const void *data, size_t length) {
+  xd_tty_sgr_sync();
+  size_t written = xd_tty_write(data, length);
+  if (written == 0) {
     return;
   }
-
-  int written = (int)write(STDOUT_FILENO, data, length);
-  if (written == -1) {
+  size_t start_flat_pos =
+      ((xd_tty_cursor_row - 1) * xd_tty_win_width) + xd_tty_cursor_col - 1;
+  size_t cursor_flat_pos = xd_util_str_advance(data, written, start_flat_pos,
+                                               xd_tty_win_width);
+  if (cursor_flat_pos == start_flat_pos) {
     return;
   }
-  xd_tty_chars_count += written;
+  xd_tty_chars_count += cursor_flat_pos - start_flat_pos;
 
-  // update cursor position
-  int cursor_flat_pos = ((xd_tty_cursor_row - 1) * xd_tty_win_width) +
-                        xd_tty_cursor_col + written - 1;
+  // update cursor position, the terminal agrees with it after early wraps
+  // of wide characters since they are counted in the flat position
   xd_tty_cursor_row = (cursor_flat_pos / xd_tty_win_width) + 1;
   xd_tty_cursor_col = (cursor_flat_pos % xd_tty_win_width) + 1;
   if (xd_tty_cursor_col == 1) {
-    // make the terminal wrap to new line
-    char chr = ' ';
-    xd_tty_write(&chr, 1);
+    // make the terminal wrap to new line then return to its first column
+    xd_tty_write(" \r", 2);
   }
-  xd_tty_write_ansii_sequence(XD_RL_ANSI_CRSR_SET_COL, xd_tty_cursor_col);
 }  // xd_tty_write_track()
 
 /**
  * @brief Writes the passed data to the terminal. It identifies and handles ANSI
- * color codes starting with `\033[` and ending with `m` and writes them
- * directly to the terminal without affecting the cursor tracking logic.
+ * color codes starting with `\033[` and ending with `m` and passes them to the
+ * text attributes tracker without affecting the cursor tracking logic.
  *
  * @param data Pointer to the data to be written.
  * @param length The number of bytes to be written.
  */
-static void xd_tty_write_colored_track(const void *data, int length) {
-  if (length <= 0) {
-    return;
-  }
+static void xd_tty_write_colored_track(const void *data, size_t length) {
   const char *str = data;
-  int str_idx = 0;
+  size_t str_idx = 0;
   while (str_idx < length) {
     if (str[str_idx] == '\033') {
-      int ansii_end_idx = str_idx;
+      size_t ansii_end_idx = str_idx;
       while (ansii_end_idx < length && str[ansii_end_idx] != 'm') {
         ansii_end_idx++;
       }
-      if (ansii_end_idx < length && str[ansii_end_idx] == 'm') {
-        // valid ANSI sequence, write without updating cursor
-        xd_tty_write(str + str_idx, ansii_end_idx - str_idx + 1);
-        str_idx = ansii_end_idx + 1;
+      if (ansii_end_idx == length) {
+        // unterminated sequence, write the rest without updating cursor
+        xd_tty_sgr_sync();
+        xd_tty_write(str + str_idx, length - str_idx);
+        break;
       }
+      // valid ANSI sequence, track it without updating cursor
+      xd_tty_sgr_set(str + str_idx, ansii_end_idx - str_idx + 1);
+      str_idx = ansii_end_idx + 1;
       continue;
     }
-    xd_tty_write_track(str + str_idx, 1);
-    str_idx++;
+    // write the text up to the next sequence at once to keep UTF-8 intact
+    const char *esc = memchr(str + str_idx, '\033', length - str_idx);
+    size_t text_end = esc == NULL ? length : (size_t)(esc - str);
+    xd_tty_write_track(str + str_idx, text_end - str_idx);
+    str_idx = text_end;
   }
 }  // xd_tty_write_colored_track()
 
+/**
+ * @brief Writes the input between the passed indices to the terminal, starting
+ * every logical line on a new row, and records the row each line starts on in
+ * the line index.
+ *
+ * @param start The index of the first character to write.
+ * @param end The index after the last character to write.
+ */
+static void xd_tty_write_input(size_t start, size_t end) {
+  size_t line = xd_input_lines_find(start);
+  while (start < end) {
+    const char *newline =
+        memchr(xd_input_buffer + start, XD_RL_ASCII_LF, end - start);
+    size_t stop = newline == NULL ? end : (size_t)(newline - xd_input_buffer);
+    xd_tty_write_track(xd_input_buffer + start, stop - start);
+    if (newline == NULL) {
+      break;
+    }
+    xd_tty_write("\r\n", 2);
+    xd_tty_cursor_row++;
+    xd_tty_cursor_col = 1;
+    xd_tty_chars_count = (xd_tty_cursor_row - 1) * xd_tty_win_width;
+    xd_input_lines_update(stop + 1);
+    if (line < xd_input_lines_count) {
+      xd_input_lines[line].row = xd_tty_cursor_row;
+    }
+    line++;
+    start = stop + 1;
+  }
+}  // xd_tty_write_input()
+
+/**
+ * @brief Applies the parameters of an SGR sequence to a text attribute state.
+ *
+ * @param params The parameters, between `\033[` and `m`.
+ * @param length The length of the parameters in bytes.
+ * @param state The state to apply the parameters to.
+ *
+ * @return `0` on success, or `-1` if a code isn't supported, in which case the
+ * supported codes before it are still applied.
+ */
+static int xd_tty_sgr_parse(const char *params, size_t length,
+                            xd_tty_sgr_t *state) {
+  if (memchr(params, ':', length) != NULL) {
+    // sub-parameters, e.g. curly underlines
+    return -1;
+  }
+
+  // split the parameters, an empty parameter is the same as `0`
+  unsigned long codes[XD_RL_SMALL_BUFFER_SIZE];
+  size_t count = 0;
+  const char *param = params;
+  const char *params_end = params + length;
+  while (param != NULL) {
+    if (count == XD_RL_SMALL_BUFFER_SIZE) {
+      return -1;
+    }
+    codes[count++] = param < params_end && *param != ';'
+                         ? strtoul(param, NULL, 10)
+                         : 0;
+    param = memchr(param, ';', (size_t)(params_end - param));
+    param = param == NULL ? NULL : param + 1;
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    unsigned long code = codes[i];
+    if (code == 0) {
+      memset(state, 0, sizeof(xd_tty_sgr_t));
+    }
+    else if (code <= 9 && code != 6) {
+      state->attrs |= 1u << code;
+    }
+    else if (code == 22) {
+      state->attrs &= ~(uint32_t)XD_RL_SGR_INTENSITY;
+    }
+    else if (code >= 23 && code <= 29 && code != 26) {
+      state->attrs &= ~(1u << (code - 20));
+    }
+    else if ((code >= 30 && code <= 37) || (code >= 90 && code <= 97)) {
+      // bright colors are the palette colors 8-15
+      state->fg = XD_RL_SGR_COLOR_INDEXED | (code < 90 ? code - 30 : code - 82);
+    }
+    else if ((code >= 40 && code <= 47) || (code >= 100 && code <= 107)) {
+      state->bg =
+          XD_RL_SGR_COLOR_INDEXED | (code < 100 ? code - 40 : code - 92);
+    }
+    else if (code == 39) {
+      state->fg = XD_RL_SGR_COLOR_DEFAULT;
+    }
+    else if (code == 49) {
+      state->bg = XD_RL_SGR_COLOR_DEFAULT;
+    }
+    else if ((code == 38 || code == 48) && i + 2 < count && codes[i + 1] == 5 &&
+             codes[i + 2] <= 255) {
+      // 256-color palette index
+      uint32_t *color = code == 38 ? &state->fg : &state->bg;
+      *color = XD_RL_SGR_COLOR_INDEXED | (uint32_t)codes[i + 2];
+      i += 2;
+    }
+    else if ((code == 38 || code == 48) && i + 4 < count && codes[i + 1] == 2 &&
+             codes[i + 2] <= 255 && codes[i + 3] <= 255 &&
+             codes[i + 4] <= 255) {
+      // 24-bit RGB color
+      uint32_t *color = code == 38 ? &state->fg : &state->bg;
+      *color = XD_RL_SGR_COLOR_RGB | (uint32_t)(codes[i + 2] << 16) |
+               (uint32_t)(codes[i + 3] << 8) | (uint32_t)codes[i + 4];
+      i += 4;
+    }
+    else {
+      return -1;
+    }
+  }
+  return 0;
+}  // xd_tty_sgr_parse()
+
+/**
+ * @brief Appends an SGR code to the parameters in the passed buffer.
+ *
+ * @param buffer The buffer of the parameters, `XD_RL_SGR_BUFFER_SIZE` bytes
+ * long.
+ * @param length The length of the parameters already in the buffer.
+ * @param code The code to append.
+ *
+ * @return The length of the parameters after appending the code.
+ */
+static size_t xd_tty_sgr_format_code(char *buffer, size_t length,
+                                     unsigned int code) {
+  int ret = snprintf(buffer + length, XD_RL_SGR_BUFFER_SIZE - length, "%s%u",
+                     length > 0 ? ";" : "", code);
+  return length + (size_t)ret;
+}  // xd_tty_sgr_format_code()
+
+/**
+ * @brief Appends the SGR codes of a color to the parameters in the passed
+ * buffer.
+ *
+ * @param buffer The buffer of the parameters, `XD_RL_SGR_BUFFER_SIZE` bytes
+ * long.
+ * @param length The length of the parameters already in the buffer.
+ * @param color The color, see `XD_RL_SGR_COLOR_*`.
+ * @param base `30` for a foreground color, or `40` for a background one.
+ *
+ * @return The length of the parameters after appending the color.
+ */
+static size_t xd_tty_sgr_format_color(char *buffer, size_t length,
+                                      uint32_t color, unsigned int base) {
+  unsigned int value = color & 0xFF;
+  if (color == XD_RL_SGR_COLOR_DEFAULT) {
+    return xd_tty_sgr_format_code(buffer, length, base + 9);
+  }
+  if (color & XD_RL_SGR_COLOR_RGB) {
+    length = xd_tty_sgr_format_code(buffer, length, base + 8);
+    length = xd_tty_sgr_format_code(buffer, length, 2);
+    length = xd_tty_sgr_format_code(buffer, length, (color >> 16) & 0xFF);
+    length = xd_tty_sgr_format_code(buffer, length, (color >> 8) & 0xFF);
+    return xd_tty_sgr_format_code(buffer, length, value);
+  }
+  if (value < 8) {
+    return xd_tty_sgr_format_code(buffer, length, base + value);
+  }
+  if (value < 16) {
+    // bright colors, 90-97 and 100-107
+    return xd_tty_sgr_format_code(buffer, length, base + 52 + value);
+  }
+  length = xd_tty_sgr_format_code(buffer, length, base + 8);
+  length = xd_tty_sgr_format_code(buffer, length, 5);
+  return xd_tty_sgr_format_code(buffer, length, value);
+}  // xd_tty_sgr_format_color()
+
+/**
+ * @brief Formats the SGR parameters switching the terminal from one text
+ * attribute state to another.
+ *
+ * @param buffer The buffer to write to, `XD_RL_SGR_BUFFER_SIZE` bytes long.
+ * @param from The state to switch from, or `NULL` to reset the attributes
+ * first.
+ * @param to The state to switch to.
+ *
+ * @return The length of the parameters in bytes.
+ */
+static size_t xd_tty_sgr_format(char *buffer, const xd_tty_sgr_t *from,
+                                const xd_tty_sgr_t *to) {
+  xd_tty_sgr_t reset = {0, XD_RL_SGR_COLOR_DEFAULT, XD_RL_SGR_COLOR_DEFAULT};
+  size_t length = 0;
+  if (from == NULL) {
+    // `\033[m` alone resets everything
+    from = &reset;
+    if (memcmp(to, &reset, sizeof(xd_tty_sgr_t)) != 0) {
+      length = xd_tty_sgr_format_code(buffer, length, 0);
+    }
+  }
+
+  uint32_t attrs = from->attrs;
+  uint32_t removed = attrs & ~to->attrs;
+  if (removed & XD_RL_SGR_INTENSITY) {
+    // turns off both bold and dim, the one that stays is turned on again
+    length = xd_tty_sgr_format_code(buffer, length, 22);
+    attrs &= ~(uint32_t)XD_RL_SGR_INTENSITY;
+  }
+  for (unsigned int code = 3; code <= 9; code++) {
+    if (removed & (1u << code)) {
+      length = xd_tty_sgr_format_code(buffer, length, 20 + code);
+    }
+  }
+  uint32_t added = to->attrs & ~attrs;
+  for (unsigned int code = 1; code <= 9; code++) {
+    if (added & (1u << code)) {
+      length = xd_tty_sgr_format_code(buffer, length, code);
+    }
+  }
+
+  if (to->fg != from->fg) {
+    length = xd_tty_sgr_format_color(buffer, length, to->fg, 30);
+  }
+  if (to->bg != from->bg) {
+    length = xd_tty_sgr_format_color(buffer, length, to->bg, 40);
+  }
+  return length;
+}  // xd_tty_sgr_format()
+
+/**
+ * @brief Handles an ANSI sequence written with the prompt or the styled input,
+ * SGR sequences are tracked to be switched to when text is written next, other
+ * sequences are written as is.
+ *
+ * @param seq The sequence, starting with `\033` and ending with `m`.
+ * @param length The length of the sequence in bytes.
+ */
+static void xd_tty_sgr_set(const char *seq, size_t length) {
+  const char *params = seq + 2;
+  size_t params_length = length - 3;
+  if (length < 3 || seq[1] != '[' ||
+      strspn(params, "0123456789;:") < params_length) {
+    xd_tty_sgr_sync();
+    xd_tty_write(seq, length);
+    return;
+  }
+
+  xd_tty_sgr_t state = xd_tty_sgr_wanted;
+  int supported = xd_tty_sgr_parse(params, params_length, &state) == 0;
+  if (supported && !xd_tty_sgr_verbatim) {
+    xd_tty_sgr_wanted = state;
+    return;
+  }
+
+  xd_tty_sgr_sync();
+  xd_tty_write(seq, length);
+  xd_tty_sgr_wanted = state;
+  xd_tty_sgr_current = state;
+  // tracked exactly again once every attribute is reset
+  int resets = params_length == 0 || params[0] == ';' ||
+               (params[0] == '0' && (params_length == 1 || params[1] == ';'));
+  xd_tty_sgr_verbatim = !supported || !resets;
+}  // xd_tty_sgr_set()
+
+/**
+ * @brief Switches the terminal to the wanted text attributes with the shortest
+ * of the transition from the current attributes or a reset followed by the
+ * wanted attributes.
+ */
+static void xd_tty_sgr_sync() {
+  if (memcmp(&xd_tty_sgr_current, &xd_tty_sgr_wanted, sizeof(xd_tty_sgr_t)) ==
+      0) {
+    return;
+  }
+  char seq[2][XD_RL_SGR_BUFFER_SIZE + 3];
+  size_t lengths[2];
+  lengths[0] =
+      xd_tty_sgr_format(seq[0] + 2, &xd_tty_sgr_current, &xd_tty_sgr_wanted);
+  lengths[1] = xd_tty_sgr_format(seq[1] + 2, NULL, &xd_tty_sgr_wanted);
+  int shortest = lengths[1] < lengths[0];
+  char *shortest_seq = seq[shortest];
+  size_t shortest_length = lengths[shortest];
+  shortest_seq[0] = XD_RL_ASCII_ESC;
+  shortest_seq[1] = '[';
+  shortest_seq[shortest_length + 2] = 'm';
+  xd_tty_write(shortest_seq, shortest_length + 3);
+  xd_tty_sgr_current = xd_tty_sgr_wanted;
+}  // xd_tty_sgr_sync()
+
+/**
+ * @brief Gets the length of a CSI sequence with the numeric parameter `n`,
+ * which is omitted when it's 1 since that's the default.
+ *
+ * @param n The numeric parameter of the sequence.
+ *
+ * @return The length of the sequence in bytes.
+ */
+static inline size_t xd_tty_csi_length(size_t n) {
+  size_t length = 3;  // `ESC`, `[` and the final byte
+  for (; n > 1; n /= 10) {
+    length++;
+  }
+  return length;
+}  // xd_tty_csi_length()
+
+/**
+ * @brief Formats a CSI sequence with the numeric parameter `n` into the passed
+ * buffer, omitting the parameter when it's 1 since that's the default.
+ *
+ * @param buffer The buffer to write to, at least `XD_RL_SMALL_BUFFER_SIZE`
+ * bytes long.
+ * @param n The numeric parameter of the sequence.
+ * @param final The final byte of the sequence.
+ *
+ * @return The length of the sequence in bytes.
+ */
+static size_t xd_tty_csi_format(char *buffer, size_t n, char final) {
+  if (n == 1) {
+    buffer[0] = XD_RL_ASCII_ESC;
+    buffer[1] = '[';
+    buffer[2] = final;
+    return 3;
+  }
+  return (size_t)snprintf(buffer, XD_RL_SMALL_BUFFER_SIZE, XD_RL_ANSI_CSI_PARAM,
+                          n, final);
+}  // xd_tty_csi_format()
+
+/**
+ * @brief Moves the terminal cursor to the passed position using the shortest
+ * byte sequence that gets there.
+ *
+ * The row is changed with a relative move, then the column with whichever is
+ * the shortest of `CR`, backspaces, a relative move, an absolute column, or
+ * reprinting the characters between the cursor and the target if they're
+ * known.
+ *
+ * @param row The target row (1-based) relative to the beginning of the prompt.
+ * @param col The target column (1-based).
+ * @param text The characters displayed from the cursor to the target on the
+ * same row, or `NULL` if they aren't known.
+ * @param length The length of `text` in bytes.
+ */
+static void xd_tty_cursor_move_to(size_t row, size_t col, const char *text,
+                                  size_t length) {
+  char seq[2 * XD_RL_SMALL_BUFFER_SIZE];
+  size_t seq_length = 0;
+
+  if (row < xd_tty_cursor_row) {
+    seq_length += xd_tty_csi_format(seq, xd_tty_cursor_row - row,
+                                    XD_RL_CSI_CRSR_UP);
+    text = NULL;
+  }
+  else if (row > xd_tty_cursor_row) {
+    seq_length += xd_tty_csi_format(seq, row - xd_tty_cursor_row,
+                                    XD_RL_CSI_CRSR_DOWN);
+    text = NULL;
+  }
+
+  char *hseq = seq + seq_length;
+  size_t abs_length = col == 1 ? 1 : xd_tty_csi_length(col);
+  if (col < xd_tty_cursor_col) {
+    size_t n = xd_tty_cursor_col - col;
+    size_t rel_length = xd_tty_csi_length(n);
+    if (n <= abs_length && n <= rel_length) {
+      memset(hseq, XD_RL_ASCII_BS, n);
+      seq_length += n;
+    }
+    else if (col == 1) {
+      *hseq = XD_RL_ASCII_CR;
+      seq_length++;
+    }
+    else if (abs_length <= rel_length) {
+      seq_length += xd_tty_csi_format(hseq, col, XD_RL_CSI_CRSR_COL);
+    }
+    else {
+      seq_length += xd_tty_csi_format(hseq, n, XD_RL_CSI_CRSR_LEFT);
+    }
+  }
+  else if (col > xd_tty_cursor_col) {
+    size_t n = col - xd_tty_cursor_col;
+    size_t rel_length = xd_tty_csi_length(n);
+    int reprint = text != NULL && length < abs_length && length < rel_length;
+    for (size_t i = 0; reprint && i < length; i++) {
+      unsigned char byte = (unsigned char)text[i];
+      reprint = byte >= ' ' && byte != XD_RL_ASCII_DEL;
+    }
+    if (reprint) {
+      memcpy(hseq, text, length);
+      seq_length += length;
+    }
+    else if (abs_length < rel_length) {
+      seq_length += xd_tty_csi_format(hseq, col, XD_RL_CSI_CRSR_COL);
+    }
+    else {
+      seq_length += xd_tty_csi_format(hseq, n, XD_RL_CSI_CRSR_RIGHT);
+    }
+  }
+
+  if (seq_length > 0) {
+    xd_tty_write(seq, seq_length);
+  }
+  xd_tty_cursor_row = row;
+  xd_tty_cursor_col = col;
+}  // xd_tty_cursor_move_to()
+
 /**
  * @brief Moves the terminal cursor left by a specified number of columns,
  * wrapping across rows as needed.
  *
  * @param n The number of columns to move the cursor to the left.
  */
-static inline void xd_tty_cursor_move_left_wrap(int n) {
+static inline void xd_tty_cursor_move_left_wrap(size_t n) {
   if (n == 0) {
     return;
   }
-  int cursor_flat_pos =
+  size_t cursor_flat_pos =
       ((xd_tty_cursor_row - 1) * xd_tty_win_width) + xd_tty_cursor_col - n - 1;
-  int new_cursor_row = (cursor_flat_pos / xd_tty_win_width) + 1;
-  int new_cursor_col = (cursor_flat_pos % xd_tty_win_width) + 1;
-  if (new_cursor_row != xd_tty_cursor_row) {
-    xd_tty_write_ansii_sequence(XD_RL_ANSI_CRSR_MV_UP,
-                                xd_tty_cursor_row - new_cursor_row);
-    xd_tty_cursor_row = new_cursor_row;
-  }
-  xd_tty_write_ansii_sequence(XD_RL_ANSI_CRSR_SET_COL, new_cursor_col);
-  xd_tty_cursor_col = new_cursor_col;
+  xd_tty_cursor_move_to((cursor_flat_pos / xd_tty_win_width) + 1,
+                        (cursor_flat_pos % xd_tty_win_width) + 1, NULL, 0);
 }  // xd_tty_cursor_move_left_wrap()
 
 /**
@@ -1137,61 +5202,174 @@ static inline void xd_tty_cursor_move_left_wrap(int n) {
  *
  * @param n The number of columns to move the cursor to the right.
  */
-static inline void xd_tty_cursor_move_right_wrap(int n) {
+static inline void xd_tty_cursor_move_right_wrap(size_t n) {
   if (n == 0) {
     return;
   }
-  int cursor_flat_pos =
+  size_t cursor_flat_pos =
       ((xd_tty_cursor_row - 1) * xd_tty_win_width) + xd_tty_cursor_col + n - 1;
-  int new_cursor_row = (cursor_flat_pos / xd_tty_win_width) + 1;
-  int new_cursor_col = (cursor_flat_pos % xd_tty_win_width) + 1;
-  if (new_cursor_row != xd_tty_cursor_row) {
-    xd_tty_write_ansii_sequence(XD_RL_ANSI_CRSR_MV_DN,
-                                new_cursor_row - xd_tty_cursor_row);
-    xd_tty_cursor_row = new_cursor_row;
-  }
-  xd_tty_write_ansii_sequence(XD_RL_ANSI_CRSR_SET_COL, new_cursor_col);
-  xd_tty_cursor_col = new_cursor_col;
+  xd_tty_cursor_move_to((cursor_flat_pos / xd_tty_win_width) + 1,
+                        (cursor_flat_pos % xd_tty_win_width) + 1, NULL, 0);
 }  // xd_tty_cursor_move_right_wrap()
 
+/**
+ * @brief Moves the terminal cursor over the input from one index of the input
+ * buffer to another, letting the planner reprint the characters in between
+ * when moving right over the input displayed as is.
+ *
+ * @param from The index in the input buffer the cursor is at.
+ * @param to The index in the input buffer to move to.
+ */
+static void xd_tty_cursor_move_input(size_t from, size_t to) {
+  size_t cursor_flat_pos = xd_tty_input_cursor_pos(to);
+  int displayed =
+      xd_readline_mode == XD_READLINE_NORMAL && !xd_readline_redraw;
+  xd_tty_cursor_move_to((cursor_flat_pos / xd_tty_win_width) + 1,
+                        (cursor_flat_pos % xd_tty_win_width) + 1,
+                        displayed && to > from ? xd_input_buffer + from : NULL,
+                        to - from);
+}  // xd_tty_cursor_move_input()
+
+/**
+ * @brief Returns the display position of the passed index of the input buffer.
+ *
+ * @param idx The index of a character in the input buffer.
+ *
+ * @return The flat position (`(row - 1) * xd_tty_win_width + col - 1`) of the
+ * character.
+ */
+static size_t xd_tty_input_flat_pos(size_t idx) {
+  return xd_tty_input_origin + xd_input_buffer_column(idx);
+}  // xd_tty_input_flat_pos()
+
+/**
+ * @brief Returns the display position of the cursor when it's at the passed
+ * index of the input buffer, which is on the character at the index.
+ *
+ * A double-width character that didn't fit at the end of a row is displayed
+ * on the next row, so the cursor goes there rather than to the empty column
+ * left before it.
+ *
+ * @param idx The index of a character in the input buffer.
+ *
+ * @return The flat position (`(row - 1) * xd_tty_win_width + col - 1`) of the
+ * cursor.
+ */
+static size_t xd_tty_input_cursor_pos(size_t idx) {
+  size_t flat_pos = xd_tty_input_flat_pos(idx);
+  if (idx < xd_input_length &&
+      flat_pos % xd_tty_win_width == xd_tty_win_width - 1) {
+    size_t next = xd_util_utf8_next(xd_input_buffer, xd_input_length, idx);
+    if (xd_util_str_advance(xd_input_buffer + idx, next - idx, flat_pos,
+                            xd_tty_win_width) > flat_pos + 2) {
+      flat_pos++;
+    }
+  }
+  return flat_pos;
+}  // xd_tty_input_cursor_pos()
+
 /**
  * @brief Handles the case where the input is a printable character.
  *
  * Adds the character to the input at the cursor position, or if in history
  * search mode, adds it to the end of the search query.
  *
- * @param chr the input character.
+ * @param str The UTF-8 encoded input character.
+ * @param length The length of the input character in bytes.
  */
-static void xd_input_handle_printable(char chr) {
+static void xd_input_handle_printable(const char *str, size_t length) {
   if (xd_readline_mode == XD_READLINE_NORMAL) {
-    xd_input_buffer_insert(chr);
-    if (xd_input_cursor == xd_input_length) {
-      xd_tty_write_track(&chr, 1);
+    if (xd_input_length + length + 2 > xd_input_capacity) {
+      // the input buffer couldn't grow, e.g. over the memory budget
+      xd_tty_bell();
+      return;
+    }
+    for (size_t i = 0; i < length; i++) {
+      xd_input_buffer_insert(str[i]);
+    }
+    if (xd_input_cursor == xd_input_length && !xd_suggestion_visible) {
+      xd_tty_write_track(str, length);
       // don't redraw when adding to the end
       return;
     }
-    xd_readline_redraw = 1;
+    xd_readline_redraw = 1;
+  }
+#if XD_RL_ENABLE_SEARCH
+  else if (xd_search_query_length < XD_RL_SEARCH_QUERY_MAX - length) {
+    // search mode
+    memcpy(xd_search_query_buffer + xd_search_query_length, str, length);
+    xd_search_query_length += length;
+    xd_search_query_buffer[xd_search_query_length] = XD_RL_ASCII_NUL;
+    xd_search_idx = xd_history_nav_idx;  // reset search index
+    xd_readline_redraw = 1;
+  }
+#endif
+}  // xd_input_handle_printable()
+
+/**
+ * @brief Handles the case where the input is a non-ASCII byte.
+ *
+ * Reads the rest of the UTF-8 sequence started by the passed lead byte and
+ * handles it as a printable character. Invalid sequences and C1 control
+ * characters are dropped, and a byte that interrupts a sequence is handled on
+ * its own.
+ *
+ * @param lead The lead byte of the UTF-8 sequence.
+ */
+static void xd_input_handle_utf8(char lead) {
+  unsigned char byte = (unsigned char)lead;
+  size_t seq_length = 0;
+  if (byte >= 0xC2 && byte <= 0xDF) {
+    seq_length = 2;
+  }
+  else if (byte >= 0xE0 && byte <= 0xEF) {
+    seq_length = 3;
+  }
+  else if (byte >= 0xF0 && byte <= 0xF4) {
+    seq_length = 4;
+  }
+  else {
+    return;  // continuation or invalid lead byte
+  }
+
+  char buffer[XD_RL_UTF8_SEQ_MAX];
+  buffer[0] = lead;
+  for (size_t idx = 1; idx < seq_length; idx++) {
+    char chr;
+    if (xd_input_read_byte(&chr) != 1) {
+      xd_tty_cursor_move_input(xd_input_cursor, xd_input_length);
+      xd_readline_finished = 1;
+      xd_readline_return = NULL;
+      return;
+    }
+    if (((unsigned char)chr & 0xC0) != 0x80) {
+      // truncated sequence, drop it and handle the new character
+      xd_input_handler(chr);
+      return;
+    }
+    buffer[idx] = chr;
   }
-  else if (xd_search_query_length < XD_RL_SEARCH_QUERY_MAX - 1) {
-    // search mode
-    xd_search_query_buffer[xd_search_query_length++] = chr;
-    xd_search_query_buffer[xd_search_query_length] = XD_RL_ASCII_NUL;
-    xd_search_idx = xd_history_nav_idx;  // reset search index
-    xd_readline_redraw = 1;
+
+  uint32_t codepoint;
+  if (xd_util_utf8_decode(buffer, seq_length, &codepoint) != seq_length ||
+      codepoint < 0xA0) {
+    return;  // invalid sequence or C1 control character
   }
-}  // xd_input_handle_printable()
+  xd_input_handle_printable(buffer, seq_length);
+}  // xd_input_handle_utf8()
 
 /**
  * @brief Handles the case where the input is `Ctrl+A`.
  *
- * Moves the cursor to the beginning of the input.
+ * Moves the cursor to the beginning of the line.
  */
 static void xd_input_handle_ctrl_a() {
-  if (xd_input_cursor == 0) {
+  size_t idx = xd_input_line_start(xd_input_lines_find(xd_input_cursor));
+  if (xd_input_cursor == idx) {
     return;
   }
-  xd_tty_cursor_move_left_wrap(xd_input_cursor);
-  xd_input_cursor = 0;
+  xd_tty_cursor_move_input(xd_input_cursor, idx);
+  xd_input_cursor = idx;
 }  // xd_input_handle_ctrl_a()
 
 /**
@@ -1204,8 +5382,9 @@ static void xd_input_handle_ctrl_b() {
     xd_tty_bell();
     return;
   }
-  xd_tty_cursor_move_left_wrap(1);
-  xd_input_cursor--;
+  size_t idx = xd_util_utf8_prev(xd_input_buffer, xd_input_cursor);
+  xd_tty_cursor_move_input(xd_input_cursor, idx);
+  xd_input_cursor = idx;
 }  // xd_input_handle_ctrl_b()
 
 /**
@@ -1226,28 +5405,43 @@ static void xd_input_handle_ctrl_d() {
 /**
  * @brief Handles the case where the input is `Ctrl+E`.
  *
- * Moves the cursor to the end of the input.
+ * Moves the cursor to the end of the line, or accepts the suggested next
+ * command if the input is empty.
  */
 static void xd_input_handle_ctrl_e() {
-  if (xd_input_cursor == xd_input_length) {
+#if XD_RL_ENABLE_SUGGESTION
+  if (xd_input_buffer_accept_suggestion()) {
     return;
   }
-  xd_tty_cursor_move_right_wrap(xd_input_length - xd_input_cursor);
-  xd_input_cursor = xd_input_length;
+#endif
+  size_t idx = xd_input_line_end(xd_input_lines_find(xd_input_cursor));
+  if (xd_input_cursor == idx) {
+    return;
+  }
+  xd_tty_cursor_move_input(xd_input_cursor, idx);
+  xd_input_cursor = idx;
 }  // xd_input_handle_ctrl_e()
 
 /**
  * @brief Handles the case where the input is `Ctrl+F`.
  *
- * Moves the cursor forward by one character.
+ * Moves the cursor forward by one character, or accepts the suggested next
+ * command if the input is empty.
  */
 static void xd_input_handle_ctrl_f() {
+#if XD_RL_ENABLE_SUGGESTION
+  if (xd_input_buffer_accept_suggestion()) {
+    return;
+  }
+#endif
   if (xd_input_cursor == xd_input_length) {
     xd_tty_bell();
     return;
   }
-  xd_tty_cursor_move_right_wrap(1);
-  xd_input_cursor++;
+  size_t idx =
+      xd_util_utf8_next(xd_input_buffer, xd_input_length, xd_input_cursor);
+  xd_tty_cursor_move_input(xd_input_cursor, idx);
+  xd_input_cursor = idx;
 }  // xd_input_handle_ctrl_f()
 
 /**
@@ -1271,27 +5465,37 @@ static void xd_input_handle_ctrl_h() {
       xd_tty_bell();
       return;
     }
-    xd_input_buffer_remove_before_cursor(1);
+    xd_input_buffer_remove_before_cursor(
+        xd_input_cursor - xd_util_utf8_prev(xd_input_buffer, xd_input_cursor));
   }
+#if XD_RL_ENABLE_SEARCH
   else if (xd_search_query_length > 0) {
     // search mode
-    xd_search_query_buffer[--xd_search_query_length] = XD_RL_ASCII_NUL;
+    xd_search_query_length =
+        xd_util_utf8_prev(xd_search_query_buffer, xd_search_query_length);
+    xd_search_query_buffer[xd_search_query_length] = XD_RL_ASCII_NUL;
     xd_search_idx = xd_history_nav_idx;  // reset search index
   }
+#endif
   xd_readline_redraw = 1;
 }  // xd_input_handle_ctrl_h()
 
 /**
  * @brief Handles the case where the input is `Ctrl+K`.
  *
- * Removes all characters from the cursor to the end of input.
+ * Removes all characters from the cursor to the end of the line, or the
+ * new-line joining the next line if the cursor is at the end of the line.
  */
 static void xd_input_handle_ctrl_k() {
   if (xd_input_cursor == xd_input_length) {
     xd_tty_bell();
     return;
   }
-  xd_input_buffer_remove_from_cursor(xd_input_length - xd_input_cursor);
+  size_t idx = xd_input_line_end(xd_input_lines_find(xd_input_cursor));
+  if (idx == xd_input_cursor) {
+    idx++;
+  }
+  xd_input_buffer_remove_from_cursor(idx - xd_input_cursor);
   xd_readline_redraw = 1;
 }  // xd_input_handle_ctrl_k()
 
@@ -1305,9 +5509,11 @@ static void xd_input_handle_ctrl_l() {
   xd_tty_write_ansii_sequence(XD_RL_ANSI_CRSR_MV_HOME);
   xd_tty_cursor_row = 1;
   xd_tty_cursor_col = 1;
+  xd_tty_lines_drawn = 0;
   xd_readline_redraw = 1;
 }  // xd_input_handle_ctrl_l()
 
+#if XD_RL_ENABLE_SEARCH
 /**
  * @brief Handles the case where the input is `Ctrl+R`.
  *
@@ -1346,7 +5552,9 @@ static void xd_input_handle_ctrl_r() {
   xd_readline_mode = XD_READLINE_REVERSE_SEARCH;
   xd_readline_redraw = 1;
 }  // xd_input_handle_ctrl_r()
+#endif
 
+#if XD_RL_ENABLE_SEARCH
 /**
  * @brief Handles the case where the input is `Ctrl+S`.
  *
@@ -1384,21 +5592,24 @@ static void xd_input_handle_ctrl_s() {
   xd_readline_mode = XD_READLINE_FORWARD_SEARCH;
   xd_readline_redraw = 1;
 }  // xd_input_handle_ctrl_s()
+#endif
 
 /**
  * @brief Handles the case where the input is `Ctrl+L`.
  *
- * Removes all characters from the beginning of input to before the cursor.
+ * Removes all characters from the beginning of the line to before the cursor.
  */
 static void xd_input_handle_ctrl_u() {
-  if (xd_input_cursor == 0) {
+  size_t idx = xd_input_line_start(xd_input_lines_find(xd_input_cursor));
+  if (xd_input_cursor == idx) {
     xd_tty_bell();
     return;
   }
-  xd_input_buffer_remove_before_cursor(xd_input_cursor);
+  xd_input_buffer_remove_before_cursor(xd_input_cursor - idx);
   xd_readline_redraw = 1;
 }  // xd_input_handle_ctrl_u()
 
+#if XD_RL_ENABLE_COMPLETION
 /**
  * @brief Handles the case where the input is the `Tab` key.
  *
@@ -1411,17 +5622,25 @@ static void xd_input_handle_tab() {
     return;
   }
 
+  // the generator takes `int` positions
+  if (xd_input_cursor > INT_MAX) {
+    xd_tty_bell();
+    return;
+  }
+
   // get the current word
-  int idx = xd_input_cursor;
-  while (idx > 0 &&
-         strchr(XD_RL_TAB_COMP_DELIMITERS, xd_input_buffer[idx - 1]) == NULL) {
+  size_t idx = xd_input_cursor;
+  while (idx > 0 && !(xd_char_class[(unsigned char)xd_input_buffer[idx - 1]] &
+                       XD_RL_CHAR_CLASS_TAB_DELIM)) {
     idx--;
   }
-  int word_length = xd_input_cursor - idx;
+  size_t word_length = xd_input_cursor - idx;
 
-  // generate possible completions
-  char **completions =
-      xd_readline_completions_generator(xd_input_buffer, idx, xd_input_cursor);
+  // generate possible completions, the generator is expected to allocate
+  XD_RL_ALLOC_EXPECTED_BEGIN();
+  char **completions = xd_readline_completions_generator(
+      xd_input_buffer, (int)idx, (int)xd_input_cursor);
+  XD_RL_ALLOC_EXPECTED_END();
   if (completions == NULL) {
     xd_tty_bell();
     return;
@@ -1429,7 +5648,8 @@ static void xd_input_handle_tab() {
 
   if (completions[0] != NULL && completions[1] == NULL) {
     // single match, replace the word with the match
-    xd_input_buffer_insert_string(completions[0] + word_length);
+    xd_input_buffer_insert_string(completions[0] + word_length,
+                                  strlen(completions[0] + word_length));
     if (xd_input_buffer[xd_input_cursor - 1] != '/') {
       // add space if it is not a directory
       xd_input_buffer_insert(' ');
@@ -1437,54 +5657,81 @@ static void xd_input_handle_tab() {
   }
   else {
     // multiple matches, replace the word with the longest common prefix
-    char *lcp = xd_util_longest_common_prefix((const char **)completions);
-    if (lcp != NULL && *(lcp + word_length) != XD_RL_ASCII_NUL) {
-      xd_input_buffer_insert_string(lcp + word_length);
+    size_t lcp_length =
+        xd_util_longest_common_prefix((const char **)completions);
+    if (lcp_length > word_length) {
+      xd_input_buffer_insert_string(completions[0] + word_length,
+                                    lcp_length - word_length);
     }
+#if XD_RL_ENABLE_COMPLETION_LIST
     else if (xd_readline_prev_read_char == XD_RL_ASCII_HT) {
       xd_util_print_completions(completions);
     }
-    free(lcp);
+#endif
     xd_tty_bell();
   }
 
-  // free the array of completions
+  // free the array of completions with `free()` like the generator allocated
+  // it, unless allocated from the scratch arena
   for (int i = 0; completions[i] != NULL; i++) {
-    free(completions[i]);
+    if (!xd_arena_owns(completions[i])) {
+      free(completions[i]);
+    }
+  }
+  if (!xd_arena_owns(completions)) {
+    free((void *)completions);
   }
-  free((void *)completions);
   xd_readline_redraw = 1;
 }  // xd_input_handle_tab()
-
-/**
- * @brief Handles the case where the input is the`Backspace` key.
- *
- * Removes one character before the cursor from the input, or from the search
- * query if in forward/reverse history search mode.
- */
-static void xd_input_handle_backspace() {
-  xd_input_handle_ctrl_h();
-}  // xd_input_handle_backspace()
+#endif
 
 /**
  * @brief Handles the case where the input is the `Enter` key.
  *
  * Finalizes the input line by adding new-line character to the end of the input
  * buffer, and  making `xd_readline()` stop reading and return the read line.
+ * If `xd_readline_input_complete` reports the input incomplete, a new-line is
+ * inserted at the cursor instead.
  */
 static void xd_input_handle_enter() {
+  if (xd_readline_input_complete != NULL &&
+      !xd_readline_input_complete(xd_input_buffer)) {
+    if (xd_input_length + 2 > xd_input_capacity ||
+        xd_input_lines_update(xd_input_length) == -1 ||
+        xd_input_lines_reserve(xd_input_lines_count + 1) == -1) {
+      // the input buffer or the line index couldn't grow
+      xd_tty_bell();
+      return;
+    }
+    xd_input_buffer_insert(XD_RL_ASCII_LF);
+    xd_readline_redraw = 1;
+    return;
+  }
+
+  if (xd_history_nav_idx != XD_RL_HISTORY_MAX) {
+    // the accepted line was recalled from history
+    xd_history[xd_history_nav_idx]->hits++;
+  }
+  xd_tty_cursor_move_input(xd_input_cursor, xd_input_length);
+  xd_input_buffer_invalidate(xd_input_length);
   xd_input_buffer[xd_input_length++] = XD_RL_ASCII_LF;
   xd_input_buffer[xd_input_length] = XD_RL_ASCII_NUL;
   xd_readline_finished = 1;
-  xd_tty_cursor_move_right_wrap(xd_input_length - xd_input_cursor - 1);
 }  // xd_input_handle_enter()
 
 /**
  * @brief Handles the case where the input is the `Up Arrow` key.
  *
- * Moves backward in history by one.
+ * Moves to the previous line of the input, or backward in history by one on
+ * the first line.
  */
 static void xd_input_handle_up_arrow() {
+  size_t line = xd_input_lines_find(xd_input_cursor);
+  if (line > 0) {
+    xd_input_buffer_move_to_line(line - 1);
+    return;
+  }
+
   if (xd_history_length == 0 || xd_history_nav_idx == xd_history_start_idx) {
     xd_tty_bell();
     return;
@@ -1505,9 +5752,16 @@ static void xd_input_handle_up_arrow() {
 /**
  * @brief Handles the case where the input is the `Down Arrow` key.
  *
- * Moves forward in history by one.
+ * Moves to the next line of the input, or forward in history by one on the
+ * last line.
  */
 static void xd_input_handle_down_arrow() {
+  size_t line = xd_input_lines_find(xd_input_cursor);
+  if (line < xd_input_lines_find(xd_input_length)) {
+    xd_input_buffer_move_to_line(line + 1);
+    return;
+  }
+
   if (xd_history_length == 0 || xd_history_nav_idx == XD_RL_HISTORY_MAX) {
     xd_tty_bell();
     return;
@@ -1517,448 +5771,1391 @@ static void xd_input_handle_down_arrow() {
   if (xd_history_nav_idx == xd_history_end_idx) {
     xd_history_nav_idx = XD_RL_HISTORY_MAX;
   }
-  else {
-    xd_history_nav_idx = (xd_history_nav_idx + 1) % XD_RL_HISTORY_MAX;
+  else {
+    xd_history_nav_idx = (xd_history_nav_idx + 1) % XD_RL_HISTORY_MAX;
+  }
+  xd_input_buffer_load_from_history();
+  xd_readline_redraw = 1;
+}  // xd_input_handle_down_arrow()
+
+/**
+ * @brief Handles the case where the input is the `Delete` key.
+ *
+ * Removes the character at the cursor position.
+ */
+static void xd_input_handle_delete() {
+  if (xd_input_cursor == xd_input_length) {
+    xd_tty_bell();
+    return;
+  }
+  xd_input_buffer_remove_from_cursor(
+      xd_util_utf8_next(xd_input_buffer, xd_input_length, xd_input_cursor) -
+      xd_input_cursor);
+  xd_readline_redraw = 1;
+}  // xd_input_handle_delete()
+
+/**
+ * @brief Handles the case where the input is `Ctrl+Up Arrow`.
+ *
+ * Moves in history to the first entry.
+ */
+static void xd_input_handler_ctrl_up_arrow() {
+  if (xd_history_length == 0 || xd_history_nav_idx == xd_history_start_idx) {
+    xd_tty_bell();
+    return;
+  }
+
+  xd_input_buffer_save_to_history();
+  xd_history_nav_idx = xd_history_start_idx;
+  xd_input_buffer_load_from_history();
+  xd_readline_redraw = 1;
+}  // xd_input_handler_ctrl_up_arrow()
+
+/**
+ * @brief Handles the case where the input is `Ctrl+Down Arrow`.
+ *
+ * Moves in history to the last entry.
+ */
+static void xd_input_handler_ctrl_down_arrow() {
+  if (xd_history_length == 0 || xd_history_nav_idx == XD_RL_HISTORY_MAX) {
+    xd_tty_bell();
+    return;
+  }
+
+  xd_input_buffer_save_to_history();
+  xd_history_nav_idx = XD_RL_HISTORY_MAX;
+  xd_input_buffer_load_from_history();
+  xd_readline_redraw = 1;
+}  // xd_input_handler_ctrl_down_arrow()
+
+/**
+ * @brief Handles the case where the input is `Alt+F`.
+ *
+ * Moves the cursor forward by one word.
+ */
+static void xd_input_handle_alt_f() {
+  if (xd_input_cursor == xd_input_length) {
+    xd_tty_bell();
+    return;
+  }
+  size_t idx = xd_input_buffer_get_current_word_end();
+  xd_tty_cursor_move_input(xd_input_cursor, idx);
+  xd_input_cursor = idx;
+}  // xd_input_handle_alt_f()
+
+/**
+ * @brief Handles the case where the input is `Alt+B`.
+ *
+ * Moves the cursor backward by one word.
+ */
+static void xd_input_handle_alt_b() {
+  if (xd_input_cursor == 0) {
+    xd_tty_bell();
+    return;
+  }
+  size_t idx = xd_input_buffer_get_current_word_start();
+  xd_tty_cursor_move_input(xd_input_cursor, idx);
+  xd_input_cursor = idx;
+}  // xd_input_handle_alt_b()
+
+/**
+ * @brief Handles the case where the input is `Alt+D`.
+ *
+ * Removes from the cursor position to the end of the word.
+ */
+static void xd_input_handle_alt_d() {
+  if (xd_input_cursor == xd_input_length) {
+    xd_tty_bell();
+    return;
+  }
+  size_t idx = xd_input_buffer_get_current_word_end();
+  xd_input_buffer_remove_from_cursor(idx - xd_input_cursor);
+  xd_readline_redraw = 1;
+}  // xd_input_handle_alt_d()
+
+/**
+ * @brief Handles the case where the input is `Alt+Backspace`.
+ *
+ * Removes from before the cursor position to the beginning of the word.
+ */
+static void xd_input_handle_alt_backspace() {
+  if (xd_input_cursor == 0) {
+    xd_tty_bell();
+    return;
+  }
+  size_t idx = xd_input_buffer_get_current_word_start();
+  xd_input_buffer_remove_before_cursor(xd_input_cursor - idx);
+  xd_readline_redraw = 1;
+}  // xd_input_handle_alt_backspace()
+
+#if XD_RL_ENABLE_SEARCH
+/**
+ * @brief Handles history reverse search.
+ */
+static void xd_readline_history_reverse_search() {
+  if (xd_search_idx == XD_RL_SEARCH_IDX_NEW) {
+    xd_search_idx = xd_history_nav_idx;
+    return;
+  }
+
+  if (xd_search_query_length == 0 ||
+      xd_search_idx == XD_RL_SEARCH_IDX_OUT_OF_BOUNDS) {
+    xd_search_prompt = XD_RL_REVERSE_SEARCH_PROMPT_FAILED;
+    xd_search_result_highlight_start = -1;
+    xd_readline_redraw = 1;
+    return;
+  }
+
+  uint64_t query_mask =
+      xd_util_byte_mask(xd_search_query_buffer, xd_search_query_length);
+  int max_iterations = xd_history_length + 1;
+  const char *res = NULL;
+  for (int i = 0; i < max_iterations; i++) {
+    // skip entries that lack some of the query bytes without scanning them
+    res = NULL;
+    if ((xd_history[xd_search_idx]->mask & query_mask) == query_mask) {
+      res = strstr(xd_history[xd_search_idx]->str, xd_search_query_buffer);
+    }
+    if (res != NULL || xd_search_idx == xd_history_start_idx) {
+      break;
+    }
+    if (xd_search_idx == XD_RL_HISTORY_MAX) {
+      xd_search_idx = xd_history_end_idx;
+    }
+    else {
+      xd_search_idx =
+          (xd_search_idx - 1 + XD_RL_HISTORY_MAX) % XD_RL_HISTORY_MAX;
+    }
+  }
+
+  if (res == NULL) {
+    xd_search_prompt = XD_RL_REVERSE_SEARCH_PROMPT_FAILED;
+    xd_search_result_highlight_start = -1;
+    xd_search_idx = XD_RL_SEARCH_IDX_OUT_OF_BOUNDS;
+  }
+  else {
+    xd_history_nav_idx = xd_search_idx;
+    xd_input_buffer_load_from_history();
+    xd_search_prompt = XD_RL_REVERSE_SERACH_PROMPT;
+    xd_input_cursor = (size_t)(res - xd_history[xd_search_idx]->str);
+    xd_search_result_highlight_start = (ptrdiff_t)xd_input_cursor;
+  }
+  xd_readline_redraw = 1;
+}  // xd_readline_history_reverse_search()
+#endif
+
+#if XD_RL_ENABLE_SEARCH
+/**
+ * @brief Handles history reverse search.
+ */
+static void xd_readline_history_forward_search() {
+  if (xd_search_idx == XD_RL_SEARCH_IDX_NEW) {
+    xd_search_idx = xd_history_nav_idx;
+    return;
+  }
+
+  if (xd_search_query_length == 0 ||
+      xd_search_idx == XD_RL_SEARCH_IDX_OUT_OF_BOUNDS) {
+    xd_search_prompt = XD_RL_FORWARD_SERACH_PROMPT_FAILED;
+    xd_search_result_highlight_start = -1;
+    xd_readline_redraw = 1;
+    return;
+  }
+
+  uint64_t query_mask =
+      xd_util_byte_mask(xd_search_query_buffer, xd_search_query_length);
+  int max_iterations = xd_history_length + 1;
+  const char *res = NULL;
+  for (int i = 0; i < max_iterations; i++) {
+    // skip entries that lack some of the query bytes without scanning them
+    res = NULL;
+    if ((xd_history[xd_search_idx]->mask & query_mask) == query_mask) {
+      res = strstr(xd_history[xd_search_idx]->str, xd_search_query_buffer);
+    }
+    if (res != NULL || xd_search_idx == XD_RL_HISTORY_MAX) {
+      break;
+    }
+    if (xd_search_idx == xd_history_end_idx) {
+      xd_search_idx = XD_RL_HISTORY_MAX;
+    }
+    else {
+      xd_search_idx = (xd_search_idx + 1) % XD_RL_HISTORY_MAX;
+    }
+  }
+
+  if (res == NULL) {
+    xd_search_prompt = XD_RL_FORWARD_SERACH_PROMPT_FAILED;
+    xd_search_result_highlight_start = -1;
+    xd_search_idx = XD_RL_SEARCH_IDX_OUT_OF_BOUNDS;
+  }
+  else {
+    xd_history_nav_idx = xd_search_idx;
+    xd_input_buffer_load_from_history();
+    xd_search_prompt = XD_RL_FORWARD_SERACH_PROMPT;
+    xd_input_cursor = (size_t)(res - xd_history[xd_search_idx]->str);
+    xd_search_result_highlight_start = (ptrdiff_t)xd_input_cursor;
+  }
+  xd_readline_redraw = 1;
+}  // xd_readline_history_forward_search()
+#endif
+
+/**
+ * @brief Reads one input byte, from the macro being run if any, then from the
+ * bytes put back, or from `stdin`.
+ *
+ * Bytes are read from `stdin` one at a time, so the input typed ahead past
+ * the end of the line is left there for whatever reads `stdin` next, e.g. a
+ * command the line starts.
+ *
+ * @param chr Pointer to the byte read.
+ *
+ * @return `1` on success, or the result of `read()` otherwise.
+ */
+static ssize_t xd_input_read_byte(char *chr) {
+  if (xd_keymap_macro != NULL) {
+    if (*xd_keymap_macro != XD_RL_ASCII_NUL) {
+      *chr = *xd_keymap_macro++;
+      return 1;
+    }
+    // cleared only now so the macro's last key can't start another macro
+    xd_keymap_macro = NULL;
+  }
+  if (xd_input_pending_start < xd_input_pending_end) {
+    *chr = xd_input_pending[xd_input_pending_start++];
+    return 1;
   }
-  xd_input_buffer_load_from_history();
-  xd_readline_redraw = 1;
-}  // xd_input_handle_down_arrow()
+  return read(STDIN_FILENO, chr, 1);
+}  // xd_input_read_byte()
 
 /**
- * @brief Handles the case where the input is the `Right Arrow` key.
+ * @brief Puts back the last byte read with `xd_input_read_byte()`, to be read
+ * again.
  *
- * Moves the cursor forward by one character.
+ * @param chr The byte.
  */
-static void xd_input_handle_right_arrow() {
-  xd_input_handle_ctrl_f();
-}  // xd_input_handle_right_arrow()
+static void xd_input_unread_byte(char chr) {
+  if (xd_keymap_macro != NULL) {
+    xd_keymap_macro--;
+  }
+  else {
+    xd_input_pending_prepend(&chr, 1);
+  }
+}  // xd_input_unread_byte()
 
 /**
- * @brief Handles the case where the input is the `Left Arrow` key.
+ * @brief Puts bytes back before the bytes already put back, to be read next.
+ * Bytes that don't fit in `xd_input_pending` are dropped.
  *
- * Moves the cursor backward by one character.
+ * @param bytes The bytes.
+ * @param length The number of bytes.
  */
-static void xd_input_handle_left_arrow() {
-  xd_input_handle_ctrl_b();
-}  // xd_input_handle_left_arrow()
+static void xd_input_pending_prepend(const char *bytes, size_t length) {
+  size_t pending = xd_input_pending_end - xd_input_pending_start;
+  if (length > XD_RL_INPUT_PENDING_MAX - pending) {
+    length = XD_RL_INPUT_PENDING_MAX - pending;
+  }
+  memmove(xd_input_pending + length, xd_input_pending + xd_input_pending_start,
+          pending);
+  memcpy(xd_input_pending, bytes, length);
+  xd_input_pending_start = 0;
+  xd_input_pending_end = length + pending;
+}  // xd_input_pending_prepend()
 
 /**
- * @brief Handles the case where the input is the `Page Up` key.
+ * @brief Checks whether an input byte can be read, waiting for one to arrive
+ * on `stdin` if none is buffered.
+ *
+ * @param timeout The maximum time to wait in milliseconds.
  *
- * Moves backward in history by one.
+ * @return Non-zero if a byte or the end of input can be read without
+ * blocking, zero if none arrived in time.
  */
-static void xd_input_handle_page_up() {
-  xd_input_handle_up_arrow();
-}  // xd_input_handle_page_up()
+static int xd_input_byte_ready(int timeout) {
+  if ((xd_keymap_macro != NULL && *xd_keymap_macro != XD_RL_ASCII_NUL) ||
+      xd_input_pending_start < xd_input_pending_end) {
+    return 1;
+  }
+  struct pollfd fds = {.fd = STDIN_FILENO, .events = POLLIN};
+  int ret;
+  while ((ret = poll(&fds, 1, timeout)) == -1 && errno == EINTR) {
+  }
+  // errors are reported by the next read
+  return ret != 0;
+}  // xd_input_byte_ready()
 
 /**
- * @brief Handles the case where the input is the `Page Down` key.
+ * @brief Returns the time to wait for the next byte of a key sequence.
  *
- * Moves forward in history by one.
+ * @return The timeout in milliseconds.
  */
-static void xd_input_handle_page_down() {
-  xd_input_handle_down_arrow();
-}  // xd_input_handle_page_down()
+static int xd_input_esc_timeout() {
+  if (xd_readline_esc_timeout_ms > 0) {
+    return xd_readline_esc_timeout_ms;
+  }
+  return xd_input_esc_timeout_auto;
+}  // xd_input_esc_timeout()
 
 /**
- * @brief Handles the case where the input is the `Home` key.
+ * @brief Handles a signle input character, dispatching the key sequence it
+ * starts to its bound action.
+ *
+ * The bytes of the sequence are looked up one at a time in the dispatch
+ * tables, reading more while they are a prefix of a longer bound sequence, so
+ * the cost doesn't depend on the number of bindings. The next byte is only
+ * waited for up to the escape timeout, so a lone `Esc` or a sequence bound
+ * along with longer ones doesn't stall the input, and bytes already read
+ * ahead are decoded without waiting.
  *
- * Moves the cursor to the beginning of the input.
+ * @param chr The input character.
  */
-static void xd_input_handle_home() {
-  xd_input_handle_ctrl_a();
-}  // xd_input_handle_home()
+static void xd_input_handler(char chr) {
+  if (xd_input_esc_timed_out && (chr == '[' || chr == 'O') &&
+      xd_readline_esc_timeout_ms <= 0 &&
+      xd_input_esc_timeout_auto < XD_RL_ESC_TIMEOUT_MAX) {
+    // likely the rest of a sequence split by the timeout, wait longer
+    xd_input_esc_timeout_auto *= 2;
+  }
+  xd_input_esc_timed_out = 0;
+
+  char seq[XD_RL_KEYMAP_SEQ_MAX];
+  size_t seq_length = 0;
+  seq[seq_length++] = chr;
+  int timed_out = 0;
+
+  const xd_keymap_entry_t *entry = &xd_keymap_tables[0][(unsigned char)chr];
+  while (entry->next != 0) {
+    if (!xd_input_byte_ready(xd_input_esc_timeout())) {
+      xd_input_esc_timed_out = entry == &xd_keymap_tables[0][XD_RL_ASCII_ESC];
+      timed_out = 1;
+      break;
+    }
+    char next;
+    if (xd_input_read_byte(&next) != 1) {
+      xd_tty_cursor_move_input(xd_input_cursor, xd_input_length);
+      xd_readline_finished = 1;
+      xd_readline_return = NULL;
+      return;
+    }
+    const xd_keymap_entry_t *next_entry =
+        &xd_keymap_tables[entry->next][(unsigned char)next];
+    if (entry->binding != XD_RL_ACTION_NONE &&
+        next_entry->binding == XD_RL_ACTION_NONE && next_entry->next == 0) {
+      // the sequence read is bound, and the byte starts the next key
+      xd_input_unread_byte(next);
+      break;
+    }
+    entry = next_entry;
+    chr = next;
+    seq[seq_length++] = chr;
+  }
+  if (entry->binding == XD_RL_ACTION_NONE && !timed_out && seq_length >= 2 &&
+      seq[0] == XD_RL_ASCII_ESC && seq[1] == '[') {
+    xd_input_handle_csi(seq, seq_length);
+    return;
+  }
+  xd_keymap_execute(entry->binding, chr);
+}  // xd_input_handler()
 
 /**
- * @brief Handles the case where the input is the `End` key.
+ * @brief Handles a CSI sequence that isn't bound, reading the rest of it so
+ * none of its bytes are taken for typed text. Keys reported by the keyboard
+ * enhancement protocol run the binding of the legacy key they stand for.
  *
- * Moves the cursor to the end of the input.
+ * @param seq The bytes of the sequence read so far, starting with `\033[`,
+ * `XD_RL_KEYMAP_SEQ_MAX` bytes long.
+ * @param length The number of bytes read so far.
  */
-static void xd_input_handle_end() {
-  xd_input_handle_ctrl_e();
-}  // xd_input_handle_end()
+static void xd_input_handle_csi(char *seq, size_t length) {
+  // parameter and intermediate bytes are followed by a final byte
+  unsigned char byte = (unsigned char)seq[length - 1];
+  while (length == 2 || (byte >= 0x20 && byte <= 0x3F)) {
+    char next;
+    if (!xd_input_byte_ready(xd_input_esc_timeout()) ||
+        xd_input_read_byte(&next) != 1) {
+      return;
+    }
+    byte = (unsigned char)next;
+    if (byte < 0x20 || byte > 0x7E) {
+      // not part of a sequence, handle it on its own
+      xd_input_unread_byte(next);
+      return;
+    }
+    if (length < XD_RL_KEYMAP_SEQ_MAX - 1) {
+      seq[length++] = next;
+    }
+    else {
+      // too long to be a key, keep the final byte only
+      seq[length - 1] = next;
+    }
+  }
+  seq[length] = XD_RL_ASCII_NUL;
+  if (byte == 'u') {
+    xd_input_handle_kitty_key(seq + 2);
+  }
+}  // xd_input_handle_csi()
 
 /**
- * @brief Handles the case where the input is the `Delete` key.
+ * @brief Handles a key reported by the keyboard enhancement protocol as
+ * `\033[codepoint;modifiers u`, by running the binding of the legacy key it
+ * stands for, or inserting its text if it has no `Ctrl` or `Alt` modifiers.
  *
- * Removes the character at the cursor position.
+ * @param params The parameters of the sequence followed by `u`.
  */
-static void xd_input_handle_delete() {
-  if (xd_input_cursor == xd_input_length) {
-    xd_tty_bell();
+static void xd_input_handle_kitty_key(const char *params) {
+  char *end;
+  unsigned long codepoint = strtoul(params, &end, 10);
+  if (end == params) {
     return;
   }
-  xd_input_buffer_remove_from_cursor(1);
-  xd_readline_redraw = 1;
-}  // xd_input_handle_delete()
+  // skip the alternate key codes
+  end += strcspn(end, ";u");
+  unsigned long modifiers = 0;
+  if (*end == ';') {
+    modifiers = strtoul(end + 1, NULL, 10);
+  }
+  modifiers = modifiers > 0 ? (modifiers - 1) & ~XD_RL_KITTY_MOD_LOCKS : 0;
+  if (modifiers & ~(unsigned long)(XD_RL_KITTY_MOD_SHIFT | XD_RL_KITTY_MOD_ALT |
+                                   XD_RL_KITTY_MOD_CTRL) ||
+      (codepoint >= 0xE000 && codepoint <= 0xF8FF)) {
+    // `Super` and other modifiers, and functional keys have no legacy key
+    return;
+  }
+
+  char key[XD_RL_UTF8_SEQ_MAX + 1];
+  size_t key_length = 0;
+  if (modifiers & XD_RL_KITTY_MOD_ALT) {
+    key[key_length++] = XD_RL_ASCII_ESC;
+  }
+  if (codepoint == XD_RL_ASCII_CR &&
+      (xd_original_tty_attributes.c_iflag & ICRNL)) {
+    // the tty translates `Enter` to `LF` when it is reported the legacy way
+    key[key_length++] = XD_RL_ASCII_LF;
+  }
+  else if (codepoint < ' ' || codepoint == XD_RL_ASCII_DEL) {
+    // `Enter`, `Tab`, `Backspace` and `Esc` are the same with `Ctrl`
+    key[key_length++] = (char)codepoint;
+  }
+  else if (modifiers & XD_RL_KITTY_MOD_CTRL) {
+    if (codepoint >= 'a' && codepoint <= 'z') {
+      codepoint -= 'a' - 'A';
+    }
+    if (codepoint == ' ') {
+      codepoint = '@';
+    }
+    if (codepoint < '@' || codepoint > '_') {
+      // the legacy encoding has no such control character
+      return;
+    }
+    key[key_length++] = (char)(codepoint & 0x1F);
+  }
+  else {
+    if ((modifiers & XD_RL_KITTY_MOD_SHIFT) && codepoint >= 'a' &&
+        codepoint <= 'z') {
+      codepoint -= 'a' - 'A';
+    }
+    size_t encoded = xd_util_utf8_encode((uint32_t)codepoint, key + key_length);
+    if (encoded == 0) {
+      return;
+    }
+    key_length += encoded;
+  }
+
+  if (!(modifiers & (XD_RL_KITTY_MOD_ALT | XD_RL_KITTY_MOD_CTRL)) &&
+      codepoint >= ' ' && codepoint != XD_RL_ASCII_DEL) {
+    // typed text, read again as if typed
+    xd_input_pending_prepend(key, key_length);
+    return;
+  }
+
+  // the tty only sends the signals of the keys it receives the legacy way
+  cc_t chr = (cc_t)key[0];
+  if (key_length == 1 && chr != _POSIX_VDISABLE &&
+      (xd_original_tty_attributes.c_lflag & ISIG)) {
+    const cc_t *cc = xd_original_tty_attributes.c_cc;
+    int sig = 0;
+    if (chr == cc[VINTR]) {
+      sig = SIGINT;
+    }
+    else if (chr == cc[VQUIT]) {
+      sig = SIGQUIT;
+    }
+    else if (chr == cc[VSUSP]) {
+      sig = SIGTSTP;
+    }
+    if (sig != 0) {
+      raise(sig);
+      return;
+    }
+  }
+
+  // look the legacy key up without waiting for more bytes, `Esc` and `Alt`
+  // combinations are complete
+  const xd_keymap_entry_t *entry = &xd_keymap_tables[0][(unsigned char)key[0]];
+  for (size_t i = 1; i < key_length; i++) {
+    if (entry->next == 0) {
+      return;
+    }
+    entry = &xd_keymap_tables[entry->next][(unsigned char)key[i]];
+  }
+  xd_keymap_execute(entry->binding, key[key_length - 1]);
+}  // xd_input_handle_kitty_key()
 
 /**
- * @brief Handles the case where the input is `Ctrl+Up Arrow`.
+ * @brief Adds or replaces the binding of a key sequence, the dispatch tables
+ * are compiled again before reading the next line.
  *
- * Moves in history to the first entry.
+ * @param sequence The key sequence.
+ * @param action The action to bind, ignored if `macro` is not `NULL`.
+ * @param macro The text of the macro to bind, or `NULL`.
+ *
+ * @return `0` on success or `-1` on failure, with `errno` set to `EINVAL` if
+ * the sequence or action is invalid, or `ENOMEM` on allocation failure.
  */
-static void xd_input_handler_ctrl_up_arrow() {
-  if (xd_history_length == 0 || xd_history_nav_idx == xd_history_start_idx) {
-    xd_tty_bell();
-    return;
+static int xd_keymap_set(const char *sequence, xd_readline_action_t action,
+                         const char *macro) {
+  size_t length = sequence == NULL ? 0 : strlen(sequence);
+  if (length == 0 || length >= XD_RL_KEYMAP_SEQ_MAX ||
+      (unsigned)action >= XD_RL_KEYMAP_ACTIONS) {
+    errno = EINVAL;
+    return -1;
+  }
+  char *macro_copy = NULL;
+  size_t macro_size = 0;
+  if (macro != NULL) {
+    macro_size = strlen(macro) + 1;
+    macro_copy = xd_util_strndup(macro, macro_size - 1);
+    if (macro_copy == NULL) {
+      errno = ENOMEM;
+      return -1;
+    }
   }
 
-  xd_input_buffer_save_to_history();
-  xd_history_nav_idx = xd_history_start_idx;
-  xd_input_buffer_load_from_history();
-  xd_readline_redraw = 1;
-}  // xd_input_handler_ctrl_up_arrow()
+  // the sequence was bound before, replace its binding
+  for (size_t i = 0; i < xd_keymap_bindings_length; i++) {
+    xd_keymap_binding_t *binding = &xd_keymap_bindings[i];
+    if (strcmp(binding->sequence, sequence) != 0) {
+      continue;
+    }
+    if (binding->macro != NULL) {
+      xd_memory_account(XD_RL_MEMORY_KEYMAP, strlen(binding->macro) + 1, 0);
+      xd_util_free(binding->macro);
+    }
+    xd_memory_account(XD_RL_MEMORY_KEYMAP, 0, macro_size);
+    binding->macro = macro_copy;
+    binding->action = action;
+    xd_keymap_dirty = 1;
+    return 0;
+  }
+
+  if (xd_keymap_bindings_length == xd_keymap_bindings_capacity) {
+    // macros are referenced by index in the 16-bit dispatch table entries
+    size_t capacity =
+        xd_keymap_bindings_length < UINT16_MAX - XD_RL_KEYMAP_ACTIONS
+            ? xd_memory_grow_target(xd_keymap_bindings_capacity,
+                                    xd_keymap_bindings_length, 1, 16)
+            : 0;
+    xd_keymap_binding_t *ptr =
+        capacity == 0 ? NULL
+                      : (xd_keymap_binding_t *)xd_util_realloc(
+                            xd_keymap_bindings,
+                            sizeof(xd_keymap_binding_t) * capacity);
+    if (ptr == NULL) {
+      xd_util_free(macro_copy);
+      errno = ENOMEM;
+      return -1;
+    }
+    xd_memory_account(
+        XD_RL_MEMORY_KEYMAP,
+        sizeof(xd_keymap_binding_t) * xd_keymap_bindings_capacity,
+        sizeof(xd_keymap_binding_t) * capacity);
+    xd_keymap_bindings = ptr;
+    xd_keymap_bindings_capacity = capacity;
+  }
+  char *sequence_copy = xd_util_strndup(sequence, length);
+  if (sequence_copy == NULL) {
+    xd_util_free(macro_copy);
+    errno = ENOMEM;
+    return -1;
+  }
+  xd_memory_account(XD_RL_MEMORY_KEYMAP, 0, length + 1 + macro_size);
+  xd_keymap_bindings[xd_keymap_bindings_length++] = (xd_keymap_binding_t){
+      .sequence = sequence_copy, .macro = macro_copy, .action = action};
+  xd_keymap_dirty = 1;
+  return 0;
+}  // xd_keymap_set()
 
 /**
- * @brief Handles the case where the input is `Ctrl+Down Arrow`.
+ * @brief Compiles the default and added bindings into the dispatch tables,
+ * with the added ones overriding the defaults.
  *
- * Moves in history to the last entry.
+ * @return `0` on success or `-1` on allocation failure, in which case the
+ * bindings stay marked as changed.
  */
-static void xd_input_handler_ctrl_down_arrow() {
-  if (xd_history_length == 0 || xd_history_nav_idx == XD_RL_HISTORY_MAX) {
-    xd_tty_bell();
-    return;
+static int xd_keymap_compile() {
+  // every byte of a sequence but the last may need a table of its own
+  size_t capacity = 1;
+  for (int i = 0; i < xd_keymap_defaults_length; i++) {
+    capacity += strlen(xd_keymap_defaults[i].sequence) - 1;
+  }
+  for (size_t i = 0; i < xd_keymap_bindings_length; i++) {
+    capacity += strlen(xd_keymap_bindings[i].sequence) - 1;
+  }
+  if (capacity > UINT16_MAX) {
+    capacity = UINT16_MAX;
+  }
+  xd_keymap_table_t *tables = (xd_keymap_table_t *)xd_util_realloc(
+      xd_keymap_tables, sizeof(xd_keymap_table_t) * capacity);
+  if (tables == NULL) {
+    return -1;
+  }
+  xd_memory_account(XD_RL_MEMORY_KEYMAP,
+                    sizeof(xd_keymap_table_t) * xd_keymap_tables_length,
+                    sizeof(xd_keymap_table_t) * capacity);
+  xd_keymap_tables = tables;
+  xd_keymap_tables_length = capacity;
+
+  size_t length = 1;
+  memset(xd_keymap_tables[0], 0, sizeof(xd_keymap_table_t));
+  for (int byte = 0; byte < 256; byte++) {
+    if (byte >= 0x80 || isprint(byte)) {
+      xd_keymap_tables[0][byte].binding = XD_RL_ACTION_SELF_INSERT;
+    }
+  }
+  for (int i = 0; i < xd_keymap_defaults_length; i++) {
+    xd_keymap_compile_add(xd_keymap_defaults[i].sequence,
+                          xd_keymap_defaults[i].action, &length, capacity);
+  }
+  for (size_t i = 0; i < xd_keymap_bindings_length; i++) {
+    const xd_keymap_binding_t *binding = &xd_keymap_bindings[i];
+    uint16_t value = binding->macro != NULL ? XD_RL_KEYMAP_ACTIONS + i
+                                            : (uint16_t)binding->action;
+    if (xd_keymap_compile_add(binding->sequence, value, &length, capacity) ==
+        -1) {
+      // out of table indices, the bindings left can't be dispatched
+      break;
+    }
   }
 
-  xd_input_buffer_save_to_history();
-  xd_history_nav_idx = XD_RL_HISTORY_MAX;
-  xd_input_buffer_load_from_history();
-  xd_readline_redraw = 1;
-}  // xd_input_handler_ctrl_down_arrow()
+  // sequences sharing prefixes share tables, release the unused ones
+  tables = (xd_keymap_table_t *)xd_util_realloc(
+      xd_keymap_tables, sizeof(xd_keymap_table_t) * length);
+  if (tables != NULL) {
+    xd_memory_account(XD_RL_MEMORY_KEYMAP,
+                      sizeof(xd_keymap_table_t) * xd_keymap_tables_length,
+                      sizeof(xd_keymap_table_t) * length);
+    xd_keymap_tables = tables;
+    xd_keymap_tables_length = length;
+  }
+  xd_keymap_dirty = 0;
+  return 0;
+}  // xd_keymap_compile()
 
 /**
- * @brief Handles the case where the input is `Ctrl+Right Arrow`.
+ * @brief Adds the binding of a key sequence to the dispatch tables, adding the
+ * tables of its prefixes if needed.
  *
- * Moves the cursor forward by one word.
+ * @param sequence The key sequence.
+ * @param binding The action or `XD_RL_KEYMAP_ACTIONS` plus the macro binding
+ * index.
+ * @param length Pointer to the number of tables in use.
+ * @param capacity The number of tables allocated.
+ *
+ * @return `0` on success or `-1` if more tables are needed.
  */
-static void xd_input_handle_ctrl_right_arrow() {
-  xd_input_handle_alt_f();
-}  // xd_input_handle_ctrl_right_arrow()
+static int xd_keymap_compile_add(const char *sequence, uint16_t binding,
+                                 size_t *length, size_t capacity) {
+  xd_keymap_entry_t *entry = &xd_keymap_tables[0][(unsigned char)sequence[0]];
+  for (size_t i = 1; sequence[i] != XD_RL_ASCII_NUL; i++) {
+    if (entry->next == 0) {
+      if (*length == capacity) {
+        return -1;
+      }
+      memset(xd_keymap_tables[*length], 0, sizeof(xd_keymap_table_t));
+      entry->next = (uint16_t)(*length)++;
+    }
+    entry = &xd_keymap_tables[entry->next][(unsigned char)sequence[i]];
+  }
+  entry->binding = binding;
+  return 0;
+}  // xd_keymap_compile_add()
 
 /**
- * @brief Handles the case where the input is `Ctrl+Left Arrow`.
+ * @brief Runs the action or macro bound to a key sequence.
  *
- * Moves the cursor backward by one word.
+ * @param binding The binding found in the dispatch tables.
+ * @param chr The last byte of the key sequence.
+ */
+static void xd_keymap_execute(uint16_t binding, char chr) {
+  if (binding >= XD_RL_KEYMAP_ACTIONS) {
+    if (xd_keymap_macro == NULL) {
+      xd_keymap_macro =
+          xd_keymap_bindings[binding - XD_RL_KEYMAP_ACTIONS].macro;
+    }
+    return;
+  }
+  xd_readline_action_t action = (xd_readline_action_t)binding;
+
+#if XD_RL_ENABLE_SEARCH
+  if (xd_readline_mode != XD_READLINE_NORMAL &&
+      action != XD_RL_ACTION_SELF_INSERT &&
+      action != XD_RL_ACTION_BACKWARD_DELETE_CHAR &&
+      action != XD_RL_ACTION_REVERSE_SEARCH_HISTORY &&
+      action != XD_RL_ACTION_FORWARD_SEARCH_HISTORY) {
+    xd_readline_mode = XD_READLINE_NORMAL;
+    xd_readline_redraw = 1;
+    if (action == XD_RL_ACTION_ABORT) {
+      // `Ctrl+G` restore original input before starting reverse search
+      xd_history_nav_idx = xd_search_original_nav_idx;
+      xd_input_buffer_load_from_history();
+      xd_input_cursor = xd_search_original_input_cursor;
+      return;
+    }
+  }
+#endif
+
+  if (action == XD_RL_ACTION_SELF_INSERT) {
+    unsigned char byte = (unsigned char)chr;
+    if (byte >= 0x80) {
+      xd_input_handle_utf8(chr);
+    }
+    else if (isprint(byte)) {
+      xd_input_handle_printable(&chr, 1);
+    }
+    return;
+  }
+  if (xd_keymap_handlers[action] != NULL) {
+    xd_keymap_handlers[action]();
+  }
+}  // xd_keymap_execute()
+
+/**
+ * @brief Frees the added bindings and the dispatch tables, the defaults are
+ * compiled again before reading the next line.
  */
-static void xd_input_handle_ctrl_left_arrow() {
-  xd_input_handle_alt_b();
-}  // xd_input_handle_ctrl_left_arrow()
+static void xd_keymap_destroy() {
+  for (size_t i = 0; i < xd_keymap_bindings_length; i++) {
+    xd_util_free(xd_keymap_bindings[i].sequence);
+    xd_util_free(xd_keymap_bindings[i].macro);
+  }
+  xd_util_free(xd_keymap_bindings);
+  xd_util_free(xd_keymap_tables);
+  xd_memory_account(XD_RL_MEMORY_KEYMAP,
+                    xd_memory_usage[XD_RL_MEMORY_KEYMAP].current, 0);
+  xd_keymap_bindings = NULL;
+  xd_keymap_bindings_length = 0;
+  xd_keymap_bindings_capacity = 0;
+  xd_keymap_tables = NULL;
+  xd_keymap_tables_length = 0;
+  xd_keymap_dirty = 1;
+  xd_keymap_macro = NULL;
+}  // xd_keymap_destroy()
 
 /**
- * @brief Handles the case where the input is `Ctrl+Page Up`.
+ * @brief Returns the editing action with the passed inputrc name.
  *
- * Moves in history to the first entry.
+ * @param name The name of the action, e.g. `"kill-line"`.
+ *
+ * @return The action, or `XD_RL_ACTION_NONE` if there is none with this name.
  */
-static void xd_input_handler_ctrl_page_up() {
-  xd_input_handler_ctrl_up_arrow();
-}  // xd_input_handler_ctrl_page_up()
+static xd_readline_action_t xd_keymap_action_from_name(const char *name) {
+  for (int i = 0; i < XD_RL_KEYMAP_ACTIONS; i++) {
+    if (xd_keymap_action_names[i] != NULL &&
+        strcmp(xd_keymap_action_names[i], name) == 0) {
+      return (xd_readline_action_t)i;
+    }
+  }
+  return XD_RL_ACTION_NONE;
+}  // xd_keymap_action_from_name()
 
 /**
- * @brief Handles the case where the input is `Ctrl+Page Down`.
+ * @brief Unescapes a quoted inputrc string in place, from after its opening
+ * quote up to its closing quote.
+ *
+ * Supports `\C-x` (`Ctrl`), `\M-x` (`Meta`, sent as `ESC x`), `\e`, the C
+ * escapes, `\d` (`DEL`), octal `\nnn`, and hexadecimal `\xHH`.
  *
- * Moves in history to the last entry (current input).
+ * @param str The string after the opening quote.
+ * @param quote The quote character.
+ * @param end Pointer receiving the position after the closing quote, or
+ * `NULL` if there is none.
+ *
+ * @return The length of the unescaped string, which may contain null bytes.
  */
-static void xd_input_handler_ctrl_page_down() {
-  xd_input_handler_ctrl_down_arrow();
-}  // xd_input_handler_ctrl_page_down()
+static size_t xd_keymap_unescape(char *str, char quote, char **end) {
+  char *src = str;
+  size_t length = 0;
+  while (*src != quote) {
+    if (*src == XD_RL_ASCII_NUL) {
+      *end = NULL;
+      return length;
+    }
+    if (*src != '\\' || src[1] == XD_RL_ASCII_NUL) {
+      str[length++] = *src++;
+      continue;
+    }
+    src++;
+
+    // `\C-` and `\M-` apply to the following character
+    int control = 0;
+    int meta = 0;
+    while ((src[0] == 'C' || src[0] == 'M') && src[1] == '-' &&
+           src[2] != XD_RL_ASCII_NUL) {
+      control |= src[0] == 'C';
+      meta |= src[0] == 'M';
+      src += 2;
+      if (src[0] != '\\' || (src[1] != 'C' && src[1] != 'M') || src[2] != '-') {
+        break;
+      }
+      src++;
+    }
+
+    char chr = *src++;
+    if (control) {
+      chr = chr == '?' ? XD_RL_ASCII_DEL : (char)(chr & 0x1F);
+    }
+    else if (!meta) {
+      switch (chr) {
+        case 'a':
+          chr = XD_RL_ASCII_BEL;
+          break;
+        case 'b':
+          chr = XD_RL_ASCII_BS;
+          break;
+        case 'd':
+          chr = XD_RL_ASCII_DEL;
+          break;
+        case 'e':
+          chr = XD_RL_ASCII_ESC;
+          break;
+        case 'f':
+          chr = XD_RL_ASCII_FF;
+          break;
+        case 'n':
+          chr = XD_RL_ASCII_LF;
+          break;
+        case 'r':
+          chr = XD_RL_ASCII_CR;
+          break;
+        case 't':
+          chr = XD_RL_ASCII_HT;
+          break;
+        case 'v':
+          chr = XD_RL_ASCII_VT;
+          break;
+        case 'x':
+          if (isxdigit((unsigned char)*src)) {
+            int value = 0;
+            for (int i = 0; i < 2 && isxdigit((unsigned char)*src); i++) {
+              int digit = (unsigned char)*src++;
+              value = value * 16 + (isdigit(digit) ? digit - '0'
+                                                   : tolower(digit) - 'a' + 10);
+            }
+            chr = (char)value;
+          }
+          break;
+        default:
+          if (chr >= '0' && chr <= '7') {
+            int value = chr - '0';
+            for (int i = 0; i < 2 && *src >= '0' && *src <= '7'; i++) {
+              value = value * 8 + (*src++ - '0');
+            }
+            chr = (char)value;
+          }
+          break;
+      }
+    }
+    if (meta) {
+      str[length++] = XD_RL_ASCII_ESC;
+    }
+    str[length++] = chr;
+  }
+  *end = src + 1;
+  return length;
+}  // xd_keymap_unescape()
 
 /**
- * @brief Handles the case where the input is `Ctrl+Delete`.
+ * @brief Parses an inputrc key name, e.g. `Control-a`, `M-f`, or `TAB`, into
+ * the key sequence it sends.
  *
- * Removes from the cursor position to the end of the word.
+ * @param name The key name.
+ * @param sequence Buffer of `XD_RL_KEYMAP_SEQ_MAX` bytes receiving the
+ * null-terminated key sequence.
+ *
+ * @return The length of the key sequence, or `0` if the name is invalid.
  */
-static void xd_input_handle_ctrl_delete() {
-  xd_input_handle_alt_d();
-}  // xd_input_handle_ctrl_delete()
+static size_t xd_keymap_parse_key_name(const char *name, char *sequence) {
+  static const struct {
+    const char *name;
+    char chr;
+  } key_names[] = {
+      {"DEL",     XD_RL_ASCII_DEL},
+      {"ESC",     XD_RL_ASCII_ESC},
+      {"Escape",  XD_RL_ASCII_ESC},
+      {"LFD",     XD_RL_ASCII_LF },
+      {"Newline", XD_RL_ASCII_LF },
+      {"RET",     XD_RL_ASCII_CR },
+      {"Return",  XD_RL_ASCII_CR },
+      {"Rubout",  XD_RL_ASCII_DEL},
+      {"SPC",     ' '            },
+      {"Space",   ' '            },
+      {"TAB",     XD_RL_ASCII_HT },
+  };
+
+  int control = 0;
+  int meta = 0;
+  while (1) {
+    if (strncasecmp(name, "Control-", 8) == 0) {
+      control = 1;
+      name += 8;
+    }
+    else if (strncasecmp(name, "C-", 2) == 0 && name[2] != XD_RL_ASCII_NUL) {
+      control = 1;
+      name += 2;
+    }
+    else if (strncasecmp(name, "Meta-", 5) == 0) {
+      meta = 1;
+      name += 5;
+    }
+    else if (strncasecmp(name, "M-", 2) == 0 && name[2] != XD_RL_ASCII_NUL) {
+      meta = 1;
+      name += 2;
+    }
+    else {
+      break;
+    }
+  }
+
+  char chr = name[0];
+  if (name[0] == XD_RL_ASCII_NUL || name[1] != XD_RL_ASCII_NUL) {
+    chr = XD_RL_ASCII_NUL;
+    for (size_t i = 0; i < sizeof(key_names) / sizeof(key_names[0]); i++) {
+      if (strcasecmp(name, key_names[i].name) == 0) {
+        chr = key_names[i].chr;
+        break;
+      }
+    }
+  }
+  if (control) {
+    chr = chr == '?' ? XD_RL_ASCII_DEL : (char)(chr & 0x1F);
+  }
+  if (chr == XD_RL_ASCII_NUL) {
+    return 0;
+  }
+  size_t length = 0;
+  if (meta) {
+    sequence[length++] = XD_RL_ASCII_ESC;
+  }
+  sequence[length++] = chr;
+  sequence[length] = XD_RL_ASCII_NUL;
+  return length;
+}  // xd_keymap_parse_key_name()
 
 /**
- * @brief Handles the case where the input is `Alt+F`.
+ * @brief Evaluates the condition of an inputrc `$if` directive.
  *
- * Moves the cursor forward by one word.
+ * @param condition The condition, e.g. `mode=emacs` or `term=xterm`.
+ *
+ * @return Non-zero if the condition holds, zero otherwise, including for
+ * application names and version tests which are meant for other programs.
  */
-static void xd_input_handle_alt_f() {
-  if (xd_input_cursor == xd_input_length) {
-    xd_tty_bell();
-    return;
+static int xd_keymap_condition(const char *condition) {
+  size_t length = strcspn(condition, " \t");
+  if (strncmp(condition, "mode=", 5) == 0) {
+    return length == 10 && strncmp(condition + 5, "emacs", 5) == 0;
   }
-  int idx = xd_input_buffer_get_current_word_end();
-  xd_tty_cursor_move_right_wrap(idx - xd_input_cursor);
-  xd_input_cursor = idx;
-}  // xd_input_handle_alt_f()
+  if (strncmp(condition, "term=", 5) == 0) {
+    // matches the whole terminal name or the part before the first `-`
+    const char *term = getenv("TERM");
+    length -= 5;
+    return term != NULL && strncmp(term, condition + 5, length) == 0 &&
+           (term[length] == XD_RL_ASCII_NUL || term[length] == '-');
+  }
+  return 0;
+}  // xd_keymap_condition()
 
 /**
- * @brief Handles the case where the input is `Alt+B`.
+ * @brief Loads the key bindings of an inputrc file.
  *
- * Moves the cursor backward by one word.
+ * @param path The path of the file, `~/` is expanded to the home directory.
+ * @param depth The number of files including this one.
+ *
+ * @return `0` on success `-1` on failure.
  */
-static void xd_input_handle_alt_b() {
-  if (xd_input_cursor == 0) {
-    xd_tty_bell();
-    return;
+static int xd_keymap_load_file(const char *path, int depth) {
+  char expanded[PATH_MAX];
+  const char *home = getenv("HOME");
+  if (strncmp(path, "~/", 2) == 0 && home != NULL) {
+    snprintf(expanded, sizeof(expanded), "%s%s", home, path + 1);
+    path = expanded;
   }
-  int idx = xd_input_buffer_get_current_word_start();
-  xd_tty_cursor_move_left_wrap(xd_input_cursor - idx);
-  xd_input_cursor = idx;
-}  // xd_input_handle_alt_b()
+  FILE *file = fopen(path, "r");
+  if (file == NULL) {
+    return -1;
+  }
+
+  char *line = NULL;
+  size_t capacity = 0;
+  int level = 0;    // nesting level of the `$if` directives
+  int skipped = 0;  // level of the `$if` whose branch is skipped, or `0`
+  ssize_t length;
+  while ((length = xd_util_read_line(file, &line, &capacity)) != -1) {
+    while (length > 0 && (line[length - 1] == XD_RL_ASCII_LF ||
+                          line[length - 1] == XD_RL_ASCII_CR)) {
+      line[--length] = XD_RL_ASCII_NUL;
+    }
+    char *str = line + strspn(line, " \t");
+    if (str[0] != '$') {
+      if (!skipped) {
+        xd_keymap_load_line(str);
+      }
+      continue;
+    }
+
+    char *directive = str + 1;
+    size_t directive_length = strcspn(directive, " \t");
+    char *argument = directive + directive_length;
+    argument += strspn(argument, " \t");
+    if (directive_length == 2 && strncmp(directive, "if", 2) == 0) {
+      level++;
+      if (!skipped && !xd_keymap_condition(argument)) {
+        skipped = level;
+      }
+    }
+    else if (directive_length == 4 && strncmp(directive, "else", 4) == 0) {
+      if (skipped == level) {
+        skipped = 0;
+      }
+      else if (!skipped && level > 0) {
+        skipped = level;
+      }
+    }
+    else if (directive_length == 5 && strncmp(directive, "endif", 5) == 0) {
+      if (skipped == level) {
+        skipped = 0;
+      }
+      if (level > 0) {
+        level--;
+      }
+    }
+    else if (directive_length == 7 && strncmp(directive, "include", 7) == 0 &&
+             !skipped && depth < XD_RL_KEYMAP_INCLUDE_MAX) {
+      argument[strcspn(argument, " \t")] = XD_RL_ASCII_NUL;
+      xd_keymap_load_file(argument, depth + 1);
+    }
+  }
+  xd_util_free(line);
+  fclose(file);
+  return 0;
+}  // xd_keymap_load_file()
 
 /**
- * @brief Handles the case where the input is `Alt+D`.
+ * @brief Loads the key binding of an inputrc line, lines that aren't valid
+ * bindings are ignored.
  *
- * Removes from the cursor position to the end of the word.
+ * @param line The line, without leading spaces, modified while parsing it.
  */
-static void xd_input_handle_alt_d() {
-  if (xd_input_cursor == xd_input_length) {
-    xd_tty_bell();
+static void xd_keymap_load_line(char *line) {
+  char sequence[XD_RL_KEYMAP_SEQ_MAX];
+  char *value = NULL;
+  if (line[0] == '"') {
+    // `"\C-x\C-r": ...`
+    size_t length = xd_keymap_unescape(line + 1, '"', &value);
+    if (value == NULL || length == 0 || length >= XD_RL_KEYMAP_SEQ_MAX ||
+        memchr(line + 1, XD_RL_ASCII_NUL, length) != NULL) {
+      return;
+    }
+    memcpy(sequence, line + 1, length);
+    sequence[length] = XD_RL_ASCII_NUL;
+    value += strspn(value, " \t");
+    if (*value++ != ':') {
+      return;
+    }
+  }
+  else {
+    // `Control-x: ...`, `set` lines and comments have no key name
+    char *colon = strchr(line, ':');
+    if (colon == NULL || line[0] == '#') {
+      return;
+    }
+    *colon = XD_RL_ASCII_NUL;
+    line[strcspn(line, " \t")] = XD_RL_ASCII_NUL;
+    if (xd_keymap_parse_key_name(line, sequence) == 0) {
+      return;
+    }
+    value = colon + 1;
+  }
+
+  value += strspn(value, " \t");
+  if (value[0] == '"' || value[0] == '\'') {
+    char *end;
+    size_t length = xd_keymap_unescape(value + 1, value[0], &end);
+    if (end == NULL || memchr(value + 1, XD_RL_ASCII_NUL, length) != NULL) {
+      return;
+    }
+    value[1 + length] = XD_RL_ASCII_NUL;
+    xd_keymap_set(sequence, XD_RL_ACTION_NONE, value + 1);
     return;
   }
-  int idx = xd_input_buffer_get_current_word_end();
-  xd_input_buffer_remove_from_cursor(idx - xd_input_cursor);
-  xd_readline_redraw = 1;
-}  // xd_input_handle_alt_d()
+  value[strcspn(value, " \t")] = XD_RL_ASCII_NUL;
+  xd_readline_action_t action = xd_keymap_action_from_name(value);
+  if (action != XD_RL_ACTION_NONE) {
+    xd_keymap_set(sequence, action, NULL);
+  }
+}  // xd_keymap_load_line()
 
 /**
- * @brief Handles the case where the input is `Alt+Backspace`.
+ * @brief Returns the size in bytes of the stream buffer and its new-line
+ * bitmap for the passed capacity.
  *
- * Removes from before the cursor position to the beginning of the word.
+ * @param capacity The capacity of the stream buffer.
+ *
+ * @return The size of the stream buffer and its bitmap.
  */
-static void xd_input_handle_alt_backspace() {
-  if (xd_input_cursor == 0) {
-    xd_tty_bell();
-    return;
-  }
-  int idx = xd_input_buffer_get_current_word_start();
-  xd_input_buffer_remove_before_cursor(xd_input_cursor - idx);
-  xd_readline_redraw = 1;
-}  // xd_input_handle_alt_backspace()
+static size_t xd_stream_size(size_t capacity) {
+  return sizeof(char) * (capacity + XD_RL_STREAM_BLOCK_SIZE) +
+         sizeof(uint64_t) * (capacity / XD_RL_STREAM_BLOCK_SIZE + 2);
+}  // xd_stream_size()
 
 /**
- * @brief Handles the case where the input is an escape sequence.
+ * @brief Resizes the stream buffer and its new-line bitmap, keeping their
+ * contents.
+ *
+ * @param capacity The new capacity, must fit the data not returned yet.
  *
- * Reads the ANSI escape sequence and calls the correct input handler function.
+ * @return `0` on success or `-1` on failure with `errno` set to `ENOMEM`, in
+ * which case the buffer is left unchanged.
  */
-static void xd_input_handle_escape_sequence() {
-  // buffer for reading the escape sequence
-  int idx = 0;
-  char buffer[XD_RL_SMALL_BUFFER_SIZE];
-  buffer[idx++] = XD_RL_ASCII_ESC;
-  buffer[idx] = XD_RL_ASCII_NUL;
-
-  // read the escape sequence chracters one by one
-  char chr;
-  int is_valid_prefix = 0;
-  while (idx < XD_RL_SMALL_BUFFER_SIZE - 1) {
-    if (read(STDIN_FILENO, &chr, 1) != 1) {
-      xd_tty_cursor_move_right_wrap(xd_input_length - xd_input_cursor);
-      xd_readline_finished = 1;
-      xd_readline_return = NULL;
-      return;
-    }
-    buffer[idx++] = chr;
-    buffer[idx] = XD_RL_ASCII_NUL;
-
-    is_valid_prefix = 0;
+static int xd_stream_resize(size_t capacity) {
+  size_t old_size =
+      xd_stream_buffer == NULL ? 0 : xd_stream_size(xd_stream_capacity);
+  size_t new_size = xd_stream_size(capacity);
+  if (new_size > old_size && !xd_memory_fits(new_size - old_size)) {
+    errno = ENOMEM;
+    return -1;
+  }
+  // the bitmap is allocated anew and replaces the old one only once the
+  // buffer is resized, so that a failure leaves both as they were
+  size_t words = capacity / XD_RL_STREAM_BLOCK_SIZE + 2;
+  uint64_t *newlines = (uint64_t *)xd_util_malloc(sizeof(uint64_t) * words);
+  if (newlines == NULL) {
+    errno = ENOMEM;
+    return -1;
+  }
+  char *ptr = (char *)xd_util_realloc(
+      xd_stream_buffer, sizeof(char) * (capacity + XD_RL_STREAM_BLOCK_SIZE));
+  if (ptr == NULL) {
+    xd_util_free(newlines);
+    errno = ENOMEM;
+    return -1;
+  }
+  if (xd_stream_newlines != NULL) {
+    size_t old_words = xd_stream_capacity / XD_RL_STREAM_BLOCK_SIZE + 2;
+    memcpy(newlines, xd_stream_newlines,
+           sizeof(uint64_t) * (old_words < words ? old_words : words));
+    xd_util_free(xd_stream_newlines);
+  }
+  xd_memory_account(XD_RL_MEMORY_INPUT, old_size, new_size);
+  xd_stream_newlines = newlines;
+  xd_stream_buffer = ptr;
+  xd_stream_capacity = capacity;
+  return 0;
+}  // xd_stream_resize()
 
-    for (int i = 0; i < xd_esc_seq_bindings_length; i++) {
-      // the read sequence is a defined escape sequence binding
-      if (strcmp(buffer, xd_esc_seq_bindings[i].sequence) == 0) {
-        xd_esc_seq_bindings[i].handler();
-        return;
-      }
-      // the read sequence is a prefix for a defined escape sequence binding
-      if (!is_valid_prefix &&
-          strncmp(buffer, xd_esc_seq_bindings[i].sequence, idx) == 0) {
-        is_valid_prefix = 1;
-      }
+/**
+ * @brief Updates the new-line bitmap for the bytes of the stream buffer from
+ * the passed index up to `xd_stream_end`, `64` bytes at a time.
+ *
+ * @param from The index of the first byte not indexed yet.
+ */
+static void xd_stream_index(size_t from) {
+  size_t words_end =
+      (xd_stream_end + XD_RL_STREAM_BLOCK_SIZE - 1) / XD_RL_STREAM_BLOCK_SIZE;
+  for (size_t word = from / XD_RL_STREAM_BLOCK_SIZE; word < words_end;
+       word++) {
+    // the whole block is read, the bytes past the end are masked off below
+    const char *block = xd_stream_buffer + word * XD_RL_STREAM_BLOCK_SIZE;
+    uint64_t bits = 0;
+#ifdef __SSE2__
+    __m128i newline = _mm_set1_epi8(XD_RL_ASCII_LF);
+    for (int i = 0; i < 4; i++) {
+      __m128i chunk = _mm_loadu_si128((const __m128i *)(block + i * 16));
+      bits |= (uint64_t)(uint16_t)_mm_movemask_epi8(
+                  _mm_cmpeq_epi8(chunk, newline))
+              << (i * 16);
     }
-
-    if (!is_valid_prefix) {
-      break;
+#else
+    for (int i = 0; i < XD_RL_STREAM_BLOCK_SIZE; i++) {
+      bits |= (uint64_t)(block[i] == XD_RL_ASCII_LF) << i;
     }
+#endif
+    xd_stream_newlines[word] = bits;
   }
-}  // xd_input_handle_escape_sequence()
+  if (xd_stream_end % XD_RL_STREAM_BLOCK_SIZE != 0) {
+    xd_stream_newlines[xd_stream_end / XD_RL_STREAM_BLOCK_SIZE] &=
+        (UINT64_C(1) << (xd_stream_end % XD_RL_STREAM_BLOCK_SIZE)) - 1;
+  }
+}  // xd_stream_index()
 
 /**
- * @brief Handles the case where the input is a control character.
+ * @brief Finds the first new-line at or after the passed index of the stream
+ * buffer using its new-line bitmap.
  *
- * @param chr The input character.
+ * @param idx The index to start looking from.
+ *
+ * @return The index of the new-line, or `xd_stream_end` if there is none.
  */
-static void xd_input_handle_control(char chr) {
-  if (xd_readline_mode != XD_READLINE_NORMAL) {
-    if (chr != XD_RL_ASCII_BS && chr != XD_RL_ASCII_DEL &&
-        chr != XD_RL_ASCII_DC2 && chr != XD_RL_ASCII_DC3) {
-      xd_readline_mode = XD_READLINE_NORMAL;
-      xd_readline_redraw = 1;
-      if (chr == XD_RL_ASCII_BEL) {
-        // `Ctrl+G` restore original input before starting reverse search
-        xd_history_nav_idx = xd_search_original_nav_idx;
-        xd_input_buffer_load_from_history();
-        xd_input_cursor = xd_search_original_input_cursor;
-        return;
-      }
-    }
+static size_t xd_stream_find_newline(size_t idx) {
+  if (idx >= xd_stream_end) {
+    return xd_stream_end;
   }
-  switch (chr) {
-    case XD_RL_ASCII_SOH:
-      xd_input_handle_ctrl_a();
-      break;
-    case XD_RL_ASCII_STX:
-      xd_input_handle_ctrl_b();
-      break;
-    case XD_RL_ASCII_EOT:
-      xd_input_handle_ctrl_d();
-      break;
-    case XD_RL_ASCII_ENQ:
-      xd_input_handle_ctrl_e();
-      break;
-    case XD_RL_ASCII_ACK:
-      xd_input_handle_ctrl_f();
-      break;
-    case XD_RL_ASCII_BEL:
-      xd_input_handle_ctrl_g();
-      break;
-    case XD_RL_ASCII_BS:
-      xd_input_handle_ctrl_h();
-      break;
-    case XD_RL_ASCII_HT:
-      xd_input_handle_tab();
-      break;
-    case XD_RL_ASCII_LF:
-      xd_input_handle_enter();
-      break;
-    case XD_RL_ASCII_VT:
-      xd_input_handle_ctrl_k();
-      break;
-    case XD_RL_ASCII_FF:
-      xd_input_handle_ctrl_l();
-      break;
-    case XD_RL_ASCII_DC2:
-      xd_input_handle_ctrl_r();
-      break;
-    case XD_RL_ASCII_DC3:
-      xd_input_handle_ctrl_s();
-      break;
-    case XD_RL_ASCII_NAK:
-      xd_input_handle_ctrl_u();
-      break;
-    case XD_RL_ASCII_ESC:
-      xd_input_handle_escape_sequence();
-      break;
-    case XD_RL_ASCII_DEL:
-      xd_input_handle_backspace();
-      break;
-    default:
-      break;
+  size_t words_end =
+      (xd_stream_end + XD_RL_STREAM_BLOCK_SIZE - 1) / XD_RL_STREAM_BLOCK_SIZE;
+  size_t word = idx / XD_RL_STREAM_BLOCK_SIZE;
+  uint64_t bits = xd_stream_newlines[word] &
+                  (~UINT64_C(0) << (idx % XD_RL_STREAM_BLOCK_SIZE));
+  while (bits == 0) {
+    if (++word == words_end) {
+      return xd_stream_end;
+    }
+    bits = xd_stream_newlines[word];
   }
-}  // xd_input_handle_control()
+  return word * XD_RL_STREAM_BLOCK_SIZE + (size_t)__builtin_ctzll(bits);
+}  // xd_stream_find_newline()
 
 /**
- * @brief Handles history reverse search.
+ * @brief Reads more input into the stream buffer, first making room for it by
+ * moving the data not returned yet to the beginning of the buffer, or by
+ * growing the buffer if that data fills it.
+ *
+ * @return The number of bytes read, `0` on end of file, or `-1` on failure
+ * with `errno` set.
  */
-static void xd_readline_history_reverse_search() {
-  if (xd_search_idx == XD_RL_SEARCH_IDX_NEW) {
-    xd_search_idx = xd_history_nav_idx;
-    return;
+static ssize_t xd_stream_fill() {
+  size_t pending = xd_stream_end - xd_stream_start;
+  if (pending == 0) {
+    // everything was returned, start over at the beginning
+    xd_stream_start = 0;
+    xd_stream_end = 0;
   }
-
-  if (xd_search_query_length == 0 ||
-      xd_search_idx == XD_RL_SEARCH_IDX_OUT_OF_BOUNDS) {
-    xd_search_prompt = XD_RL_REVERSE_SEARCH_PROMPT_FAILED;
-    xd_search_result_highlight_start = -1;
-    xd_readline_redraw = 1;
-    return;
+  else if (xd_stream_end == xd_stream_capacity && xd_stream_start > 0) {
+    memmove(xd_stream_buffer, xd_stream_buffer + xd_stream_start, pending);
+    xd_stream_start = 0;
+    xd_stream_end = pending;
+    xd_stream_index(0);
   }
 
-  int max_iterations = xd_history_length + 1;
-  const char *res = NULL;
-  for (int i = 0; i < max_iterations; i++) {
-    res = strstr(xd_history[xd_search_idx]->str, xd_search_query_buffer);
-    if (res != NULL || xd_search_idx == xd_history_start_idx) {
-      break;
+  // a long line grew the buffer, give the memory back once it is consumed
+  size_t capacity = xd_memory_shrink_target(xd_stream_capacity, xd_stream_end,
+                                            XD_RL_STREAM_BUFFER_SIZE);
+  if (capacity < xd_stream_capacity) {
+    int saved_errno = errno;
+    if (xd_stream_resize(capacity) == -1) {
+      // shrinking only gives memory back, the buffer is left unchanged and
+      // reading goes on with it
+      errno = saved_errno;
     }
-    if (xd_search_idx == XD_RL_HISTORY_MAX) {
-      xd_search_idx = xd_history_end_idx;
+  }
+
+  if (xd_stream_end == xd_stream_capacity) {
+    capacity = xd_memory_grow_target(xd_stream_capacity, pending, 1,
+                                     XD_RL_STREAM_BUFFER_SIZE);
+    if (capacity == 0) {
+      errno = ENOMEM;
+      return -1;
     }
-    else {
-      xd_search_idx =
-          (xd_search_idx - 1 + XD_RL_HISTORY_MAX) % XD_RL_HISTORY_MAX;
+    if (xd_stream_resize(capacity) == -1) {
+      return -1;
     }
   }
 
-  if (res == NULL) {
-    xd_search_prompt = XD_RL_REVERSE_SEARCH_PROMPT_FAILED;
-    xd_search_result_highlight_start = -1;
-    xd_search_idx = XD_RL_SEARCH_IDX_OUT_OF_BOUNDS;
-  }
-  else {
-    xd_history_nav_idx = xd_search_idx;
-    xd_input_buffer_load_from_history();
-    xd_search_prompt = XD_RL_REVERSE_SERACH_PROMPT;
-    xd_input_cursor = (int)(res - xd_history[xd_search_idx]->str);
-    xd_search_result_highlight_start = xd_input_cursor;
+  while (1) {
+    ssize_t ret = read(STDIN_FILENO, xd_stream_buffer + xd_stream_end,
+                       xd_stream_capacity - xd_stream_end);
+    if (ret == -1 && errno == EINTR) {
+      continue;
+    }
+    if (ret > 0) {
+      size_t from = xd_stream_end;
+      xd_stream_end += (size_t)ret;
+      xd_stream_index(from);
+    }
+    return ret;
   }
-  xd_readline_redraw = 1;
-}  // xd_readline_history_reverse_search()
+}  // xd_stream_fill()
 
 /**
- * @brief Handles history reverse search.
+ * @brief Reads a line from `stdin` when it is not used interactively, e.g. a
+ * script from a pipe or a file.
+ *
+ * Input is read in large blocks whose new-lines are indexed once, and lines
+ * are returned in place from the buffer without copying them, only the bytes
+ * of a line split across two blocks are moved.
+ *
+ * @return Pointer to the line read ending with a new-line, which is added if
+ * the input doesn't end with one, or `NULL` on end of file or failure with
+ * `errno` set.
  */
-static void xd_readline_history_forward_search() {
-  if (xd_search_idx == XD_RL_SEARCH_IDX_NEW) {
-    xd_search_idx = xd_history_nav_idx;
-    return;
+static char *xd_stream_read_line() {
+  if (xd_stream_buffer == NULL &&
+      xd_stream_resize(XD_RL_STREAM_BUFFER_SIZE) == -1) {
+    return NULL;
   }
-
-  if (xd_search_query_length == 0 ||
-      xd_search_idx == XD_RL_SEARCH_IDX_OUT_OF_BOUNDS) {
-    xd_search_prompt = XD_RL_FORWARD_SERACH_PROMPT_FAILED;
-    xd_search_result_highlight_start = -1;
-    xd_readline_redraw = 1;
-    return;
+  if (xd_stream_saved_char != -1) {
+    xd_stream_buffer[xd_stream_start] = (char)xd_stream_saved_char;
+    xd_stream_saved_char = -1;
   }
 
-  int max_iterations = xd_history_length + 1;
-  const char *res = NULL;
-  for (int i = 0; i < max_iterations; i++) {
-    res = strstr(xd_history[xd_search_idx]->str, xd_search_query_buffer);
-    if (res != NULL || xd_search_idx == XD_RL_HISTORY_MAX) {
-      break;
+  size_t scanned = 0;  // bytes after `xd_stream_start` known not to be `LF`
+  while (1) {
+    size_t newline = xd_stream_find_newline(xd_stream_start + scanned);
+    if (newline != xd_stream_end) {
+      char *line = xd_stream_buffer + xd_stream_start;
+      xd_readline_return_length = newline - xd_stream_start + 1;
+      xd_stream_start = newline + 1;
+      if (xd_readline_omit_newline) {
+        // the new-line is replaced, nothing after it is overwritten
+        xd_stream_buffer[newline] = XD_RL_ASCII_NUL;
+        xd_readline_return_length--;
+        return line;
+      }
+      xd_stream_saved_char = (unsigned char)xd_stream_buffer[xd_stream_start];
+      xd_stream_buffer[xd_stream_start] = XD_RL_ASCII_NUL;
+      return line;
     }
-    if (xd_search_idx == xd_history_end_idx) {
-      xd_search_idx = XD_RL_HISTORY_MAX;
+    scanned = xd_stream_end - xd_stream_start;
+
+    ssize_t ret = xd_stream_fill();
+    if (ret == -1) {
+      return NULL;
     }
-    else {
-      xd_search_idx = (xd_search_idx + 1) % XD_RL_HISTORY_MAX;
+    if (ret == 0) {
+      if (xd_stream_start == xd_stream_end) {
+        return NULL;
+      }
+      // the last line has no new-line, add one in the reserved bytes
+      xd_stream_buffer[xd_stream_end++] = XD_RL_ASCII_LF;
+      xd_stream_index(xd_stream_end - 1);
     }
   }
-
-  if (res == NULL) {
-    xd_search_prompt = XD_RL_FORWARD_SERACH_PROMPT_FAILED;
-    xd_search_result_highlight_start = -1;
-    xd_search_idx = XD_RL_SEARCH_IDX_OUT_OF_BOUNDS;
-  }
-  else {
-    xd_history_nav_idx = xd_search_idx;
-    xd_input_buffer_load_from_history();
-    xd_search_prompt = XD_RL_FORWARD_SERACH_PROMPT;
-    xd_input_cursor = (int)(res - xd_history[xd_search_idx]->str);
-    xd_search_result_highlight_start = xd_input_cursor;
-  }
-  xd_readline_redraw = 1;
-}  // xd_readline_history_forward_search()
+}  // xd_stream_read_line()
 
 /**
- * @brief Handles a signle input character.
- *
- * @param chr The input character.
+ * @brief Frees the stream buffer, discarding the input not returned yet.
  */
-static void xd_input_handler(char chr) {
-  if (isprint(chr)) {
-    xd_input_handle_printable(chr);
-  }
-  else if (iscntrl(chr)) {
-    xd_input_handle_control(chr);
+static void xd_stream_destroy() {
+  if (xd_stream_buffer == NULL) {
+    return;
   }
-}  // xd_input_handler()
+  xd_util_free(xd_stream_buffer);
+  xd_util_free(xd_stream_newlines);
+  xd_memory_account(XD_RL_MEMORY_INPUT, xd_stream_size(xd_stream_capacity), 0);
+  xd_stream_buffer = NULL;
+  xd_stream_newlines = NULL;
+  xd_stream_capacity = 0;
+  xd_stream_start = 0;
+  xd_stream_end = 0;
+  xd_stream_saved_char = -1;
+}  // xd_stream_destroy()
 
 /**
  * @brief handler for `SIGWINCH` signal.
@@ -1970,28 +7167,80 @@ static void xd_sigwinch_handler(int sig_num) {
   xd_tty_win_resized = 1;
 }  // xd_sigwinch_handler(int sig_num)
 
+/**
+ * @brief Installs the `SIGWINCH` handler for the duration of `xd_readline()`,
+ * saving the disposition it replaces, unless disabled by
+ * `xd_readline_init_ex()`.
+ */
+static void xd_sigwinch_install() {
+  xd_tty_win_resized = 0;
+  if (!xd_sigwinch_enabled) {
+    return;
+  }
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = xd_sigwinch_handler;
+  action.sa_flags = SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  xd_sigwinch_installed =
+      sigaction(SIGWINCH, &action, &xd_sigwinch_original_action) == 0;
+}  // xd_sigwinch_install()
+
+/**
+ * @brief Restores the `SIGWINCH` disposition replaced by
+ * `xd_sigwinch_install()`.
+ */
+static void xd_sigwinch_restore() {
+  if (!xd_sigwinch_installed) {
+    return;
+  }
+  sigaction(SIGWINCH, &xd_sigwinch_original_action, NULL);
+  xd_sigwinch_installed = 0;
+}  // xd_sigwinch_restore()
+
+
 // ========================
 // Public Functions
 // ========================
 
 char *xd_readline() {
-  if (xd_input_buffer == NULL) {
-    errno = ENOTTY;
+  if (xd_readline_lazy_init() == -1) {
+    return NULL;
+  }
+  // not interactive, read without editing, input already buffered is returned
+  // first and saves checking the terminal for every line
+  if (xd_stream_end > xd_stream_start || !isatty(STDIN_FILENO) ||
+      !isatty(STDOUT_FILENO)) {
+    return xd_stream_read_line();
+  }
+
+  // the bindings changed since the last line was read
+  if (xd_keymap_dirty && xd_keymap_compile() == -1) {
+    errno = ENOMEM;
     return NULL;
   }
+  xd_keymap_macro = NULL;
 
   if (xd_readline_prompt != NULL) {
-    xd_readline_prompt_length = (int)strlen(xd_readline_prompt);
+    xd_readline_prompt_length = strlen(xd_readline_prompt);
   }
   else {
     xd_readline_prompt_length = 0;
   }
 
+  if (xd_readline_word_chars != xd_char_class_word_chars) {
+    xd_util_char_class_init(xd_readline_word_chars);
+  }
+
+  // the line returned by the previous call is no longer needed
+  xd_memory_shrink();
+
   xd_readline_mode = XD_READLINE_NORMAL;
 
   xd_input_cursor = 0;
   xd_input_length = 0;
   xd_input_buffer[0] = XD_RL_ASCII_NUL;
+  xd_input_buffer_invalidate(0);
 
   xd_readline_redraw = 1;
   xd_readline_return = xd_input_buffer;
@@ -2000,13 +7249,37 @@ char *xd_readline() {
   xd_tty_cursor_row = 1;
   xd_tty_cursor_col = 1;
   xd_tty_chars_count = 0;
+  xd_tty_lines_drawn = 0;
+
+  memset(&xd_tty_sgr_wanted, 0, sizeof(xd_tty_sgr_t));
+  xd_tty_sgr_current = xd_tty_sgr_wanted;
+  xd_tty_sgr_verbatim = 1;
 
   xd_history_nav_idx = XD_RL_HISTORY_MAX;
 
-  xd_tty_raw();
+#if XD_RL_ENABLE_SUGGESTION
+  xd_suggestion =
+      xd_readline_suggest_next_command ? xd_readline_predict_next() : NULL;
+#endif
+  xd_suggestion_visible = 0;
+
+  // the window may have been resized since the last call
+  xd_tty_win_width_update();
+  xd_sigwinch_install();
+
+  if (xd_tty_raw() == -1) {
+    xd_sigwinch_restore();
+    return NULL;
+  }
 
   xd_tty_cursor_fix_initial_pos();
 
+  int kitty_keyboard = xd_readline_kitty_keyboard &&
+                       (xd_tty_caps & XD_RL_TTY_CAP_KITTY_KEYS);
+  if (kitty_keyboard) {
+    xd_tty_write(XD_RL_ANSI_KITTY_PUSH, strlen(XD_RL_ANSI_KITTY_PUSH));
+  }
+
   char chr = XD_RL_ASCII_NUL;
   while (!xd_readline_finished) {
     if (xd_tty_win_resized) {
@@ -2018,40 +7291,62 @@ char *xd_readline() {
       xd_tty_input_redraw();
       xd_readline_redraw = 0;
     }
+    // the input is displayed as is, the next edits are repainted from here
+    xd_input_dirty_idx = SIZE_MAX;
 
-    // expand the input buffer
-    if (xd_input_length == xd_input_capacity - 1) {
-      char *ptr = (char *)realloc(xd_input_buffer,
-                                  sizeof(char) * xd_input_capacity * 2);
-      if (ptr == NULL) {
-        break;
-      }
-      xd_input_capacity *= 2;
-      xd_input_buffer = ptr;
-      xd_readline_return = xd_input_buffer;
-    }
+    // expand the input buffer to fit the longest UTF-8 sequence
+    // on failure insertions are refused until the input gets shorter
+    xd_input_buffer_reserve(XD_RL_UTF8_SEQ_MAX);
+    xd_readline_return = xd_input_buffer;
 
     xd_readline_prev_read_char = chr;
 
+    // show the frame before waiting for the next key, typed ahead or pasted
+    // keys are handled first and share it
+    if (!xd_input_byte_ready(0)) {
+      xd_tty_flush();
+    }
+
     // read one character
-    ssize_t ret = read(STDIN_FILENO, &chr, 1);
+    ssize_t ret = xd_input_read_byte(&chr);
+
+    // interrupted by a signal handler installed without `SA_RESTART`
+    if (ret == -1 && errno == EINTR) {
+      chr = xd_readline_prev_read_char;
+      continue;
+    }
 
     // EOF or Error while reading
     if (ret <= 0) {
-      xd_tty_cursor_move_right_wrap(xd_input_length - xd_input_cursor);
+      xd_tty_cursor_move_input(xd_input_cursor, xd_input_length);
       xd_readline_finished = 1;
       xd_readline_return = NULL;
       continue;
     }
 
+#ifdef XD_RL_DEBUG_ALLOCS
+    xd_debug_keystroke_allocs = 0;
+#endif
+
     xd_input_handler(chr);
 
+#if XD_RL_ENABLE_SEARCH
     if (xd_readline_mode == XD_READLINE_REVERSE_SEARCH) {
       xd_readline_history_reverse_search();
     }
     else if (xd_readline_mode == XD_READLINE_FORWARD_SEARCH) {
       xd_readline_history_forward_search();
     }
+#endif
+
+#ifdef XD_RL_DEBUG_ALLOCS
+    xd_readline_debug_keystroke_allocs += xd_debug_keystroke_allocs;
+#endif
+  }
+
+  if (xd_suggestion_visible) {
+    // erase the suggestion displayed after the cursor
+    xd_tty_write_ansii_sequence(XD_RL_ANSI_CLR_BELOW);
   }
 
   if (xd_tty_cursor_col != 1) {
@@ -2059,68 +7354,131 @@ char *xd_readline() {
     xd_tty_write(&chr, 1);
   }
 
+  // the input buffer may have been moved while reading
+  if (xd_readline_return != NULL) {
+    xd_readline_return = xd_input_buffer;
+    if (xd_readline_omit_newline) {
+      xd_input_buffer[--xd_input_length] = XD_RL_ASCII_NUL;
+    }
+    xd_readline_return_length = xd_input_length;
+  }
+
+  if (kitty_keyboard) {
+    xd_tty_write(XD_RL_ANSI_KITTY_POP, strlen(XD_RL_ANSI_KITTY_POP));
+  }
+  xd_tty_flush();
   xd_tty_restore();
+  xd_sigwinch_restore();
+  xd_arena_reset();
   return xd_readline_return;
 }  // xd_readline()
 
-void xd_readline_history_clear() {
-  for (int i = 0; i <= XD_RL_HISTORY_MAX; i++) {
-    xd_history[i]->length = 0;
-    xd_history[i]->str[0] = XD_RL_ASCII_NUL;
+ssize_t xd_readline_n(char **buf, size_t *cap) {
+  if (buf == NULL || cap == NULL) {
+    errno = EINVAL;
+    return -1;
   }
-  xd_history_nav_idx = XD_RL_HISTORY_MAX;
-  xd_history_start_idx = 0;
-  xd_history_end_idx = XD_RL_HISTORY_MAX - 1;
-  xd_history_length = 0;
-}  // xd_readline_history_clear()
-
-int xd_readline_history_add(const char *str) {
-  if (str == NULL) {
+  char *line = xd_readline();
+  if (line == NULL) {
     return -1;
   }
+  size_t length = xd_readline_return_length;
 
-  // ignore the trailing newline at the end
-  int str_length = (int)strlen(str);
-  if (str_length > 0 && str[str_length - 1] == XD_RL_ASCII_LF) {
-    str_length--;
+  // an edited line is handed over whole in exchange for the caller's buffer
+  if (line == xd_input_buffer && xd_input_buffer_exchange(buf, cap) == 0) {
+    return (ssize_t)length;
   }
 
-  int new_end_idx = (xd_history_end_idx + 1) % XD_RL_HISTORY_MAX;
-  xd_history_entry_t *history_entry = xd_history[new_end_idx];
-
-  // resize the history entry string if needed
-  if (str_length > history_entry->capacity - 1) {
-    // resize to multiple of `LINE_MAX`
-    int new_capacity = str_length + 1;
-    if (new_capacity % LINE_MAX != 0) {
-      new_capacity += LINE_MAX - (new_capacity % LINE_MAX);
-    }
-
+  // the stream buffer holds the lines after this one too, so it is copied
+  if (*buf == NULL || *cap <= length) {
+    size_t capacity =
+        xd_memory_grow_target(*buf == NULL ? 0 : *cap, length, 1, LINE_MAX);
     char *ptr =
-        (char *)realloc(history_entry->str, sizeof(char) * new_capacity);
+        capacity == 0 ? NULL : (char *)xd_util_realloc(*buf, capacity);
     if (ptr == NULL) {
-      fprintf(stderr, "xd_readline: failed to allocate memory: %s\n",
-              strerror(errno));
+      errno = ENOMEM;
       return -1;
     }
-    history_entry->capacity = new_capacity;
-    history_entry->str = ptr;
+    *buf = ptr;
+    *cap = capacity;
   }
-
-  // add to history
-  if (xd_history_length < XD_RL_HISTORY_MAX) {
-    xd_history_length++;
+  memcpy(*buf, line, length + 1);
+  return (ssize_t)length;
+}  // xd_readline_n()
+
+void *xd_readline_scratch_alloc(size_t size) {
+  return xd_arena_alloc(size);
+}  // xd_readline_scratch_alloc()
+
+int xd_readline_memory_get_usage(xd_readline_memory_subsystem_t subsystem,
+                                 xd_readline_memory_usage_t *usage) {
+  if (subsystem < XD_RL_MEMORY_INPUT || subsystem > XD_RL_MEMORY_TOTAL ||
+      usage == NULL) {
+    return -1;
   }
-  else {
-    // circular buffer is full, overwrite the oldest entry
-    xd_history_start_idx = (xd_history_start_idx + 1) % XD_RL_HISTORY_MAX;
+  *usage = xd_memory_usage[subsystem];
+  return 0;
+}  // xd_readline_memory_get_usage()
+
+int xd_readline_set_allocator(xd_readline_alloc_func_t alloc_func,
+                              xd_readline_realloc_func_t realloc_func,
+                              xd_readline_free_func_t free_func, void *user) {
+  // everything allocated so far must be released with the same allocator
+  if (xd_readline_initialized) {
+    errno = EBUSY;
+    return -1;
   }
-  xd_history_end_idx = new_end_idx;
-  memcpy(history_entry->str, str, str_length);
-  history_entry->str[str_length] = XD_RL_ASCII_NUL;
-  history_entry->length = str_length;
 
+  if (alloc_func == NULL || realloc_func == NULL || free_func == NULL) {
+    alloc_func = NULL;
+    realloc_func = NULL;
+    free_func = NULL;
+    user = NULL;
+  }
+  xd_alloc_func = alloc_func;
+  xd_realloc_func = realloc_func;
+  xd_free_func = free_func;
+  xd_alloc_user = user;
   return 0;
+}  // xd_readline_set_allocator()
+
+int xd_readline_init_ex(const xd_readline_init_opts_t *opts) {
+  if (xd_readline_initialized) {
+    errno = EALREADY;
+    return -1;
+  }
+  if (opts != NULL) {
+    if (xd_readline_set_allocator(opts->alloc_func, opts->realloc_func,
+                                  opts->free_func, opts->alloc_user) == -1) {
+      return -1;
+    }
+    xd_sigwinch_enabled = !opts->no_sigwinch_handler;
+  }
+  return xd_readline_lazy_init();
+}  // xd_readline_init_ex()
+
+void xd_readline_history_clear() {
+  if (xd_history == NULL) {
+    return;
+  }
+  for (int i = 0; i <= XD_RL_HISTORY_MAX; i++) {
+    xd_history_entry_reset(xd_history[i]);
+  }
+  xd_history_nav_idx = XD_RL_HISTORY_MAX;
+  xd_history_start_idx = 0;
+  xd_history_end_idx = XD_RL_HISTORY_MAX - 1;
+  xd_history_length = 0;
+  xd_history_bytes = 0;
+#if XD_RL_ENABLE_SUGGESTION
+  xd_readline_predict_reset();
+#endif
+}  // xd_readline_history_clear()
+
+int xd_readline_history_add(const char *str) {
+  if (str == NULL) {
+    return -1;
+  }
+  return xd_readline_history_add_n(str, strlen(str));
 }  // xd_readline_history_add()
 
 char *xd_readline_history_get(int n) {
@@ -2141,7 +7499,7 @@ char *xd_readline_history_get(int n) {
     return NULL;
   }
 
-  char *ptr = strdup(xd_history[idx]->str);
+  char *ptr = xd_util_strndup(xd_history[idx]->str, xd_history[idx]->length);
   if (ptr == NULL) {
     fprintf(stderr, "xd_readline: failed to allocate memory: %s\n",
             strerror(errno));
@@ -2165,24 +7523,62 @@ int xd_readline_history_save_to_file(const char *path, int append) {
   }
   int idx = xd_history_start_idx;
   for (int i = 0; i < xd_history_length; i++) {
-    fprintf(file, "%s\n", xd_history[idx]->str);
+    xd_history_entry_write(xd_history[idx], file);
     idx = (idx + 1) % XD_RL_HISTORY_MAX;
   }
   fclose(file);
   return 0;
 }  // xd_readline_history_save_to_file()
 
+int xd_readline_bind(const char *sequence, xd_readline_action_t action) {
+  if (xd_readline_lazy_init() == -1) {
+    return -1;
+  }
+  return xd_keymap_set(sequence, action, NULL);
+}  // xd_readline_bind()
+
+int xd_readline_bind_macro(const char *sequence, const char *text) {
+  if (text == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (xd_readline_lazy_init() == -1) {
+    return -1;
+  }
+  return xd_keymap_set(sequence, XD_RL_ACTION_NONE, text);
+}  // xd_readline_bind_macro()
+
+int xd_readline_bindings_load_from_file(const char *path) {
+  if (path == NULL || xd_readline_lazy_init() == -1) {
+    return -1;
+  }
+  return xd_keymap_load_file(path, 1);
+}  // xd_readline_bindings_load_from_file()
+
 int xd_readline_history_load_from_file(const char *path) {
   FILE *file = fopen(path, "r");
   if (file == NULL) {
     return -1;
   }
+  // only the last `XD_RL_HISTORY_MAX` records can fit in the history, skip
+  // the rest of the file instead of adding and evicting them one by one, the
+  // newlines of the entries are escaped so each line is one record
+  off_t offset = xd_util_file_tail_offset(file, XD_RL_HISTORY_MAX);
+  if (offset > 0 && fseeko(file, offset, SEEK_SET) == -1) {
+    fclose(file);
+    return -1;
+  }
   char *line = NULL;
-  size_t size = 0;
-  while (getline(&line, &size, file) != -1) {
-    xd_readline_history_add(line);
+  size_t capacity = 0;
+  ssize_t length;
+  while ((length = xd_util_read_line(file, &line, &capacity)) != -1) {
+    if (line[length - 1] == XD_RL_ASCII_LF) {
+      length--;
+    }
+    xd_readline_history_add_n(
+        line, xd_history_record_unescape(line, (size_t)length));
   }
-  free(line);
+  xd_util_free(line);
   fclose(file);
   return 0;
 }  // xd_readline_history_load_from_file()
@@ -0,0 +1,275 @@
+/*
+ * ==============================================================================
+ * File: bench_history.c
+ * Author: Duraid Maihoub
+ * Date: 18 October 2026
+ * Description: Part of the xd-readline project.
+ * Repository: https://github.com/xduraid/xd-readline
+ * ==============================================================================
+ * Copyright (c) 2026 Duraid Maihoub
+ *
+ * xd-readline is distributed under the MIT License. See the LICENSE file
+ * for more information.
+ * ==============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "xd_readline.h"
+#include "xd_test.h"
+
+// ========================
+// Macros
+// ========================
+
+/**
+ * @brief Number of entries the history is filled with.
+ */
+#define XD_BENCH_ENTRIES (XD_RL_HISTORY_MAX)
+
+/**
+ * @brief Number of times the history is filled over when timing additions.
+ */
+#define XD_BENCH_ADD_ROUNDS (20)
+
+/**
+ * @brief Number of lines of the history file loaded, relative to the number
+ * of entries the history holds.
+ */
+#define XD_BENCH_FILE_ROUNDS (100)
+
+/**
+ * @brief Number of searches timed.
+ */
+#define XD_BENCH_SEARCHES (2000)
+
+/**
+ * @brief Number of times the searches are timed, the fastest time is kept.
+ */
+#define XD_BENCH_SEARCH_RUNS (3)
+
+/**
+ * @brief A search which fails after scanning every entry, each entry holds
+ * the bytes of the query but not the query itself.
+ */
+#define XD_BENCH_SEARCH_KEYS "\022eu\007"
+
+// ========================
+// Function Definitions
+// ========================
+
+/**
+ * @brief Writes the passed history entry to a buffer.
+ *
+ * @param buffer The buffer to write the entry to.
+ * @param size The size of the buffer.
+ * @param long_entry Whether the entry is too long to be stored inline.
+ * @param n The number of the entry.
+ */
+static void xd_bench_entry(char *buffer, size_t size, int long_entry, int n) {
+  if (long_entry) {
+    snprintf(buffer, size,
+             "cmd%d --flag value%d --output /var/tmp/results/run-%d.log", n,
+             n, n);
+  }
+  else {
+    snprintf(buffer, size, "cmd%d --flag value%d", n, n);
+  }
+}  // xd_bench_entry()
+
+/**
+ * @brief Returns the number of bytes allocated for the history.
+ */
+static size_t xd_bench_history_bytes() {
+  xd_readline_memory_usage_t usage;
+  xd_readline_memory_get_usage(XD_RL_MEMORY_HISTORY, &usage);
+  return usage.current;
+}  // xd_bench_history_bytes()
+
+/**
+ * @brief Reports the memory taken by a full history where `distinct` entries
+ * cycle, per entry and in total.
+ *
+ * @param name The name of the measurement.
+ * @param long_entry Whether the entries are too long to be stored inline.
+ * @param distinct The number of distinct entries.
+ */
+static void xd_bench_memory(const char *name, int long_entry, int distinct) {
+  char entry[256];
+  xd_readline_history_clear();
+  for (int i = 0; i < XD_BENCH_ENTRIES; i++) {
+    xd_bench_entry(entry, sizeof(entry), long_entry, i % distinct);
+    xd_readline_history_add(entry);
+  }
+  size_t bytes = xd_bench_history_bytes();
+  printf("%-32s %10.1f bytes/entry (%zu bytes)\n", name,
+         (double)bytes / XD_BENCH_ENTRIES, bytes);
+}  // xd_bench_memory()
+
+/**
+ * @brief Reports the time taken to add an entry to a full history with the
+ * passed eviction policy.
+ *
+ * @param name The name of the measurement.
+ * @param eviction The eviction policy.
+ */
+static void xd_bench_add(const char *name,
+                         xd_readline_history_eviction_t eviction) {
+  char entry[256];
+  xd_readline_history_eviction = eviction;
+  xd_readline_history_clear();
+  long long start = xd_test_now_ns();
+  for (int i = 0; i < XD_BENCH_ENTRIES * XD_BENCH_ADD_ROUNDS; i++) {
+    xd_bench_entry(entry, sizeof(entry), i % 4 == 0, i % 50);
+    xd_readline_history_add(entry);
+  }
+  long long elapsed = xd_test_now_ns() - start;
+  printf("%-32s %10.1f ns/entry\n", name,
+         (double)elapsed / (XD_BENCH_ENTRIES * XD_BENCH_ADD_ROUNDS));
+  xd_readline_history_eviction = XD_RL_HISTORY_EVICT_FIFO;
+}  // xd_bench_add()
+
+/**
+ * @brief Reports the time taken to load the history from a file many times
+ * longer than the history.
+ */
+static void xd_bench_load() {
+  char path[] = "/tmp/xd_bench_history_XXXXXX";
+  int fd = mkstemp(path);
+  FILE *file = fd == -1 ? NULL : fdopen(fd, "w");
+  if (file == NULL) {
+    perror("bench_history: mkstemp");
+    return;
+  }
+  char entry[256];
+  for (int i = 0; i < XD_BENCH_ENTRIES * XD_BENCH_FILE_ROUNDS; i++) {
+    xd_bench_entry(entry, sizeof(entry), i % 4 == 0, i);
+    fprintf(file, "%s\n", entry);
+  }
+  fclose(file);
+
+  xd_readline_history_clear();
+  long long start = xd_test_now_ns();
+  xd_readline_history_load_from_file(path);
+  long long elapsed = xd_test_now_ns() - start;
+  unlink(path);
+  printf("%-32s %10.1f us (%d lines)\n", "load file", (double)elapsed / 1000,
+         XD_BENCH_ENTRIES * XD_BENCH_FILE_ROUNDS);
+}  // xd_bench_load()
+
+#if XD_RL_ENABLE_SEARCH
+
+/**
+ * @brief Fills the history then reads one line and writes the CPU time it
+ * took, run on a pseudo-terminal.
+ *
+ * The CPU time doesn't include waiting for the keystrokes, which would hide
+ * the time taken by the search itself.
+ *
+ * @param arg Pointer to the number of entries to fill the history with.
+ *
+ * @return The exit status.
+ */
+static int xd_bench_search_child(void *arg) {
+  char entry[256];
+  int entries = *(int *)arg;
+  xd_readline_history_clear();
+  for (int i = 0; i < entries; i++) {
+    xd_bench_entry(entry, sizeof(entry), i % 4 == 0, i);
+    xd_readline_history_add(entry);
+  }
+  xd_readline_prompt = "> ";
+  struct timespec start;
+  struct timespec end;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &start);
+  char *line = xd_readline();
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &end);
+  printf("[cpu %lld]\n",
+         ((long long)(end.tv_sec - start.tv_sec) * 1000000000LL) +
+             (end.tv_nsec - start.tv_nsec));
+  return line == NULL;
+}  // xd_bench_search_child()
+
+/**
+ * @brief Times the searches through a history of the passed number of
+ * entries, including reading and displaying the keystrokes.
+ *
+ * @param entries The number of entries in the history.
+ *
+ * @return The CPU time taken in nanoseconds, or `-1` on failure.
+ */
+static long long xd_bench_search_time(int entries) {
+  static char keys[XD_BENCH_SEARCHES * sizeof(XD_BENCH_SEARCH_KEYS)];
+  size_t length = 0;
+  for (int i = 0; i < XD_BENCH_SEARCHES; i++) {
+    memcpy(keys + length, XD_BENCH_SEARCH_KEYS,
+           strlen(XD_BENCH_SEARCH_KEYS));
+    length += strlen(XD_BENCH_SEARCH_KEYS);
+  }
+
+  xd_test_pty_t pty;
+  if (xd_test_pty_spawn(&pty, xd_bench_search_child, &entries) == -1) {
+    return -1;
+  }
+  long long elapsed = -1;
+  if (xd_test_pty_expect(&pty, "> ") == 0 &&
+      xd_test_pty_send(&pty, keys, length) == 0 &&
+      xd_test_pty_send(&pty, "\n", 1) == 0 &&
+      xd_test_pty_expect(&pty, "[cpu ") == 0) {
+    size_t time_offset = pty.mark;
+    if (xd_test_pty_expect(&pty, "]") == 0) {
+      elapsed = strtoll(pty.output + time_offset, NULL, 10);
+    }
+  }
+  xd_test_pty_close(&pty);
+  return elapsed;
+}  // xd_bench_search_time()
+
+/**
+ * @brief Reports the time taken by a search scanning the whole history, from
+ * the time taken by the same keystrokes with an empty history.
+ */
+static void xd_bench_search() {
+  long long empty = -1;
+  long long full = -1;
+  for (int i = 0; i < XD_BENCH_SEARCH_RUNS; i++) {
+    long long time = xd_bench_search_time(0);
+    if (time == -1) {
+      fprintf(stderr, "bench_history: search timed out\n");
+      return;
+    }
+    empty = empty == -1 || time < empty ? time : empty;
+    time = xd_bench_search_time(XD_BENCH_ENTRIES);
+    if (time == -1) {
+      fprintf(stderr, "bench_history: search timed out\n");
+      return;
+    }
+    full = full == -1 || time < full ? time : full;
+  }
+  printf("%-32s %10.1f us/search\n", "search (empty history)",
+         (double)empty / XD_BENCH_SEARCHES / 1000);
+  printf("%-32s %10.1f us/search\n", "search (history scan)",
+         (double)(full > empty ? full - empty : 0) / XD_BENCH_SEARCHES /
+             1000);
+}  // xd_bench_search()
+
+#endif  // XD_RL_ENABLE_SEARCH
+
+int main() {
+  printf("history benchmark, %d entries\n", XD_BENCH_ENTRIES);
+  xd_bench_memory("memory (short entries)", 0, XD_BENCH_ENTRIES);
+  xd_bench_memory("memory (long entries)", 1, XD_BENCH_ENTRIES);
+  xd_bench_memory("memory (5 long entries cycling)", 1, 5);
+  xd_bench_add("add (fifo eviction)", XD_RL_HISTORY_EVICT_FIFO);
+  xd_bench_add("add (frequency eviction)", XD_RL_HISTORY_EVICT_FREQUENCY);
+  xd_bench_load();
+#if XD_RL_ENABLE_SEARCH
+  xd_bench_search();
+#endif
+  xd_readline_history_clear();
+  return 0;
+}  // main()
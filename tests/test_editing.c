@@ -0,0 +1,426 @@
+/*
+ * ==============================================================================
+ * File: test_editing.c
+ * Author: Duraid Maihoub
+ * Date: 18 October 2026
+ * Description: Part of the xd-readline project.
+ * Repository: https://github.com/xduraid/xd-readline
+ * ==============================================================================
+ * Copyright (c) 2026 Duraid Maihoub
+ *
+ * xd-readline is distributed under the MIT License. See the LICENSE file
+ * for more information.
+ * ==============================================================================
+ */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "xd_readline.h"
+#include "xd_test.h"
+
+// ========================
+// Macros
+// ========================
+
+/**
+ * @brief Escape timeout in milliseconds set by the escape timeout test.
+ */
+#define XD_TEST_ESC_TIMEOUT_MS (50)
+
+/**
+ * @brief Time in milliseconds the escape timeout test pauses for after a lone
+ * `Esc`, long enough for the timeout to expire.
+ */
+#define XD_TEST_ESC_PAUSE_MS (300)
+
+// ========================
+// Typedefs
+// ========================
+
+/**
+ * @brief A line typed on a pseudo-terminal, and the output expected for it.
+ */
+typedef struct xd_test_case_t {
+  const char *name;         // The name reported for the case.
+  void (*setup)();          // Configures the library before reading, or NULL.
+  const char *keys;         // The keys typed.
+  const char *keys_paused;  // The keys typed after a pause, or NULL.
+  const char *expected[2];  // The texts expected in order, or NULL.
+} xd_test_case_t;
+
+// ========================
+// Function Declarations
+// ========================
+
+#if XD_RL_ENABLE_SEARCH || XD_RL_ENABLE_SUGGESTION
+static void xd_test_setup_history();
+#endif
+#if XD_RL_ENABLE_COMPLETION
+static void xd_test_setup_completion();
+#endif
+#if XD_RL_ENABLE_SUGGESTION
+static void xd_test_setup_suggestion();
+#endif
+static void xd_test_setup_esc_timeout();
+static void xd_test_setup_multi_line();
+
+// ========================
+// Variables
+// ========================
+
+/**
+ * @brief The lines typed, each on a new process.
+ */
+static const xd_test_case_t xd_test_cases[] = {
+    {"utf-8 cursor motion", NULL, "a\xe4\xb8\x96" "b\033[D\033[Dx\n", NULL,
+     {"[line ax\xe4\xb8\x96" "b]", NULL}},
+    {"utf-8 backspace", NULL, "a\xe4\xb8\x96\177" "b\n", NULL,
+     {"[line ab]", NULL}},
+    // moving left over a wide character moves the cursor two columns
+    {"utf-8 width", NULL, "\xe4\xb8\x96\033[D", NULL, {"\b\b", NULL}},
+#if XD_RL_ENABLE_SEARCH
+    {"reverse search", xd_test_setup_history, "\022stat\n", NULL,
+     {"[line git status]", NULL}},
+    {"forward search", xd_test_setup_history, "\033[1;5A\023com\n", NULL,
+     {"[line git commit]", NULL}},
+#endif
+#if XD_RL_ENABLE_COMPLETION
+    {"completion", xd_test_setup_completion, "gr\t\n", NULL,
+     {"[line green.txt ]", NULL}},
+    {"completion prefix", xd_test_setup_completion, "b\t\n", NULL,
+     {"[line bl]", NULL}},
+#endif
+#if XD_RL_ENABLE_COMPLETION && XD_RL_ENABLE_COMPLETION_LIST
+    {"completion list", xd_test_setup_completion, "bl\t\t\025x\n", NULL,
+     {"blue.txt", "[line x]"}},
+#endif
+#if XD_RL_ENABLE_SUGGESTION
+    {"suggestion", xd_test_setup_suggestion, "\033[C\n", NULL,
+     {"[line make]", NULL}},
+#endif
+    {"escape sequence", xd_test_setup_esc_timeout, "ab\033[Dc\n", NULL,
+     {"[line acb]", NULL}},
+    {"escape timeout", xd_test_setup_esc_timeout, "ab\033", "[Dc\n",
+     {"[line ab[Dc]", NULL}},
+    {"kitty keys", NULL, "bc\033[97;5ua\033[120u\n", NULL,
+     {"[line axbc]", NULL}},
+    {"multi-line", xd_test_setup_multi_line, "echo a\\\nb\n", NULL,
+     {"[line echo a\\|b]", NULL}},
+    {"multi-line motion", xd_test_setup_multi_line, "ab\\\ncd\033[Ax\n", NULL,
+     {"[line abx\\|cd]", NULL}},
+};
+
+// ========================
+// Function Definitions
+// ========================
+
+#if XD_RL_ENABLE_SEARCH || XD_RL_ENABLE_SUGGESTION
+/**
+ * @brief Fills the history with a few commands.
+ */
+static void xd_test_setup_history() {
+  xd_readline_history_add("git status");
+  xd_readline_history_add("make");
+  xd_readline_history_add("git commit");
+}  // xd_test_setup_history()
+#endif
+
+#if XD_RL_ENABLE_COMPLETION
+/**
+ * @brief Completes the file names starting with the word before the cursor.
+ *
+ * @param line The whole line being read.
+ * @param start Start position of the word within the line.
+ * @param end End position of the word within the line.
+ *
+ * @return The matching file names, see `xd_readline_completions_generator`.
+ */
+static char **xd_test_complete(const char *line, int start, int end) {
+  static const char *names[] = {"black.txt", "blue.txt", "green.txt"};
+  size_t count = sizeof(names) / sizeof(names[0]);
+  char **completions = (char **)malloc(sizeof(char *) * (count + 1));
+  if (completions == NULL) {
+    return NULL;
+  }
+  size_t matches = 0;
+  for (size_t i = 0; i < count; i++) {
+    if (strncmp(names[i], line + start, (size_t)(end - start)) == 0) {
+      completions[matches++] = strdup(names[i]);
+    }
+  }
+  completions[matches] = NULL;
+  return completions;
+}  // xd_test_complete()
+
+/**
+ * @brief Sets the completions generator.
+ */
+static void xd_test_setup_completion() {
+  xd_readline_completions_generator = xd_test_complete;
+}  // xd_test_setup_completion()
+#endif
+
+#if XD_RL_ENABLE_SUGGESTION
+/**
+ * @brief Fills the history so that `make` follows the last command.
+ */
+static void xd_test_setup_suggestion() {
+  xd_test_setup_history();
+  xd_readline_history_add("git status");
+  xd_readline_suggest_next_command = 1;
+}  // xd_test_setup_suggestion()
+#endif
+
+/**
+ * @brief Sets a short escape timeout.
+ */
+static void xd_test_setup_esc_timeout() {
+  xd_readline_esc_timeout_ms = XD_TEST_ESC_TIMEOUT_MS;
+}  // xd_test_setup_esc_timeout()
+
+/**
+ * @brief Checks whether the input is complete, i.e. doesn't end with `\`.
+ *
+ * @param input The input read so far.
+ *
+ * @return Non-zero if the input is complete or zero otherwise.
+ */
+static int xd_test_input_complete(const char *input) {
+  size_t length = strlen(input);
+  return length == 0 || input[length - 1] != '\\';
+}  // xd_test_input_complete()
+
+/**
+ * @brief Continues the input on a new line after a trailing `\`.
+ */
+static void xd_test_setup_multi_line() {
+  xd_readline_input_complete = xd_test_input_complete;
+}  // xd_test_setup_multi_line()
+
+/**
+ * @brief Reads lines and writes them between brackets, with their new-lines as
+ * `|`, until end of file, run on a pseudo-terminal.
+ *
+ * @param arg The test case.
+ *
+ * @return The exit status.
+ */
+static int xd_test_child(void *arg) {
+  const xd_test_case_t *test_case = (const xd_test_case_t *)arg;
+  // `Ctrl+S` stops the output unless flow control is disabled
+  struct termios attributes;
+  if (tcgetattr(STDIN_FILENO, &attributes) == 0) {
+    attributes.c_iflag &= ~IXON;
+    tcsetattr(STDIN_FILENO, TCSANOW, &attributes);
+  }
+  if (test_case->setup != NULL) {
+    test_case->setup();
+  }
+  xd_readline_prompt = "> ";
+  char *line;
+  while ((line = xd_readline()) != NULL) {
+    size_t length = strlen(line);
+    if (length > 0 && line[length - 1] == '\n') {
+      length--;
+    }
+    printf("[line ");
+    for (size_t i = 0; i < length; i++) {
+      putchar(line[i] == '\n' ? '|' : line[i]);
+    }
+    printf("]\n");
+    fflush(stdout);
+  }
+  return 0;
+}  // xd_test_child()
+
+/**
+ * @brief Types the keys of the passed case on a new process and checks its
+ * output.
+ *
+ * @param test_case The test case.
+ */
+static void xd_test_run(const xd_test_case_t *test_case) {
+  xd_test_pty_t pty;
+  if (!XD_TEST_CHECK(xd_test_pty_spawn(&pty, xd_test_child,
+                                       (void *)test_case) == 0)) {
+    return;
+  }
+  int ok = xd_test_pty_expect(&pty, "> ") == 0 &&
+           xd_test_pty_send(&pty, test_case->keys,
+                            strlen(test_case->keys)) == 0;
+  if (ok && test_case->keys_paused != NULL) {
+    struct timespec pause = {.tv_sec = 0,
+                             .tv_nsec = XD_TEST_ESC_PAUSE_MS * 1000000L};
+    nanosleep(&pause, NULL);
+    ok = xd_test_pty_send(&pty, test_case->keys_paused,
+                          strlen(test_case->keys_paused)) == 0;
+  }
+  for (int i = 0; i < 2 && ok && test_case->expected[i] != NULL; i++) {
+    ok = xd_test_pty_expect(&pty, test_case->expected[i]) == 0;
+  }
+  if (!XD_TEST_CHECK(ok)) {
+    fprintf(stderr, "  in case: %s\n", test_case->name);
+  }
+  XD_TEST_CHECK(xd_test_pty_close(&pty) == 0);
+}  // xd_test_run()
+
+/**
+ * @brief Recalls the oldest history entry and accepts it, then adds an entry
+ * to the full history, run on a pseudo-terminal.
+ *
+ * @param arg The eviction policy.
+ *
+ * @return The exit status.
+ */
+static int xd_test_eviction_child(void *arg) {
+  xd_readline_history_eviction = *(const xd_readline_history_eviction_t *)arg;
+  char entry[32];
+  for (int i = 0; i < XD_RL_HISTORY_MAX; i++) {
+    snprintf(entry, sizeof(entry), "entry%d", i);
+    xd_readline_history_add(entry);
+  }
+  xd_readline_prompt = "> ";
+  if (xd_readline() == NULL) {
+    return 1;
+  }
+  xd_readline_history_add("new");
+  char *first = xd_readline_history_get(1);
+  printf("[first %s]\n", first != NULL ? first : "");
+  fflush(stdout);
+  free(first);
+  return 0;
+}  // xd_test_eviction_child()
+
+/**
+ * @brief Tests that the entries recalled from history and accepted are
+ * protected from eviction with `XD_RL_HISTORY_EVICT_FREQUENCY` only.
+ */
+static void xd_test_eviction() {
+  static const xd_readline_history_eviction_t policies[] = {
+      XD_RL_HISTORY_EVICT_FIFO, XD_RL_HISTORY_EVICT_FREQUENCY};
+  static const char *expected[] = {"[first entry1]", "[first entry0]"};
+  for (int i = 0; i < 2; i++) {
+    xd_test_pty_t pty;
+    if (!XD_TEST_CHECK(xd_test_pty_spawn(&pty, xd_test_eviction_child,
+                                         (void *)&policies[i]) == 0)) {
+      return;
+    }
+    // `Ctrl+Up` recalls the oldest entry
+    XD_TEST_CHECK(xd_test_pty_expect(&pty, "> ") == 0 &&
+                  xd_test_pty_send(&pty, "\033[1;5A\n", 7) == 0 &&
+                  xd_test_pty_expect(&pty, expected[i]) == 0);
+    XD_TEST_CHECK(xd_test_pty_close(&pty) == 0);
+  }
+}  // xd_test_eviction()
+
+/**
+ * @brief Reads a line, then reads `stdin` directly, run on a pseudo-terminal.
+ *
+ * @param arg Unused.
+ *
+ * @return The exit status.
+ */
+static int xd_test_typeahead_child(void *arg) {
+  (void)arg;
+  xd_readline_prompt = "> ";
+  if (xd_readline() == NULL) {
+    return 1;
+  }
+  char rest[32];
+  ssize_t length = read(STDIN_FILENO, rest, sizeof(rest));
+  if (length <= 0) {
+    return 1;
+  }
+  printf("[rest %.*s]\n", (int)strcspn(rest, "\n"), rest);
+  fflush(stdout);
+  return 0;
+}  // xd_test_typeahead_child()
+
+/**
+ * @brief Tests that the input typed ahead past the end of the line is left in
+ * `stdin`.
+ */
+static void xd_test_typeahead() {
+  xd_test_pty_t pty;
+  if (!XD_TEST_CHECK(xd_test_pty_spawn(&pty, xd_test_typeahead_child, NULL) ==
+                     0)) {
+    return;
+  }
+  XD_TEST_CHECK(xd_test_pty_expect(&pty, "> ") == 0 &&
+                xd_test_pty_send(&pty, "one\ntwo\n", 8) == 0 &&
+                xd_test_pty_expect(&pty, "[rest two]") == 0);
+  XD_TEST_CHECK(xd_test_pty_close(&pty) == 0);
+}  // xd_test_typeahead()
+
+/**
+ * @brief Writes the name of the signal received, see `xd_test_signal_child()`.
+ *
+ * @param sig The signal.
+ */
+static void xd_test_signal_handler(int sig) {
+  const char *name = sig == SIGINT    ? "[SIGINT]"
+                     : sig == SIGQUIT ? "[SIGQUIT]"
+                                      : "[SIGTSTP]";
+  ssize_t ret = write(STDOUT_FILENO, name, strlen(name));
+  (void)ret;
+}  // xd_test_signal_handler()
+
+/**
+ * @brief Reads lines until end of file, writing the signals received, run on
+ * a pseudo-terminal.
+ *
+ * @param arg Unused.
+ *
+ * @return The exit status.
+ */
+static int xd_test_signal_child(void *arg) {
+  (void)arg;
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = xd_test_signal_handler;
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGQUIT, &action, NULL);
+  sigaction(SIGTSTP, &action, NULL);
+  xd_readline_prompt = "> ";
+  while (xd_readline() != NULL) {
+  }
+  return 0;
+}  // xd_test_signal_child()
+
+/**
+ * @brief Tests that `Ctrl+C`, `Ctrl+\` and `Ctrl+Z` reported by the keyboard
+ * enhancement protocol send the signals the tty sends for them.
+ */
+static void xd_test_signal() {
+  xd_test_pty_t pty;
+  if (!XD_TEST_CHECK(xd_test_pty_spawn(&pty, xd_test_signal_child, NULL) ==
+                     0)) {
+    return;
+  }
+  XD_TEST_CHECK(xd_test_pty_expect(&pty, "> ") == 0);
+  XD_TEST_CHECK(xd_test_pty_send(&pty, "\033[99;5u", 8) == 0 &&
+                xd_test_pty_expect(&pty, "[SIGINT]") == 0);
+  XD_TEST_CHECK(xd_test_pty_send(&pty, "\033[92;5u", 8) == 0 &&
+                xd_test_pty_expect(&pty, "[SIGQUIT]") == 0);
+  XD_TEST_CHECK(xd_test_pty_send(&pty, "\033[122;5u", 9) == 0 &&
+                xd_test_pty_expect(&pty, "[SIGTSTP]") == 0);
+  XD_TEST_CHECK(xd_test_pty_close(&pty) == 0);
+}  // xd_test_signal()
+
+int main() {
+  size_t count = sizeof(xd_test_cases) / sizeof(xd_test_cases[0]);
+  for (size_t i = 0; i < count; i++) {
+    xd_test_run(&xd_test_cases[i]);
+  }
+  xd_test_eviction();
+  xd_test_typeahead();
+  xd_test_signal();
+  printf("editing tests: %d failed check(s)\n", xd_test_failures());
+  return xd_test_failures() != 0;
+}  // main()
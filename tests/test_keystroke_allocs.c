@@ -0,0 +1,215 @@
+/*
+ * ==============================================================================
+ * File: test_keystroke_allocs.c
+ * Author: Duraid Maihoub
+ * Date: 18 October 2026
+ * Description: Part of the xd-readline project.
+ * Repository: https://github.com/xduraid/xd-readline
+ * ==============================================================================
+ * Copyright (c) 2026 Duraid Maihoub
+ *
+ * xd-readline is distributed under the MIT License. See the LICENSE file
+ * for more information.
+ * ==============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "xd_readline.h"
+#include "xd_test.h"
+
+// ========================
+// Macros
+// ========================
+
+/**
+ * @brief Number of entries the history is filled with.
+ */
+#define XD_TEST_HISTORY_ENTRIES (20)
+
+/**
+ * @brief Number of times the script is run, the allocations are checked on
+ * the last run only, once the buffers have grown to fit the input.
+ */
+#define XD_TEST_RUNS (2)
+
+/**
+ * @brief The key clearing the screen, typed after each action so that the
+ * action was handled when the screen is cleared.
+ */
+#define XD_TEST_KEY_SYNC "\014"
+
+/**
+ * @brief The output clearing the screen.
+ */
+#define XD_TEST_SCRN_CLR "\033[2J"
+
+// ========================
+// Typedefs
+// ========================
+
+/**
+ * @brief An action of the script, and the keys typed for it.
+ */
+typedef struct xd_test_action_t {
+  const char *name;  // The name reported for the action.
+  const char *keys;  // The keys typed.
+} xd_test_action_t;
+
+// ========================
+// Variables
+// ========================
+
+/**
+ * @brief The script typed on each line, the history entries are
+ * `cmd<n> --flag value<n>`.
+ */
+static const xd_test_action_t xd_test_script[] = {
+    {"clear-screen",                ""                                      },
+    {"typing",                      "echo hello world"                      },
+    {"cursor motion",               "\001\005\033[D\033[D\033[C\033b\033f"  },
+    {"deletion",                    "\010\010\033[D\033[3~\027"             },
+    {"history navigation",          "\033[A\033[A\033[A\033[B\033[B\033[B"  },
+#if XD_RL_ENABLE_SEARCH
+    {"reverse search",              "\022cmd1\010\022\022\007"              },
+    {"forward search",              "\023value\023\007"                     },
+#endif  // XD_RL_ENABLE_SEARCH
+};
+
+/**
+ * @brief The number of allocations made, shared with the process reading the
+ * input.
+ */
+static size_t *xd_test_allocs = NULL;
+
+// ========================
+// Function Definitions
+// ========================
+
+/**
+ * @brief Counting allocation function, see `xd_readline_set_allocator()`.
+ */
+static void *xd_test_alloc(size_t size, void *user) {
+  (*(size_t *)user)++;
+  return malloc(size);
+}  // xd_test_alloc()
+
+/**
+ * @brief Counting resizing function, see `xd_readline_set_allocator()`.
+ */
+static void *xd_test_realloc(void *ptr, size_t size, void *user) {
+  (*(size_t *)user)++;
+  return realloc(ptr, size);
+}  // xd_test_realloc()
+
+/**
+ * @brief Freeing function, see `xd_readline_set_allocator()`.
+ */
+static void xd_test_free(void *ptr, void *user) {
+  (void)user;
+  free(ptr);
+}  // xd_test_free()
+
+/**
+ * @brief Fills the history then reads lines until end of file, run on a
+ * pseudo-terminal.
+ *
+ * @param arg Unused.
+ *
+ * @return The exit status.
+ */
+static int xd_test_child(void *arg) {
+  (void)arg;
+  // `Ctrl+S` stops the output unless flow control is disabled
+  struct termios attributes;
+  if (tcgetattr(STDIN_FILENO, &attributes) == 0) {
+    attributes.c_iflag &= ~IXON;
+    tcsetattr(STDIN_FILENO, TCSANOW, &attributes);
+  }
+  if (xd_readline_set_allocator(xd_test_alloc, xd_test_realloc, xd_test_free,
+                                xd_test_allocs) == -1) {
+    return 1;
+  }
+  char entry[64];
+  for (int i = 0; i < XD_TEST_HISTORY_ENTRIES; i++) {
+    snprintf(entry, sizeof(entry), "cmd%d --flag value%d", i, i);
+    xd_readline_history_add(entry);
+  }
+  xd_readline_prompt = "> ";
+  char *line;
+  while ((line = xd_readline()) != NULL) {
+  }
+  // the allocations the library itself found unexpected, over all the runs
+  return xd_readline_debug_keystroke_allocs == 0 ? 0 : 2;
+}  // xd_test_child()
+
+/**
+ * @brief Types the script on one line and checks that its actions didn't
+ * allocate.
+ *
+ * @param pty The pseudo-terminal.
+ * @param check Whether to report and check the allocations (non-zero) or
+ * not.
+ *
+ * @return `0` on success, `-1` if the process stopped responding.
+ */
+static int xd_test_run(xd_test_pty_t *pty, int check) {
+  if (xd_test_pty_expect(pty, "> ") == -1) {
+    return -1;
+  }
+  size_t count = sizeof(xd_test_script) / sizeof(xd_test_script[0]);
+  for (size_t i = 0; i < count; i++) {
+    const xd_test_action_t *action = &xd_test_script[i];
+    size_t allocs = *xd_test_allocs;
+    if (xd_test_pty_send(pty, action->keys, strlen(action->keys)) == -1 ||
+        xd_test_pty_send(pty, XD_TEST_KEY_SYNC, strlen(XD_TEST_KEY_SYNC)) ==
+            -1 ||
+        xd_test_pty_expect(pty, XD_TEST_SCRN_CLR) == -1) {
+      return -1;
+    }
+    allocs = *xd_test_allocs - allocs;
+    if (check) {
+      printf("%-32s %6zu allocations\n", action->name, allocs);
+      XD_TEST_CHECK(allocs == 0);
+    }
+  }
+  // the prompt is looked for after the line is accepted, the redraws above
+  // show it too
+  if (xd_test_pty_send(pty, "\n", 1) == -1) {
+    return -1;
+  }
+  return xd_test_pty_expect(pty, "\n");
+}  // xd_test_run()
+
+int main() {
+  // the counter is updated by the child and read by the parent
+  xd_test_allocs = (size_t *)mmap(NULL, sizeof(size_t),
+                                  PROT_READ | PROT_WRITE,
+                                  MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (xd_test_allocs == MAP_FAILED) {
+    perror("test_keystroke_allocs: mmap");
+    return 1;
+  }
+  *xd_test_allocs = 0;
+
+  xd_test_pty_t pty;
+  if (xd_test_pty_spawn(&pty, xd_test_child, NULL) == -1) {
+    perror("test_keystroke_allocs: forkpty");
+    return 1;
+  }
+  printf("keystroke allocations, after %d warm-up run(s)\n",
+         XD_TEST_RUNS - 1);
+  for (int run = 0; run < XD_TEST_RUNS; run++) {
+    if (!XD_TEST_CHECK(xd_test_run(&pty, run == XD_TEST_RUNS - 1) == 0)) {
+      break;
+    }
+  }
+  XD_TEST_CHECK(xd_test_pty_close(&pty) == 0);
+  munmap(xd_test_allocs, sizeof(size_t));
+  return xd_test_failures() != 0;
+}  // main()
@@ -0,0 +1,427 @@
+/*
+ * ==============================================================================
+ * File: test_readline.c
+ * Author: Duraid Maihoub
+ * Date: 18 October 2026
+ * Description: Part of the xd-readline project.
+ * Repository: https://github.com/xduraid/xd-readline
+ * ==============================================================================
+ * Copyright (c) 2026 Duraid Maihoub
+ *
+ * xd-readline is distributed under the MIT License. See the LICENSE file
+ * for more information.
+ * ==============================================================================
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "xd_readline.h"
+#include "xd_test.h"
+
+// ========================
+// Macros
+// ========================
+
+/**
+ * @brief Length of the long line read from a stream, longer than the blocks
+ * the stream is read in.
+ */
+#define XD_TEST_LONG_LINE_LENGTH (200000)
+
+/**
+ * @brief Key bindings loaded from a file by the key bindings test.
+ */
+#define XD_TEST_INPUTRC                 \
+  "# comment\n"                         \
+  "set bell-style none\n"               \
+  "$if mode=emacs\n"                    \
+  "\"\\C-xq\": \"quit\"\n"              \
+  "$else\n"                             \
+  "\"\\C-xq\": \"vi\"\n"                \
+  "$endif\n"                            \
+  "Control-t: beginning-of-line\n"      \
+  "\"\\C-x\\C-x\": no-such-action\n"
+
+// ========================
+// Function Definitions
+// ========================
+
+/**
+ * @brief Writes the passed contents to a new temporary file.
+ *
+ * @param path Receives the path of the file, must hold at least `32` bytes.
+ * @param data The contents of the file.
+ * @param length The length of the contents.
+ *
+ * @return `0` on success or `-1` on failure.
+ */
+static int xd_test_file(char *path, const char *data, size_t length) {
+  strcpy(path, "/tmp/xd_test_XXXXXX");
+  int fd = mkstemp(path);
+  if (fd == -1) {
+    perror("test_readline: mkstemp");
+    return -1;
+  }
+  ssize_t written = write(fd, data, length);
+  close(fd);
+  return written == (ssize_t)length ? 0 : -1;
+}  // xd_test_file()
+
+/**
+ * @brief Checks the n-th history entry, see `xd_readline_history_get()`.
+ *
+ * @param n The number of the entry.
+ * @param expected The expected entry, or `NULL` if there should be none.
+ *
+ * @return Whether the entry is the expected one (non-zero) or not.
+ */
+static int xd_test_history_is(int n, const char *expected) {
+  char *entry = xd_readline_history_get(n);
+  int ret = expected == NULL
+                ? entry == NULL
+                : entry != NULL && strcmp(entry, expected) == 0;
+  free(entry);
+  return ret;
+}  // xd_test_history_is()
+
+/**
+ * @brief Tests adding entries to the history and retrieving them.
+ */
+static void xd_test_history() {
+  xd_readline_history_clear();
+  XD_TEST_CHECK(xd_test_history_is(1, NULL));
+  XD_TEST_CHECK(xd_test_history_is(-1, NULL));
+  XD_TEST_CHECK(xd_readline_history_add(NULL) == -1);
+
+  // the trailing new-line is dropped
+  XD_TEST_CHECK(xd_readline_history_add("first") == 0);
+  XD_TEST_CHECK(xd_readline_history_add("second\n") == 0);
+  XD_TEST_CHECK(xd_test_history_is(1, "first"));
+  XD_TEST_CHECK(xd_test_history_is(2, "second"));
+  XD_TEST_CHECK(xd_test_history_is(-1, "second"));
+  XD_TEST_CHECK(xd_test_history_is(-2, "first"));
+  XD_TEST_CHECK(xd_test_history_is(3, NULL));
+  XD_TEST_CHECK(xd_test_history_is(-3, NULL));
+
+  // the allocator can't be changed once the library is initialized
+  XD_TEST_CHECK(xd_readline_set_allocator(NULL, NULL, NULL, NULL) == -1 &&
+                errno == EBUSY);
+
+  // entries too long to be stored inline
+  char entry[512];
+  memset(entry, 'x', sizeof(entry) - 1);
+  entry[sizeof(entry) - 1] = '\0';
+  XD_TEST_CHECK(xd_readline_history_add(entry) == 0);
+  XD_TEST_CHECK(xd_readline_history_add(entry) == 0);
+  XD_TEST_CHECK(xd_test_history_is(-1, entry));
+  XD_TEST_CHECK(xd_test_history_is(-2, entry));
+  XD_TEST_CHECK(xd_test_history_is(2, "second"));
+
+  // the oldest entries are evicted once the history is full
+  xd_readline_history_clear();
+  for (int i = 0; i < XD_RL_HISTORY_MAX + 3; i++) {
+    snprintf(entry, sizeof(entry), "entry%d", i);
+    XD_TEST_CHECK(xd_readline_history_add(entry) == 0);
+  }
+  XD_TEST_CHECK(xd_test_history_is(1, "entry3"));
+  snprintf(entry, sizeof(entry), "entry%d", XD_RL_HISTORY_MAX + 2);
+  XD_TEST_CHECK(xd_test_history_is(-1, entry));
+  XD_TEST_CHECK(xd_test_history_is(XD_RL_HISTORY_MAX + 1, NULL));
+
+  xd_readline_history_clear();
+  XD_TEST_CHECK(xd_test_history_is(1, NULL));
+}  // xd_test_history()
+
+/**
+ * @brief Tests adding entries to the history within a memory budget.
+ */
+static void xd_test_history_budget() {
+  char entry[512];
+  memset(entry, 'x', sizeof(entry) - 1);
+  entry[sizeof(entry) - 1] = '\0';
+
+  // entries holding long strings are evicted to make room for a new one, the
+  // others release nothing so they are kept
+  xd_readline_history_clear();
+  xd_readline_history_add("short");
+  xd_readline_history_add(entry);
+  xd_readline_history_add("other");
+  xd_readline_memory_usage_t usage;
+  XD_TEST_CHECK(xd_readline_memory_get_usage(XD_RL_MEMORY_TOTAL, &usage) == 0);
+  xd_readline_memory_budget = usage.current;
+  entry[0] = 'y';
+  XD_TEST_CHECK(xd_readline_history_add(entry) == 0);
+  XD_TEST_CHECK(xd_test_history_is(1, "short"));
+  XD_TEST_CHECK(xd_test_history_is(2, "other"));
+  XD_TEST_CHECK(xd_test_history_is(3, entry));
+
+  // below the usage the history starts with, short entries are still added
+  // and long ones are refused once no entry holding a long string is left
+  xd_readline_memory_budget = usage.current / 2;
+  XD_TEST_CHECK(xd_readline_history_add("third") == 0);
+  entry[0] = 'z';
+  XD_TEST_CHECK(xd_readline_history_add(entry) == -1);
+  XD_TEST_CHECK(xd_test_history_is(1, "short"));
+  XD_TEST_CHECK(xd_test_history_is(2, "other"));
+  XD_TEST_CHECK(xd_test_history_is(3, "third"));
+  XD_TEST_CHECK(xd_test_history_is(4, NULL));
+
+  xd_readline_memory_budget = 0;
+  xd_readline_history_clear();
+}  // xd_test_history_budget()
+
+/**
+ * @brief Tests saving the history to a file and loading it back.
+ */
+static void xd_test_history_file() {
+  char path[32];
+  if (!XD_TEST_CHECK(xd_test_file(path, "", 0) == 0)) {
+    return;
+  }
+  xd_readline_history_clear();
+  xd_readline_history_add("a");
+  xd_readline_history_add("b b");
+  xd_readline_history_add("c");
+  XD_TEST_CHECK(xd_readline_history_save_to_file(path, 0) == 0);
+  XD_TEST_CHECK(xd_readline_history_save_to_file(path, 1) == 0);
+
+  xd_readline_history_clear();
+  XD_TEST_CHECK(xd_readline_history_load_from_file(path) == 0);
+  XD_TEST_CHECK(xd_test_history_is(1, "a"));
+  XD_TEST_CHECK(xd_test_history_is(2, "b b"));
+  XD_TEST_CHECK(xd_test_history_is(4, "a"));
+  XD_TEST_CHECK(xd_test_history_is(-1, "c"));
+  XD_TEST_CHECK(xd_test_history_is(7, NULL));
+
+  // overwriting drops the appended entries
+  xd_readline_history_clear();
+  xd_readline_history_add("d");
+  XD_TEST_CHECK(xd_readline_history_save_to_file(path, 0) == 0);
+  xd_readline_history_clear();
+  XD_TEST_CHECK(xd_readline_history_load_from_file(path) == 0);
+  XD_TEST_CHECK(xd_test_history_is(1, "d"));
+  XD_TEST_CHECK(xd_test_history_is(2, NULL));
+
+  // multi-line entries and the backslashes escaping them round-trip, and the
+  // records of the file fill the history once its tail is skipped to
+  const char *entries[] = {"if x\nthen y\nfi", "a\\nb", "c\\\nd", "e\\",
+                           "f\\g\\\\h"};
+  size_t count = sizeof(entries) / sizeof(entries[0]);
+  xd_readline_history_clear();
+  for (int i = 0; i < XD_RL_HISTORY_MAX; i++) {
+    xd_readline_history_add(entries[(size_t)i % count]);
+  }
+  XD_TEST_CHECK(xd_readline_history_save_to_file(path, 0) == 0);
+  XD_TEST_CHECK(xd_readline_history_save_to_file(path, 1) == 0);
+  xd_readline_history_clear();
+  XD_TEST_CHECK(xd_readline_history_load_from_file(path) == 0);
+  for (size_t i = 0; i < count; i++) {
+    XD_TEST_CHECK(xd_test_history_is((int)i + 1, entries[i]));
+  }
+  XD_TEST_CHECK(xd_test_history_is(
+      -1, entries[(size_t)(XD_RL_HISTORY_MAX - 1) % count]));
+  XD_TEST_CHECK(xd_test_history_is(XD_RL_HISTORY_MAX + 1, NULL));
+  unlink(path);
+
+  // only the last lines of a long file are kept, a last line without a
+  // new-line included
+  size_t lines = XD_RL_HISTORY_MAX + 10;
+  char *data = (char *)malloc(lines * 16);
+  if (!XD_TEST_CHECK(data != NULL)) {
+    return;
+  }
+  size_t length = 0;
+  for (size_t i = 0; i < lines; i++) {
+    length += (size_t)sprintf(data + length, "line%zu\n", i);
+  }
+  int ret = xd_test_file(path, data, length - 1);
+  free(data);
+  if (!XD_TEST_CHECK(ret == 0)) {
+    return;
+  }
+  xd_readline_history_clear();
+  XD_TEST_CHECK(xd_readline_history_load_from_file(path) == 0);
+  XD_TEST_CHECK(xd_test_history_is(1, "line10"));
+  char last[32];
+  snprintf(last, sizeof(last), "line%zu", lines - 1);
+  XD_TEST_CHECK(xd_test_history_is(-1, last));
+  unlink(path);
+
+  // null bytes are kept in the entries loaded and saved
+  if (!XD_TEST_CHECK(xd_test_file(path, "a\0b\n", 4) == 0)) {
+    return;
+  }
+  xd_readline_history_clear();
+  XD_TEST_CHECK(xd_readline_history_load_from_file(path) == 0);
+  XD_TEST_CHECK(xd_readline_history_save_to_file(path, 0) == 0);
+  xd_readline_history_clear();
+  XD_TEST_CHECK(xd_readline_history_load_from_file(path) == 0);
+  char *entry = xd_readline_history_get(1);
+  XD_TEST_CHECK(entry != NULL && memcmp(entry, "a\0b", 4) == 0);
+  free(entry);
+  unlink(path);
+
+  XD_TEST_CHECK(xd_readline_history_load_from_file(path) == -1);
+  xd_readline_history_clear();
+}  // xd_test_history_file()
+
+/**
+ * @brief Tests reading lines with `xd_readline_n()` when `stdin` is not a
+ * terminal.
+ */
+static void xd_test_stream() {
+  size_t length = XD_TEST_LONG_LINE_LENGTH + 32;
+  char *data = (char *)malloc(length);
+  if (!XD_TEST_CHECK(data != NULL)) {
+    return;
+  }
+  strcpy(data, "one\n\ntwo\n");
+  size_t long_start = strlen(data);
+  memset(data + long_start, 'y', XD_TEST_LONG_LINE_LENGTH);
+  strcpy(data + long_start + XD_TEST_LONG_LINE_LENGTH, "\nlast");
+  length = strlen(data);
+
+  char path[32];
+  int ret = xd_test_file(path, data, length);
+  if (!XD_TEST_CHECK(ret == 0)) {
+    free(data);
+    return;
+  }
+  FILE *file = fopen(path, "r");
+  unlink(path);
+  int saved_stdin = dup(STDIN_FILENO);
+  if (!XD_TEST_CHECK(file != NULL && saved_stdin != -1 &&
+                     dup2(fileno(file), STDIN_FILENO) != -1)) {
+    free(data);
+    return;
+  }
+
+  char *line = NULL;
+  size_t capacity = 0;
+  XD_TEST_CHECK(xd_readline_n(NULL, &capacity) == -1 && errno == EINVAL);
+  XD_TEST_CHECK(xd_readline_n(&line, &capacity) == 4);
+  XD_TEST_CHECK(line != NULL && strcmp(line, "one\n") == 0);
+  XD_TEST_CHECK(capacity > 4);
+  XD_TEST_CHECK(xd_readline_n(&line, &capacity) == 1);
+  XD_TEST_CHECK(strcmp(line, "\n") == 0);
+
+  // without the new-line
+  xd_readline_omit_newline = 1;
+  XD_TEST_CHECK(xd_readline_n(&line, &capacity) == 3);
+  XD_TEST_CHECK(strcmp(line, "two") == 0);
+  xd_readline_omit_newline = 0;
+
+  XD_TEST_CHECK(xd_readline_n(&line, &capacity) ==
+                XD_TEST_LONG_LINE_LENGTH + 1);
+  XD_TEST_CHECK(strncmp(line, data + long_start,
+                        XD_TEST_LONG_LINE_LENGTH + 1) == 0);
+
+  // a new-line is added to the last line
+  XD_TEST_CHECK(xd_readline_n(&line, &capacity) == 5);
+  XD_TEST_CHECK(strcmp(line, "last\n") == 0);
+  XD_TEST_CHECK(xd_readline_n(&line, &capacity) == -1);
+  free(line);
+  free(data);
+
+  dup2(saved_stdin, STDIN_FILENO);
+  close(saved_stdin);
+  fclose(file);
+}  // xd_test_stream()
+
+/**
+ * @brief Reads lines and writes them between brackets until end of file, run
+ * on a pseudo-terminal.
+ *
+ * @param arg Unused.
+ *
+ * @return The exit status.
+ */
+static int xd_test_bindings_child(void *arg) {
+  (void)arg;
+  xd_readline_prompt = "> ";
+  char *line;
+  while ((line = xd_readline()) != NULL) {
+    printf("[line %.*s]\n", (int)strcspn(line, "\n"), line);
+    fflush(stdout);
+  }
+  return 0;
+}  // xd_test_bindings_child()
+
+/**
+ * @brief Types the passed keys followed by `Enter` and checks the line read.
+ *
+ * @param pty The pseudo-terminal.
+ * @param keys The keys typed.
+ * @param expected The expected line, between brackets as written by
+ * `xd_test_bindings_child()`.
+ *
+ * @return Whether the expected line was read (non-zero) or not.
+ */
+static int xd_test_bindings_line(xd_test_pty_t *pty, const char *keys,
+                                 const char *expected) {
+  return xd_test_pty_expect(pty, "> ") == 0 &&
+         xd_test_pty_send(pty, keys, strlen(keys)) == 0 &&
+         xd_test_pty_send(pty, "\r", 1) == 0 &&
+         xd_test_pty_expect(pty, expected) == 0;
+}  // xd_test_bindings_line()
+
+/**
+ * @brief Tests binding keys to actions and macros, directly and from a file.
+ */
+static void xd_test_bindings() {
+  errno = 0;
+  XD_TEST_CHECK(xd_readline_bind("", XD_RL_ACTION_ABORT) == -1 &&
+                errno == EINVAL);
+  errno = 0;
+  XD_TEST_CHECK(xd_readline_bind_macro(
+                    "0123456789012345678901234567890123456789", "x") == -1 &&
+                errno == EINVAL);
+  XD_TEST_CHECK(xd_readline_bindings_load_from_file("/nonexistent") == -1);
+
+  XD_TEST_CHECK(xd_readline_bind("\033[Z", XD_RL_ACTION_BACKWARD_WORD) == 0);
+  XD_TEST_CHECK(xd_readline_bind_macro("\033p", "\001sudo \005") == 0);
+  char path[32];
+  if (!XD_TEST_CHECK(xd_test_file(path, XD_TEST_INPUTRC,
+                                  strlen(XD_TEST_INPUTRC)) == 0)) {
+    return;
+  }
+  XD_TEST_CHECK(xd_readline_bindings_load_from_file(path) == 0);
+  unlink(path);
+
+  xd_test_pty_t pty;
+  if (!XD_TEST_CHECK(xd_test_pty_spawn(&pty, xd_test_bindings_child, NULL) ==
+                     0)) {
+    return;
+  }
+  XD_TEST_CHECK(xd_test_bindings_line(&pty, "plain", "[line plain]"));
+  XD_TEST_CHECK(xd_test_bindings_line(&pty, "one two\033[Zx",
+                                      "[line one xtwo]"));
+  XD_TEST_CHECK(xd_test_bindings_line(&pty, "ls\033p", "[line sudo ls]"));
+  XD_TEST_CHECK(xd_test_bindings_line(&pty, "abc\024x", "[line xabc]"));
+  XD_TEST_CHECK(xd_test_bindings_line(&pty, "\030q", "[line quit]"));
+  XD_TEST_CHECK(xd_test_pty_close(&pty) == 0);
+
+  // unbinding makes the key do nothing
+  XD_TEST_CHECK(xd_readline_bind("\024", XD_RL_ACTION_NONE) == 0);
+  if (!XD_TEST_CHECK(xd_test_pty_spawn(&pty, xd_test_bindings_child, NULL) ==
+                     0)) {
+    return;
+  }
+  XD_TEST_CHECK(xd_test_bindings_line(&pty, "abc\024x", "[line abcx]"));
+  XD_TEST_CHECK(xd_test_pty_close(&pty) == 0);
+}  // xd_test_bindings()
+
+int main() {
+  xd_test_history();
+  xd_test_history_budget();
+  xd_test_history_file();
+  xd_test_stream();
+  xd_test_bindings();
+  xd_readline_history_clear();
+  printf("readline tests: %d failed check(s)\n", xd_test_failures());
+  return xd_test_failures() != 0;
+}  // main()
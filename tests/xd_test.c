@@ -0,0 +1,214 @@
+/*
+ * ==============================================================================
+ * File: xd_test.c
+ * Author: Duraid Maihoub
+ * Date: 18 October 2026
+ * Description: Part of the xd-readline project.
+ * Repository: https://github.com/xduraid/xd-readline
+ * ==============================================================================
+ * Copyright (c) 2026 Duraid Maihoub
+ *
+ * xd-readline is distributed under the MIT License. See the LICENSE file
+ * for more information.
+ * ==============================================================================
+ */
+
+#include "xd_test.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <pty.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "xd_readline.h"
+
+// ========================
+// Macros
+// ========================
+
+/**
+ * @brief The cursor position request written by `xd_readline()`.
+ */
+#define XD_TEST_CRSR_REQ_POS "\033[6n"
+
+/**
+ * @brief The reply to cursor position requests, the cursor is reported at the
+ * start of a row so the prompt is written where it is.
+ */
+#define XD_TEST_CRSR_POS "\033[1;1R"
+
+// ========================
+// Variables
+// ========================
+
+/**
+ * @brief Number of failed checks.
+ */
+static int xd_test_failed = 0;
+
+// ========================
+// Function Definitions
+// ========================
+
+int xd_test_check(int cond, const char *expr, const char *file, int line) {
+  if (!cond) {
+    fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expr);
+    xd_test_failed++;
+  }
+  return cond;
+}  // xd_test_check()
+
+int xd_test_failures() {
+  return xd_test_failed;
+}  // xd_test_failures()
+
+long long xd_test_now_ns() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return ((long long)now.tv_sec * 1000000000LL) + now.tv_nsec;
+}  // xd_test_now_ns()
+
+int xd_test_pty_spawn(xd_test_pty_t *pty, xd_test_pty_func_t func, void *arg) {
+  struct winsize size = {.ws_row = XD_TEST_PTY_ROWS,
+                         .ws_col = XD_TEST_PTY_COLS};
+  memset(pty, 0, sizeof(*pty));
+  pty->capacity = 4096;
+  pty->output = (char *)malloc(pty->capacity);
+  if (pty->output == NULL) {
+    return -1;
+  }
+  pty->output[0] = '\0';
+
+  fflush(stdout);
+  pty->pid = forkpty(&pty->fd, NULL, NULL, &size);
+  if (pty->pid == -1) {
+    free(pty->output);
+    return -1;
+  }
+  if (pty->pid == 0) {
+    int status = func(arg);
+    fflush(stdout);
+    _exit(status);
+  }
+  return 0;
+}  // xd_test_pty_spawn()
+
+/**
+ * @brief Reads what is available of the output of the pseudo-terminal within
+ * the passed time, answering the cursor position requests in it.
+ *
+ * @param pty The pseudo-terminal.
+ * @param timeout_ms The time to wait for output in milliseconds.
+ *
+ * @return The number of bytes read, `0` on timeout, or `-1` if the process
+ * exited or on failure.
+ */
+static ssize_t xd_test_pty_read(xd_test_pty_t *pty, int timeout_ms) {
+  struct pollfd pfd = {.fd = pty->fd, .events = POLLIN};
+  int ret = poll(&pfd, 1, timeout_ms);
+  if (ret <= 0) {
+    return ret == 0 || errno == EINTR ? 0 : -1;
+  }
+  if (pty->capacity - pty->length < 4096) {
+    char *output = (char *)realloc(pty->output, pty->capacity * 2);
+    if (output == NULL) {
+      return -1;
+    }
+    pty->output = output;
+    pty->capacity *= 2;
+  }
+  ssize_t n = read(pty->fd, pty->output + pty->length,
+                   pty->capacity - pty->length - 1);
+  if (n <= 0) {
+    return -1;
+  }
+
+  // a request may be split between reads, so look back over its length
+  size_t request_length = strlen(XD_TEST_CRSR_REQ_POS);
+  size_t start = pty->length >= request_length - 1
+                     ? pty->length - (request_length - 1)
+                     : 0;
+  pty->length += (size_t)n;
+  pty->output[pty->length] = '\0';
+  const char *request = pty->output + start;
+  while ((request = strstr(request, XD_TEST_CRSR_REQ_POS)) != NULL) {
+    if (write(pty->fd, XD_TEST_CRSR_POS, strlen(XD_TEST_CRSR_POS)) == -1) {
+      return -1;
+    }
+    request += request_length;
+  }
+  return n;
+}  // xd_test_pty_read()
+
+int xd_test_pty_send(xd_test_pty_t *pty, const char *keys, size_t length) {
+  while (length > 0) {
+    // keep reading the output, or the process may block writing it while
+    // the keys wait for it to read them
+    struct pollfd pfd = {.fd = pty->fd, .events = POLLIN | POLLOUT};
+    if (poll(&pfd, 1, XD_TEST_TIMEOUT_MS) <= 0) {
+      return -1;
+    }
+    if ((pfd.revents & POLLIN) && xd_test_pty_read(pty, 0) == -1) {
+      return -1;
+    }
+    if (!(pfd.revents & POLLOUT)) {
+      continue;
+    }
+    ssize_t written = write(pty->fd, keys, length);
+    if (written == -1) {
+      if (errno == EINTR || errno == EAGAIN) {
+        continue;
+      }
+      return -1;
+    }
+    keys += written;
+    length -= (size_t)written;
+  }
+  return 0;
+}  // xd_test_pty_send()
+
+int xd_test_pty_expect(xd_test_pty_t *pty, const char *text) {
+  long long deadline =
+      xd_test_now_ns() + (XD_TEST_TIMEOUT_MS * 1000000LL);
+  while (1) {
+    const char *found = strstr(pty->output + pty->mark, text);
+    if (found != NULL) {
+      pty->mark = (size_t)(found - pty->output) + strlen(text);
+      return 0;
+    }
+    long long left_ms = (deadline - xd_test_now_ns()) / 1000000LL;
+    if (left_ms <= 0 || xd_test_pty_read(pty, (int)left_ms) == -1) {
+      return -1;
+    }
+  }
+}  // xd_test_pty_expect()
+
+int xd_test_pty_close(xd_test_pty_t *pty) {
+  // the process gets EOF then `SIGHUP` if it's still reading, `Ctrl+D` is
+  // typed again in case it was lost switching the terminal to raw mode
+  int status = 0;
+  pid_t pid = 0;
+  long long deadline = xd_test_now_ns() + (XD_TEST_TIMEOUT_MS * 1000000LL);
+  while (pid == 0 && xd_test_now_ns() < deadline) {
+    xd_test_pty_send(pty, "\004", 1);
+    while (xd_test_pty_read(pty, XD_TEST_RETRY_MS) > 0) {
+    }
+    pid = waitpid(pty->pid, &status, WNOHANG);
+  }
+  close(pty->fd);
+  free(pty->output);
+  pty->output = NULL;
+
+  if (pid == 0) {
+    pid = waitpid(pty->pid, &status, 0);
+  }
+  if (pid == -1 || !WIFEXITED(status)) {
+    return -1;
+  }
+  return WEXITSTATUS(status);
+}  // xd_test_pty_close()
@@ -0,0 +1,137 @@
+/*
+ * ==============================================================================
+ * File: xd_test.h
+ * Author: Duraid Maihoub
+ * Date: 18 October 2026
+ * Description: Part of the xd-readline project.
+ * Repository: https://github.com/xduraid/xd-readline
+ * ==============================================================================
+ * Copyright (c) 2026 Duraid Maihoub
+ *
+ * xd-readline is distributed under the MIT License. See the LICENSE file
+ * for more information.
+ * ==============================================================================
+ */
+
+#ifndef XD_TEST_H
+#define XD_TEST_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/**
+ * @brief Number of columns of the pseudo-terminals spawned by the tests.
+ */
+#define XD_TEST_PTY_COLS (80)
+
+/**
+ * @brief Number of rows of the pseudo-terminals spawned by the tests.
+ */
+#define XD_TEST_PTY_ROWS (24)
+
+/**
+ * @brief Milliseconds to wait for expected output before giving up.
+ */
+#define XD_TEST_TIMEOUT_MS (5000)
+
+/**
+ * @brief Milliseconds to wait for a process to react before retrying.
+ */
+#define XD_TEST_RETRY_MS (100)
+
+/**
+ * @brief Checks a condition, reporting it with its location when it fails.
+ */
+#define XD_TEST_CHECK(cond) xd_test_check((cond), #cond, __FILE__, __LINE__)
+
+/**
+ * @brief A process running on a pseudo-terminal, and what it wrote so far.
+ */
+typedef struct xd_test_pty_t {
+  pid_t pid;        // The process running on the pseudo-terminal.
+  int fd;           // The master side of the pseudo-terminal.
+  char *output;     // Everything the process wrote, NUL-terminated.
+  size_t length;    // The length of `output`.
+  size_t capacity;  // The capacity of `output`.
+  size_t mark;      // The offset in `output` after the last expected text.
+} xd_test_pty_t;
+
+/**
+ * @brief Function type for the code run on a pseudo-terminal.
+ *
+ * @param arg The argument passed to `xd_test_pty_spawn()`.
+ *
+ * @return The exit status of the process.
+ */
+typedef int (*xd_test_pty_func_t)(void *arg);
+
+/**
+ * @brief Reports a failed check and counts it.
+ *
+ * @param cond The result of the check.
+ * @param expr The checked expression.
+ * @param file The file of the check.
+ * @param line The line of the check.
+ *
+ * @return `cond`.
+ */
+int xd_test_check(int cond, const char *expr, const char *file, int line);
+
+/**
+ * @brief Returns the number of failed checks so far.
+ */
+int xd_test_failures();
+
+/**
+ * @brief Returns a monotonic time stamp in nanoseconds.
+ */
+long long xd_test_now_ns();
+
+/**
+ * @brief Runs the passed function in a child process whose standard streams
+ * are the slave side of a new pseudo-terminal.
+ *
+ * The cursor position requests the child writes are answered while its
+ * output is read.
+ *
+ * @param pty The pseudo-terminal to initialize.
+ * @param func The function run by the child.
+ * @param arg The argument passed to `func`.
+ *
+ * @return `0` on success, `-1` on failure.
+ */
+int xd_test_pty_spawn(xd_test_pty_t *pty, xd_test_pty_func_t func, void *arg);
+
+/**
+ * @brief Writes the passed keys to the pseudo-terminal.
+ *
+ * @param pty The pseudo-terminal.
+ * @param keys The bytes typed.
+ * @param length The number of bytes typed.
+ *
+ * @return `0` on success, `-1` on failure.
+ */
+int xd_test_pty_send(xd_test_pty_t *pty, const char *keys, size_t length);
+
+/**
+ * @brief Reads the output of the pseudo-terminal until the passed text is
+ * written after the mark, then moves the mark after it.
+ *
+ * @param pty The pseudo-terminal.
+ * @param text The text to wait for.
+ *
+ * @return `0` if the text was written, `-1` on timeout or if the process
+ * exited first.
+ */
+int xd_test_pty_expect(xd_test_pty_t *pty, const char *text);
+
+/**
+ * @brief Closes the pseudo-terminal and waits for its process.
+ *
+ * @param pty The pseudo-terminal.
+ *
+ * @return The exit status of the process, or `-1` if it didn't exit normally.
+ */
+int xd_test_pty_close(xd_test_pty_t *pty);
+
+#endif  // XD_TEST_H